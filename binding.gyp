@@ -1,15 +1,45 @@
 {
+    "variables": {
+        "alloc_counter%": "false"
+    },
     "targets": [
         {
             "target_name": "fsuipc",
             "sources": [
                 "src/index.cc",
                 "src/FSUIPC.cc",
-                "src/IPCUser.cc"
+                "src/IPCUser.cc",
+                "src/Connection.cc",
+                "src/Multiplexer.cc",
+                "src/Snapshot.cc",
+                "src/SnapshotReader.cc",
+                "src/Stats.cc",
+                "src/History.cc",
+                "src/Estimator.cc",
+                "src/Aggregate.cc",
+                "src/Capture.cc",
+                "src/Recorder.cc",
+                "src/Replay.cc",
+                "src/Schedule.cc",
+                "src/Scheduler.cc",
+                "src/Mirror.cc",
+                "src/AdaptiveRate.cc",
+                "src/Publisher.cc",
+                "src/Subscriber.cc",
+                "src/StateFile.cc",
+                "src/Delta.cc",
+                "src/DeltaStream.cc",
+                "src/Serializer.cc",
+                "src/AllocCounter.cc"
             ],
             "include_dirs" : [
                 "src",
                 "<!(node -e \"require('nan')\")"
+            ],
+            "conditions": [
+                ["alloc_counter=='true'", {
+                    "defines": ["FSUIPC_ALLOC_COUNTER"]
+                }]
             ]
         }
     ]
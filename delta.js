@@ -0,0 +1,282 @@
+// Pure JS decoder for the delta wire format of DeltaStream, for clients that
+// can't load the addon, such as browsers. Decodes to the same result object
+// as the native DeltaReader. See src/Delta.h for the format.
+
+const Type = {
+  Byte: 0,
+  SByte: 1,
+  Int16: 2,
+  Int32: 3,
+  Int64: 4,
+  UInt16: 5,
+  UInt32: 6,
+  UInt64: 7,
+  Double: 8,
+  Single: 9,
+  ByteArray: 10,
+  String: 11,
+  BitArray: 12,
+};
+
+const KEY_FRAME_TAG = 0x4B;  // 'K'
+const DELTA_TAG = 0x44;      // 'D'
+
+const utf8 = new TextDecoder('utf-8');
+
+class InvalidFrameError extends Error {
+  constructor() {
+    super('DeltaReader.decode - invalid frame');
+  }
+}
+
+function isFloat(type) {
+  return type === Type.Double || type === Type.Single;
+}
+
+function isRaw(type) {
+  return type === Type.ByteArray || type === Type.String ||
+      type === Type.BitArray;
+}
+
+function isSigned(type) {
+  return type === Type.SByte || type === Type.Int16 || type === Type.Int32 ||
+      type === Type.Int64;
+}
+
+class Reader {
+  constructor(data) {
+    this.data = data;
+    this.position = 0;
+  }
+
+  byte() {
+    if (this.position >= this.data.length) {
+      throw new InvalidFrameError();
+    }
+    return this.data[this.position++];
+  }
+
+  // Exact up to 2^53, which covers everything but 64 bit values
+  varint() {
+    let result = 0;
+    let scale = 1;
+
+    for (let i = 0; i < 10; i++) {
+      const byte = this.byte();
+      result += (byte & 0x7F) * scale;
+      if (!(byte & 0x80)) {
+        return result;
+      }
+      scale *= 128;
+    }
+
+    throw new InvalidFrameError();
+  }
+
+  bigVarint() {
+    let result = 0n;
+
+    for (let shift = 0n; shift < 70n; shift += 7n) {
+      const byte = this.byte();
+      result |= BigInt(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        return result;
+      }
+    }
+
+    throw new InvalidFrameError();
+  }
+
+  bytes(length) {
+    if (length > this.data.length - this.position) {
+      throw new InvalidFrameError();
+    }
+    const bytes = this.data.subarray(this.position, this.position + length);
+    this.position += length;
+    return bytes;
+  }
+}
+
+class DeltaReader {
+  constructor() {
+    this.fields = null;
+    this.values = null;
+    this.view = null;
+    this.timestamp = 0;
+  }
+
+  // Returns the values of the frame, or null for a delta that arrived before
+  // the first key frame. Throws on an invalid frame, after which a key frame
+  // is needed again.
+  decode(frame) {
+    const data = frame instanceof Uint8Array ? frame : new Uint8Array(frame);
+
+    try {
+      return this.decodeFrame(new Reader(data));
+    } catch (e) {
+      this.fields = null;
+      throw e;
+    }
+  }
+
+  decodeFrame(reader) {
+    const tag = reader.byte();
+    reader.varint();  // Sequence
+    const timestamp = reader.varint();
+
+    let bitmap = null;
+
+    if (tag === KEY_FRAME_TAG) {
+      const count = reader.varint();
+      const fields = [];
+      let total = 0;
+
+      for (let i = 0; i < count; i++) {
+        const name = utf8.decode(reader.bytes(reader.varint()));
+        const type = reader.varint();
+        const size = reader.varint();
+
+        if (type > Type.BitArray || size === 0 ||
+            (!isRaw(type) && size > 8)) {
+          throw new InvalidFrameError();
+        }
+
+        fields.push({name, type, size, position: total});
+        total += size;
+      }
+
+      this.fields = fields;
+      this.values = new Uint8Array(total);
+      this.view = new DataView(this.values.buffer);
+      this.timestamp = timestamp;
+    } else if (tag === DELTA_TAG) {
+      if (!this.fields) {
+        return null;
+      }
+
+      bitmap = reader.bytes((this.fields.length + 7) >> 3);
+      this.timestamp += timestamp;
+    } else {
+      throw new InvalidFrameError();
+    }
+
+    for (let i = 0; i < this.fields.length; i++) {
+      if (bitmap && !(bitmap[i >> 3] & (1 << (i & 7)))) {
+        continue;
+      }
+
+      this.decodeValue(reader, this.fields[i]);
+    }
+
+    if (reader.position !== reader.data.length) {
+      throw new InvalidFrameError();
+    }
+
+    return this.result();
+  }
+
+  decodeValue(reader, field) {
+    const {type, size, position} = field;
+
+    if (isRaw(type)) {
+      this.values.set(reader.bytes(size), position);
+    } else if (isFloat(type)) {
+      const control = reader.byte();
+      const leading = control >> 4;
+      const trailing = control & 0xF;
+
+      if (leading + trailing > size) {
+        throw new InvalidFrameError();
+      }
+
+      const bits = reader.bytes(size - leading - trailing);
+      for (let j = 0; j < bits.length; j++) {
+        this.values[position + trailing + j] ^= bits[j];
+      }
+    } else if (size === 8) {
+      const zigzag = reader.bigVarint();
+      const delta = (zigzag >> 1n) ^ -(zigzag & 1n);
+      const previous = this.view.getBigUint64(position, true);
+      this.view.setBigUint64(
+          position, BigInt.asUintN(64, previous + delta), true);
+    } else {
+      const zigzag = reader.varint();
+      const delta = zigzag % 2 === 0 ? zigzag / 2 : -(zigzag + 1) / 2;
+      const modulo = 2 ** (size * 8);
+
+      let value = this.readInteger(type, position, size) + delta;
+      value = ((value % modulo) + modulo) % modulo;
+
+      for (let j = 0; j < size; j++) {
+        this.values[position + j] = value % 256;
+        value = Math.floor(value / 256);
+      }
+    }
+  }
+
+  readInteger(type, position, size) {
+    let value = 0;
+    for (let j = size - 1; j >= 0; j--) {
+      value = value * 256 + this.values[position + j];
+    }
+
+    if (isSigned(type) && value >= 2 ** (size * 8 - 1)) {
+      value -= 2 ** (size * 8);
+    }
+
+    return value;
+  }
+
+  result() {
+    const obj = {};
+
+    for (const field of this.fields) {
+      obj[field.name] = this.fieldValue(field);
+    }
+
+    return obj;
+  }
+
+  fieldValue({type, size, position}) {
+    const view = this.view;
+
+    switch (type) {
+      case Type.Byte:
+        return view.getUint8(position);
+      case Type.SByte:
+        return view.getInt8(position);
+      case Type.Int16:
+        return view.getInt16(position, true);
+      case Type.Int32:
+        return view.getInt32(position, true);
+      case Type.Int64:
+        return view.getBigInt64(position, true).toString();
+      case Type.UInt16:
+        return view.getUint16(position, true);
+      case Type.UInt32:
+        return view.getUint32(position, true);
+      case Type.UInt64:
+        return view.getBigUint64(position, true).toString();
+      case Type.Double:
+        return view.getFloat64(position, true);
+      case Type.Single:
+        return view.getFloat32(position, true);
+      case Type.String: {
+        const bytes = this.values.subarray(position, position + size);
+        const end = bytes.indexOf(0);
+        return utf8.decode(end === -1 ? bytes : bytes.subarray(0, end));
+      }
+      case Type.BitArray: {
+        const bits = [];
+        for (let i = 0; i < size * 8; i++) {
+          bits.push((this.values[position + (i >> 3)] & (1 << (i & 7))) !== 0);
+        }
+        return bits;
+      }
+      case Type.ByteArray:
+        return Array.from(this.values.subarray(position, position + size));
+    }
+  }
+}
+
+module.exports = {DeltaReader};
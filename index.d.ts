@@ -45,15 +45,161 @@ type FixedSizedNumberType = Type.Byte|Type.SByte|Type.Int16|Type.Int32|Type.UInt
 type FixedSizedStringType = Type.Int64|Type.UInt64;
 type VariableSizedType = Type.ByteArray|Type.String|Type.BitArray;
 
+interface FSUIPCOptions {
+  // Share a single IPC link with all other shared instances in this process
+  shared?: boolean;
+}
+
+interface ReplayOptions {
+  // Path of the capture
+  replay: string;
+  // Playback speed relative to real time, or 0 to advance one frame per
+  // process(). Defaults to 1.
+  speed?: number;
+}
+
+interface ConnectOptions {
+  simulator?: Simulator;
+  // Delay before the first retry after a failed attempt, doubling up to
+  // maxBackoffMs. Defaults to 250.
+  minBackoffMs?: number;
+  // Also how often a live link is checked. Defaults to 5000.
+  maxBackoffMs?: number;
+}
+
+interface ProcessOptions {
+  // Resolve with the values of the last cycle if it finished at most this many
+  // milliseconds ago, without a round-trip to FSUIPC
+  maxAgeMs?: number;
+}
+
+interface AddOptions {
+  // Serve the offset from the native mirror of the offset space while it was
+  // fetched at most this many milliseconds ago
+  maxAgeMs?: number;
+}
+
+interface ProcessSyncOptions {
+  // Throw an FSUIPCError with ErrorCode.TIMEOUT if the cycle takes longer than
+  // this many milliseconds, defaults to 1000
+  timeout?: number;
+}
+
+interface FlushOptions {
+  // Reject with ErrorCode.TIMEOUT if the writes take longer than this many
+  // milliseconds, defaults to 1000
+  timeout?: number;
+}
+
+interface ProcessSerializedOptions {
+  // Defaults to 'json'
+  format?: 'json' | 'msgpack';
+}
+
+interface PollingOptions {
+  hz: number;
+  // After a cycle overruns its period, skip the deadlines that passed or run
+  // cycles back to back until caught up. Defaults to skip.
+  overrun?: 'skip' | 'catchUp';
+  // Offsets read along with every cycle that show whether the sim has
+  // advanced. While it hasn't, only they are read, backing off up to
+  // maxBackoffMs.
+  sentinels?: Sentinel[];
+  // Defaults to 1000
+  maxBackoffMs?: number;
+}
+
+interface Sentinel {
+  offset: number;
+  // 1 to 8 bytes
+  size: number;
+  // The sim is idle while this offset is non-zero, such as the pause flag
+  // at 0x0264. Otherwise it is idle while this and all other such sentinels
+  // keep their values.
+  paused?: boolean;
+}
+
+interface PollingStats {
+  cycles: number;
+  // Ticks that found the sim idle and skipped the cycle
+  idle: number;
+  requestedHz: number;
+  // Cycles per second since polling started or stats were reset
+  effectiveHz: number;
+  // Cycles that ended after the next deadline
+  overruns: number;
+  // Deadlines that passed during overruns
+  missed: number;
+  // Milliseconds between each deadline and the actual wakeup
+  lateness: Histogram;
+  // Milliseconds between the actual interval and the period
+  jitter: Histogram;
+}
+
+interface SampleOptions {
+  // At most 1048576, and at most 256 MB of values over all cycles
+  cycles: number;
+  // Cycles per second, at least 0.001, or back to back if omitted or 0
+  hz?: number;
+}
+
+// Strings of all cycles concatenated, the string of cycle i is
+// values[offsets[i]..offsets[i + 1]]
+interface StringColumn {
+  offsets: Int32Array;
+  values: Uint8Array;
+}
+
+type Column = Uint8Array | Int8Array | Int16Array | Int32Array | BigInt64Array |
+  Uint16Array | Uint32Array | BigUint64Array | Float64Array | Float32Array |
+  StringColumn;
+
+interface SampleBatch {
+  // Milliseconds on the process.hrtime() clock
+  timestamps: Float64Array;
+  // One column per offset. Byte and bit arrays are a Uint8Array of
+  // fixed-size rows.
+  columns: {[name: string]: Column};
+}
+
 export class FSUIPC {
-  constructor();
+  constructor(options?: FSUIPCOptions);
 
   open(requestedSimulator?: Simulator): Promise<FSUIPC>;
+  // Serves process() from a capture written by startRecording() instead of
+  // the sim
+  open(options: ReplayOptions): Promise<FSUIPC>;
+  // Opens the link in the background and reopens it whenever the sim goes
+  // away, until close()
+  connect(options?: ConnectOptions): void;
   close(): Promise<FSUIPC>;
-  process(): Promise<object>;
+  on(event: 'connected', listener: (simulator: Simulator) => void): this;
+  on(event: 'disconnected', listener: (error: FSUIPCError) => void): this;
+  // Offsets FSUIPC rejected, which are no longer read
+  on(event: 'error', listener: (error: QuarantineError) => void): this;
+  off(event: 'connected', listener: (simulator: Simulator) => void): this;
+  off(event: 'disconnected', listener: (error: FSUIPCError) => void): this;
+  off(event: 'error', listener: (error: QuarantineError) => void): this;
+  // Moves replay to this many milliseconds after the start of the capture
+  seek(offsetMs: number): void;
+  process(options?: ProcessOptions): Promise<object>;
+  // Runs a cycle on the calling thread, blocking the event loop
+  processSync(options?: ProcessSyncOptions): object;
+  // Runs a cycle and resolves with the result encoded natively, without
+  // creating the result object
+  processSerialized(options?: ProcessSerializedOptions): Promise<Buffer>;
+  // Runs cycles natively and resolves with the values of all of them
+  sample(options: SampleOptions): Promise<SampleBatch>;
 
-  add(name: string, offset: number, type: FixedSizedNumberType | FixedSizedStringType): Offset;
-  add(name: string, offset: number, type: VariableSizedType, length: number): Offset;
+  // Runs cycles natively at a fixed rate and calls callback with the result
+  // of the latest cycle. Results that arrive while the event loop is busy
+  // are coalesced.
+  startPolling(options: PollingOptions, callback: (error: FSUIPCError | null, result?: object) => void): void;
+  stopPolling(): PollingStats | undefined;
+  pollingStats(): PollingStats | undefined;
+
+  add(name: string, offset: number, type: FixedSizedNumberType | FixedSizedStringType, options?: AddOptions): Offset;
+  add(name: string, offset: number, type: VariableSizedType, length: number, options?: AddOptions): Offset;
 
   remove(name: string): Offset;
 
@@ -64,6 +210,262 @@ export class FSUIPC {
   write(offset: number, type: Type.String, length: number, value: string): void;
   // Experimental
   write(offset: number, type: Type.ByteArray, length: number, value: ArrayBufferView): void;
+
+  // Sends the write in its own request like writeNow(), reading the value
+  // back in the same request
+  write(offset: number, type: FixedSizedNumberType, value: number, options: VerifyOptions): Promise<VerifiedWriteResult>;
+  write(offset: number, type: Type.String, length: number, value: string, options: VerifyOptions): Promise<VerifiedWriteResult>;
+  write(offset: number, type: Type.ByteArray, length: number, value: ArrayBufferView, options: VerifyOptions): Promise<VerifiedWriteResult>;
+
+  // Sends the write in its own request ahead of any pending process()
+  writeNow(offset: number, type: FixedSizedNumberType, value: number): Promise<WriteResult>;
+  writeNow(offset: number, type: FixedSizedStringType, value: string): Promise<WriteResult>;
+  writeNow(offset: number, type: Type.String, length: number, value: string): Promise<WriteResult>;
+  writeNow(offset: number, type: Type.ByteArray, length: number, value: ArrayBufferView): Promise<WriteResult>;
+  writeNow(offset: number, type: FixedSizedNumberType, value: number, options: VerifyOptions): Promise<VerifiedWriteResult>;
+  writeNow(offset: number, type: Type.String, length: number, value: string, options: VerifyOptions): Promise<VerifiedWriteResult>;
+  writeNow(offset: number, type: Type.ByteArray, length: number, value: ArrayBufferView, options: VerifyOptions): Promise<VerifiedWriteResult>;
+
+  // Sends all queued writes without reading any offsets
+  flush(options?: FlushOptions): Promise<FSUIPC>;
+
+  // Sends FS controls through 0x3110 in as few requests as possible
+  sendControls(controls: Control[]): Promise<FSUIPC>;
+
+  // Publishes the values of every process() to a SnapshotReader with the same
+  // name, or stops publishing if name is null. Throws if another instance
+  // already shares name
+  shareSnapshot(name: string | null): void;
+  // Publishes the values of every process() into the named file mapping name,
+  // for readers in other languages, or stops publishing if name is null
+  shareState(name: string | null, options?: StateOptions): void;
+
+  // Instrumentation of process() cycles
+  stats(): Stats;
+  resetStats(): void;
+
+  // Records the phases of every process() cycle until stopTrace(), which
+  // returns them as Chrome trace JSON
+  startTrace(): void;
+  stopTrace(): string;
+
+  // Keeps the values of a numeric offset fetched by each cycle in a native
+  // ring buffer, limited by number of samples and/or age
+  enableHistory(name: string, options: HistoryOptions): void;
+  disableHistory(name: string): void;
+  // Samples with fromTs <= timestamp <= toTs, in milliseconds on the
+  // process.hrtime() clock
+  history(name: string, fromTs?: number, toTs?: number): HistoryWindow;
+
+  // Keeps the last samples of a numeric offset to estimate its value between
+  // and after cycles
+  enableEstimate(name: string, options?: EstimateOptions): void;
+  disableEstimate(name: string): void;
+  // Value at t in milliseconds on the process.hrtime() clock, defaults to
+  // now. Undefined until the first cycle.
+  estimate(name: string, t?: number): number | undefined;
+
+  // Reduces the history of several offsets on the threadpool, resolving with
+  // an object keyed by offset name
+  aggregate(names: string[], options: AggregateOptions): Promise<{[name: string]: WindowStats}>;
+  downsample(names: string[], options: DownsampleOptions): Promise<{[name: string]: HistoryWindow}>;
+
+  // Appends every cycle to a capture file until stopRecording()
+  startRecording(path: string): void;
+  stopRecording(): RecordingStats | undefined;
+
+  // Broadcasts every cycle to the Subscribers connected to the named pipe
+  // name until stopPublishing()
+  startPublishing(name: string, options?: PublishingOptions): void;
+  stopPublishing(): PublishingStats | undefined;
+  publishingStats(): PublishingStats | undefined;
+
+  // Reads offsets that keep their value less often, down to minHz, and
+  // every cycle or at maxHz once they change
+  enableAdaptive(options: AdaptiveOptions): void;
+  disableAdaptive(): void;
+  // Current milliseconds between reads of every offset, 0 for every cycle
+  adaptiveIntervals(): {[name: string]: number} | undefined;
+
+  // Names of the offsets left out of cycles since FSUIPC rejected them
+  quarantined(): string[];
+  // Reads all quarantined offsets again, which are quarantined again if
+  // FSUIPC still rejects them
+  clearQuarantine(): void;
+}
+
+interface AdaptiveOptions {
+  minHz: number;
+  // Defaults to every cycle
+  maxHz?: number;
+}
+
+interface PublishingOptions {
+  // Frames queued per subscriber before the oldest are dropped, defaults to 4
+  queueSize?: number;
+}
+
+interface PublishingStats {
+  subscribers: number;
+  frames: number;
+  // Frames dropped because a subscriber fell behind
+  dropped: number;
+  // Set once new subscribers can no longer connect
+  error?: string;
+}
+
+interface StateOptions {
+  // Back the mapping with this file instead of the paging file
+  path?: string;
+  // Size of the field table, defaults to 256
+  maxFields?: number;
+  // Bytes available for values, defaults to 65536
+  capacity?: number;
+}
+
+interface RecordingStats {
+  frames: number;
+  // Frames dropped because the writer fell behind the polling rate
+  dropped: number;
+  bytes: number;
+  error?: string;
+}
+
+interface HistoryRange {
+  fromTs?: number;
+  toTs?: number;
+}
+
+interface AggregateOptions extends HistoryRange {
+  windowMs: number;
+}
+
+interface DownsampleOptions extends HistoryRange {
+  // At most this many samples per offset, at least 3
+  points: number;
+  // Largest-Triangle-Three-Buckets, or the minimum and maximum of each bucket.
+  // Defaults to lttb.
+  method?: 'lttb' | 'minmax';
+}
+
+// One element per window of windowMs that contains samples
+interface WindowStats {
+  start: Float64Array;
+  count: Float64Array;
+  min: Float64Array;
+  max: Float64Array;
+  mean: Float64Array;
+  stddev: Float64Array;
+}
+
+interface HistoryOptions {
+  samples?: number;
+  windowMs?: number;
+}
+
+interface EstimateOptions {
+  // Numeric offset with the rate of change of this one, read in the same
+  // cycle. Extrapolates along the last two samples if omitted.
+  velocity?: string;
+  // Multiplies the velocity into units of this offset per second, defaults
+  // to 1
+  velocityScale?: number;
+  // Period of values that wrap around, such as 360 for degrees
+  wrap?: number;
+  // Holds the value this long after the last sample, defaults to 500
+  maxExtrapolationMs?: number;
+}
+
+interface HistoryWindow {
+  timestamps: Float64Array;
+  values: Float64Array;
+}
+
+interface Histogram {
+  count: number;
+  min: number;
+  max: number;
+  mean: number;
+  p50: number;
+  p90: number;
+  p99: number;
+  p999: number;
+}
+
+interface Stats {
+  cycles: number;
+  errors: number;
+  requests: number;
+  bytes: number;
+  retries: number;
+  timeouts: number;
+  bytesPerCycle: Histogram;
+  requestsPerCycle: Histogram;
+  // Durations in milliseconds
+  phases: {
+    queueWait: Histogram;
+    mutexWait: Histogram;
+    encode: Histogram;
+    roundTrip: Histogram;
+    decode: Histogram;
+    materialize: Histogram;
+  };
+}
+
+export class SnapshotReader {
+  constructor(name: string);
+
+  // Latest values published by shareSnapshot(), or null if none yet
+  read(): object | null;
+}
+
+export class Subscriber {
+  // Connects to a publisher started with startPublishing(name) in the
+  // background. The callback, if any, is called with every frame received,
+  // and with an error if the publisher can't be reached or goes away. Without
+  // a callback, read() throws that error.
+  constructor(name: string, callback?: (error: Error | null, result?: object) => void);
+
+  // Latest values received, or null if none yet
+  read(): object | null;
+  close(): void;
+}
+
+export class DeltaStream {
+  // Encodes the values of the last cycle of fsuipc as frames of the delta wire
+  // format. A key frame is sent every keyFrameInterval frames, defaults to 100.
+  constructor(fsuipc: FSUIPC, options?: {keyFrameInterval?: number});
+
+  next(): Buffer;
+  // Makes the next frame a key frame, such as when a client joins
+  keyFrame(): void;
+}
+
+export class DeltaReader {
+  // Values of the frame in the shape of the result of process(), or null for
+  // a delta that arrived before the first key frame
+  decode(frame: ArrayBufferView): object | null;
+}
+
+interface Control {
+  control: number;
+  param?: number;
+}
+
+interface WriteResult {
+  // Milliseconds from the writeNow() call until FSUIPC acknowledged the request
+  latency: number;
+}
+
+interface VerifyOptions {
+  verify: true;
+}
+
+interface VerifiedWriteResult extends WriteResult {
+  // The value of the range right after the write
+  value: number | string | number[];
+  // Whether the sim changed the value from the one written
+  mismatch: boolean;
 }
 
 export enum ErrorCode {
@@ -105,3 +507,7 @@ export class FSUIPCError extends Error {
 
   code: ErrorCode;
 }
+
+interface QuarantineError extends FSUIPCError {
+  offsets: string[];
+}
@@ -0,0 +1,25 @@
+#include "AdaptiveRate.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace FSUIPC {
+
+void AdaptiveRate::Update(uint64_t now,
+                          const void* value,
+                          uint64_t min_interval,
+                          uint64_t max_interval) {
+  if (!this->has_previous ||
+      memcmp(this->previous.data(), value, this->previous.size())) {
+    CopyMemory(this->previous.data(), value, this->previous.size());
+    this->has_previous = true;
+    this->changed = now;
+  }
+
+  this->interval = std::min<uint64_t>(
+      std::max<uint64_t>((now - this->changed) / 4, min_interval),
+      max_interval);
+  this->next = now + this->interval;
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,41 @@
+#ifndef ADAPTIVERATE_H
+#define ADAPTIVERATE_H
+
+#include <windows.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace FSUIPC {
+
+// Read schedule of a single offset in adaptive polling. An offset that keeps
+// its value is read less and less often, at intervals of a quarter of the
+// time it has been quiet, within the bounds of the minimum and maximum rate.
+// As soon as a read sees a change, it is back at the maximum rate.
+class AdaptiveRate {
+ public:
+  explicit AdaptiveRate(DWORD size) : previous(size) {}
+
+  bool Due(uint64_t now) const { return now >= this->next; }
+
+  // Called with the value of every read of the offset, with intervals in
+  // nanoseconds. A min_interval of 0 reads changing offsets every cycle.
+  void Update(uint64_t now,
+              const void* value,
+              uint64_t min_interval,
+              uint64_t max_interval);
+
+  // Nanoseconds between the last read and the next one
+  uint64_t Interval() const { return this->interval; }
+
+ private:
+  std::vector<BYTE> previous;
+  bool has_previous = false;
+  uint64_t changed = 0;  // uv_hrtime() of the last read that saw a change
+  uint64_t next = 0;
+  uint64_t interval = 0;
+};
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,186 @@
+#include "Aggregate.h"
+
+#include <cmath>
+
+namespace FSUIPC {
+
+// The reductions below keep one accumulator per operation and no branches in
+// the loop body, so the compiler can vectorize them.
+
+static double Min(const double* values, size_t n) {
+  double result = values[0];
+  for (size_t i = 1; i < n; i++) {
+    result = values[i] < result ? values[i] : result;
+  }
+  return result;
+}
+
+static double Max(const double* values, size_t n) {
+  double result = values[0];
+  for (size_t i = 1; i < n; i++) {
+    result = values[i] > result ? values[i] : result;
+  }
+  return result;
+}
+
+static double Sum(const double* values, size_t n) {
+  double result = 0;
+  for (size_t i = 0; i < n; i++) {
+    result += values[i];
+  }
+  return result;
+}
+
+// Sum of squared deviations from mean. Two passes are more stable than
+// accumulating the sum of squares.
+static double SquaredDeviations(const double* values, size_t n, double mean) {
+  double result = 0;
+  for (size_t i = 0; i < n; i++) {
+    double deviation = values[i] - mean;
+    result += deviation * deviation;
+  }
+  return result;
+}
+
+void Aggregate(const Series& series, double window_ms, WindowStats* out) {
+  const double* timestamps = series.timestamps.data();
+  const double* values = series.values.data();
+  size_t n = series.values.size();
+
+  size_t begin = 0;
+  while (begin < n) {
+    double start = std::floor(timestamps[begin] / window_ms) * window_ms;
+    double end = start + window_ms;
+
+    size_t finish = begin + 1;
+    while (finish < n && timestamps[finish] < end) {
+      finish++;
+    }
+
+    size_t count = finish - begin;
+    double mean = Sum(values + begin, count) / count;
+
+    out->start.push_back(start);
+    out->count.push_back((double)count);
+    out->min.push_back(Min(values + begin, count));
+    out->max.push_back(Max(values + begin, count));
+    out->mean.push_back(mean);
+    out->stddev.push_back(
+        std::sqrt(SquaredDeviations(values + begin, count, mean) / count));
+
+    begin = finish;
+  }
+}
+
+static void LTTB(const Series& series, size_t points, Series* out) {
+  const double* x = series.timestamps.data();
+  const double* y = series.values.data();
+  size_t n = series.values.size();
+
+  out->timestamps.reserve(points);
+  out->values.reserve(points);
+
+  // First and last samples are always kept, the rest are split in buckets
+  // that each contribute the sample forming the largest triangle with the
+  // previously selected sample and the average of the next bucket
+  double bucket_size = (double)(n - 2) / (points - 2);
+
+  size_t selected = 0;
+  out->timestamps.push_back(x[0]);
+  out->values.push_back(y[0]);
+
+  for (size_t bucket = 0; bucket < points - 2; bucket++) {
+    size_t begin = (size_t)(bucket * bucket_size) + 1;
+    size_t end = (size_t)((bucket + 1) * bucket_size) + 1;
+
+    size_t next_begin = end;
+    size_t next_end = (size_t)((bucket + 2) * bucket_size) + 1;
+    if (next_end > n) {
+      next_end = n;
+    }
+
+    size_t next_count = next_end - next_begin;
+    double next_x = Sum(x + next_begin, next_count) / next_count;
+    double next_y = Sum(y + next_begin, next_count) / next_count;
+
+    double best_area = -1;
+    size_t best = begin;
+
+    for (size_t i = begin; i < end; i++) {
+      double area = std::fabs((x[selected] - next_x) * (y[i] - y[selected]) -
+                              (x[selected] - x[i]) * (next_y - y[selected]));
+      if (area > best_area) {
+        best_area = area;
+        best = i;
+      }
+    }
+
+    out->timestamps.push_back(x[best]);
+    out->values.push_back(y[best]);
+    selected = best;
+  }
+
+  out->timestamps.push_back(x[n - 1]);
+  out->values.push_back(y[n - 1]);
+}
+
+static void MinMaxBuckets(const Series& series, size_t points, Series* out) {
+  const double* x = series.timestamps.data();
+  const double* y = series.values.data();
+  size_t n = series.values.size();
+
+  size_t buckets = points / 2;
+  double bucket_size = (double)n / buckets;
+
+  out->timestamps.reserve(buckets * 2);
+  out->values.reserve(buckets * 2);
+
+  for (size_t bucket = 0; bucket < buckets; bucket++) {
+    size_t begin = (size_t)(bucket * bucket_size);
+    size_t end = (size_t)((bucket + 1) * bucket_size);
+    if (bucket == buckets - 1) {
+      end = n;
+    }
+
+    size_t min = begin;
+    size_t max = begin;
+    for (size_t i = begin + 1; i < end; i++) {
+      min = y[i] < y[min] ? i : min;
+      max = y[i] > y[max] ? i : max;
+    }
+
+    // Emitted in time order, so the result can be drawn as a line
+    size_t first = min < max ? min : max;
+    size_t second = min < max ? max : min;
+
+    out->timestamps.push_back(x[first]);
+    out->values.push_back(y[first]);
+    if (second != first) {
+      out->timestamps.push_back(x[second]);
+      out->values.push_back(y[second]);
+    }
+  }
+}
+
+void Downsample(const Series& series,
+                DownsampleMethod method,
+                size_t points,
+                Series* out) {
+  size_t n = series.values.size();
+
+  if (n <= points || points < (method == DownsampleMethod::LTTB ? 3 : 2)) {
+    *out = series;
+    return;
+  }
+
+  switch (method) {
+    case DownsampleMethod::LTTB:
+      LTTB(series, points, out);
+      break;
+    case DownsampleMethod::MinMax:
+      MinMaxBuckets(series, points, out);
+      break;
+  }
+}
+
+}  // namespace FSUIPC
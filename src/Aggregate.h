@@ -0,0 +1,45 @@
+#ifndef AGGREGATE_H
+#define AGGREGATE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace FSUIPC {
+
+// Samples of a single offset as two parallel arrays, so reductions over the
+// values run over contiguous doubles
+struct Series {
+  std::vector<double> timestamps;  // Milliseconds, ascending
+  std::vector<double> values;
+};
+
+// Statistics of consecutive windows of a series, one element per window that
+// contains at least one sample
+struct WindowStats {
+  std::vector<double> start;  // Start of the window in milliseconds
+  std::vector<double> count;
+  std::vector<double> min;
+  std::vector<double> max;
+  std::vector<double> mean;
+  std::vector<double> stddev;  // Population standard deviation
+};
+
+enum class DownsampleMethod {
+  LTTB,    // Largest-Triangle-Three-Buckets
+  MinMax,  // Minimum and maximum of every bucket
+};
+
+// Splits series into windows of window_ms milliseconds, aligned to
+// multiples of window_ms, and reduces every window
+void Aggregate(const Series& series, double window_ms, WindowStats* out);
+
+// Reduces series to at most points samples. Series that are already small
+// enough are copied unchanged.
+void Downsample(const Series& series,
+                DownsampleMethod method,
+                size_t points,
+                Series* out);
+
+}  // namespace FSUIPC
+
+#endif
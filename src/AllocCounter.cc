@@ -0,0 +1,64 @@
+// Counts native allocations made by the addon, so tests can check that
+// steady-state cycles don't allocate. Only built with -Dalloc_counter=true.
+#ifdef FSUIPC_ALLOC_COUNTER
+
+#include <nan.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+std::atomic<uint64_t> allocations{0};
+}
+
+void* operator new(size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* ptr = malloc(size ? size : 1)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) {
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return malloc(size ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  free(ptr);
+}
+
+namespace FSUIPC {
+
+NAN_METHOD(GetAllocations) {
+  info.GetReturnValue().Set(Nan::New((double)allocations.load()));
+}
+
+NAN_MODULE_INIT(InitAllocCounter) {
+  Nan::SetMethod(target, "allocations", GetAllocations);
+}
+
+}  // namespace FSUIPC
+
+#endif
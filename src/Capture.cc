@@ -0,0 +1,286 @@
+#include "Capture.h"
+
+#include <cstring>
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+static const char kMagic[8] = {'F', 'S', 'U', 'I', 'P', 'C', 'R', 'C'};
+static const uint32_t kVersion = 1;
+
+static const BYTE kLayoutTag = 'L';
+static const BYTE kKeyFrameTag = 'K';
+static const BYTE kDeltaTag = 'D';
+
+// Unchanged runs shorter than this are folded into the surrounding changed
+// bytes, as a new run would cost more than the bytes themselves
+static const size_t kMinUnchangedRun = 3;
+
+void PutVarint(uint64_t value, std::vector<BYTE>* out) {
+  while (value >= 0x80) {
+    out->push_back((BYTE)(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back((BYTE)value);
+}
+
+bool GetVarint(const BYTE* data,
+               size_t size,
+               size_t* position,
+               uint64_t* value) {
+  uint64_t result = 0;
+
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (*position >= size) {
+      return false;
+    }
+
+    BYTE byte = data[(*position)++];
+    result |= (uint64_t)(byte & 0x7F) << shift;
+
+    if (!(byte & 0x80)) {
+      *value = result;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void CaptureEncoder::EncodeHeader(std::vector<BYTE>* out) {
+  out->insert(out->end(), kMagic, kMagic + sizeof(kMagic));
+  for (int i = 0; i < 4; i++) {
+    out->push_back((BYTE)(kVersion >> (i * 8)));
+  }
+}
+
+void CaptureEncoder::EncodeLayout(uint64_t version,
+                                  const std::vector<CaptureField>& layout,
+                                  std::vector<BYTE>* out) {
+  out->push_back(kLayoutTag);
+  PutVarint(version, out);
+  PutVarint(layout.size(), out);
+
+  std::vector<CaptureField>::const_iterator it = layout.begin();
+  for (; it != layout.end(); ++it) {
+    PutVarint(it->name.size(), out);
+    out->insert(out->end(), it->name.begin(), it->name.end());
+    PutVarint(static_cast<uint64_t>(it->type), out);
+    PutVarint(it->offset, out);
+    PutVarint(it->size, out);
+  }
+}
+
+void CaptureEncoder::EncodeKeyFrame(uint64_t sequence,
+                                    uint64_t timestamp,
+                                    const std::vector<BYTE>& data,
+                                    std::vector<BYTE>* out) {
+  out->push_back(kKeyFrameTag);
+  PutVarint(sequence, out);
+  PutVarint(timestamp, out);
+  PutVarint(data.size(), out);
+  out->insert(out->end(), data.begin(), data.end());
+}
+
+void CaptureEncoder::Encode(const CaptureFrame& frame,
+                            std::vector<BYTE>* out) {
+  if (frame.has_layout) {
+    EncodeLayout(frame.layout_version, frame.layout, out);
+
+    // Frames after a layout change can't be deltas of the previous frame
+    this->has_previous = false;
+  }
+
+  size_t size = frame.data.size();
+
+  if (!this->has_previous || this->previous.size() != size ||
+      this->since_key >= kKeyFrameInterval) {
+    EncodeKeyFrame(frame.sequence, frame.timestamp, frame.data, out);
+
+    this->since_key = 0;
+  } else {
+    const BYTE* data = frame.data.data();
+    const BYTE* previous = this->previous.data();
+
+    this->delta.clear();
+
+    size_t i = 0;
+    while (i < size) {
+      size_t unchanged = i;
+      while (unchanged < size && data[unchanged] == previous[unchanged]) {
+        unchanged++;
+      }
+
+      // Extend the changed run over short unchanged gaps
+      size_t changed = unchanged;
+      size_t gap = 0;
+      while (changed + gap < size) {
+        if (data[changed + gap] != previous[changed + gap]) {
+          changed += gap + 1;
+          gap = 0;
+        } else if (++gap >= kMinUnchangedRun) {
+          break;
+        }
+      }
+
+      PutVarint(unchanged - i, &this->delta);
+      PutVarint(changed - unchanged, &this->delta);
+      for (size_t j = unchanged; j < changed; j++) {
+        this->delta.push_back(data[j] ^ previous[j]);
+      }
+
+      i = changed;
+      if (i == unchanged) {
+        // Only unchanged bytes were left
+        break;
+      }
+    }
+
+    out->push_back(kDeltaTag);
+    PutVarint(frame.sequence - this->sequence, out);
+    PutVarint(frame.timestamp - this->timestamp, out);
+    PutVarint(this->delta.size(), out);
+    out->insert(out->end(), this->delta.begin(), this->delta.end());
+
+    this->since_key++;
+  }
+
+  this->previous.assign(frame.data.begin(), frame.data.end());
+  this->has_previous = true;
+  this->sequence = frame.sequence;
+  this->timestamp = frame.timestamp;
+}
+
+bool CaptureDecoder::DecodeHeader(const BYTE* data,
+                                  size_t size,
+                                  size_t* position) {
+  if (size < sizeof(kMagic) + 4 ||
+      std::memcmp(data, kMagic, sizeof(kMagic)) != 0) {
+    return false;
+  }
+
+  uint32_t version = 0;
+  for (int i = 0; i < 4; i++) {
+    version |= (uint32_t)data[sizeof(kMagic) + i] << (i * 8);
+  }
+
+  if (version != kVersion) {
+    return false;
+  }
+
+  *position = sizeof(kMagic) + 4;
+  return true;
+}
+
+CaptureDecoder::Record CaptureDecoder::Next(const BYTE* data,
+                                            size_t size,
+                                            size_t* position) {
+  if (*position >= size || data[*position] == 0) {
+    return Record::End;
+  }
+
+  BYTE tag = data[(*position)++];
+  uint64_t a, b, length;
+
+  switch (tag) {
+    case kLayoutTag: {
+      uint64_t count;
+      if (!GetVarint(data, size, position, &this->layout_version) ||
+          !GetVarint(data, size, position, &count)) {
+        return Record::Invalid;
+      }
+
+      // A layout that fails halfway doesn't replace the current one
+      std::vector<CaptureField> layout;
+      size_t frame_size = 0;
+
+      for (uint64_t i = 0; i < count; i++) {
+        uint64_t name_size, type, offset, field_size;
+
+        if (!GetVarint(data, size, position, &name_size) ||
+            name_size > size - *position) {
+          return Record::Invalid;
+        }
+
+        std::string name((const char*)data + *position, (size_t)name_size);
+        *position += (size_t)name_size;
+
+        if (!GetVarint(data, size, position, &type) ||
+            !GetVarint(data, size, position, &offset) ||
+            !GetVarint(data, size, position, &field_size) ||
+            type > static_cast<uint64_t>(Type::BitArray) || field_size == 0 ||
+            field_size > 0xFFFF) {
+          return Record::Invalid;
+        }
+
+        // Numbers are decoded through their own size, whatever the record
+        // says
+        DWORD type_size = get_size_of_type((Type)type);
+        if (type_size && field_size != type_size) {
+          return Record::Invalid;
+        }
+
+        layout.push_back(CaptureField{name, static_cast<Type>(type),
+                                      (DWORD)offset, (DWORD)field_size});
+        frame_size += (size_t)field_size;
+      }
+
+      this->layout.swap(layout);
+      this->frame_size = frame_size;
+      this->has_frame = false;
+      return Record::Layout;
+    }
+    case kKeyFrameTag: {
+      if (!GetVarint(data, size, position, &a) ||
+          !GetVarint(data, size, position, &b) ||
+          !GetVarint(data, size, position, &length) ||
+          length != this->frame_size || length > size - *position) {
+        return Record::Invalid;
+      }
+
+      this->frame.assign(data + *position, data + *position + length);
+      *position += (size_t)length;
+
+      this->sequence = a;
+      this->timestamp = b;
+      this->has_frame = true;
+      return Record::Frame;
+    }
+    case kDeltaTag: {
+      if (!this->has_frame || !GetVarint(data, size, position, &a) ||
+          !GetVarint(data, size, position, &b) ||
+          !GetVarint(data, size, position, &length) ||
+          length > size - *position) {
+        return Record::Invalid;
+      }
+
+      size_t end = *position + (size_t)length;
+      size_t i = 0;
+
+      while (*position < end) {
+        uint64_t unchanged, changed;
+        if (!GetVarint(data, end, position, &unchanged) ||
+            !GetVarint(data, end, position, &changed) ||
+            unchanged > this->frame.size() - i ||
+            changed > this->frame.size() - i - unchanged ||
+            changed > end - *position) {
+          return Record::Invalid;
+        }
+
+        i += (size_t)unchanged;
+        for (uint64_t j = 0; j < changed; j++) {
+          this->frame[i++] ^= data[(*position)++];
+        }
+      }
+
+      this->sequence += a;
+      this->timestamp += b;
+      return Record::Frame;
+    }
+    default:
+      return Record::Invalid;
+  }
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,114 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <windows.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace FSUIPC {
+
+enum class Type;
+
+// Binary capture format shared by the flight recorder and replay.
+//
+// A capture starts with the 8 byte magic "FSUIPCRC" and a 4 byte version,
+// followed by records that each start with a tag byte. All integers in
+// records are LEB128 varints.
+//
+//   'L' layout:    version, field count, then per field: name length, name,
+//                  type, offset, size
+//   'K' key frame: sequence, timestamp, data length, data
+//   'D' delta:     sequence delta, timestamp delta, encoded length, then
+//                  runs of (unchanged bytes, changed bytes, changed bytes
+//                  XORed with the previous frame) covering the frame
+//
+// Frame data is the values of all fields concatenated in layout order. A tag
+// of 0 marks the end of the capture, so a capture that was not closed
+// cleanly ends at the first unwritten byte.
+
+struct CaptureField {
+  std::string name;
+  Type type;
+  DWORD offset;
+  DWORD size;
+};
+
+struct CaptureFrame {
+  uint64_t sequence;
+  uint64_t timestamp;  // uv_hrtime()
+  // Set on the first frame with a new layout
+  bool has_layout;
+  uint64_t layout_version;
+  std::vector<CaptureField> layout;
+  std::vector<BYTE> data;
+};
+
+class CaptureEncoder {
+ public:
+  static void EncodeHeader(std::vector<BYTE>* out);
+
+  // Single records, for streams where frames may be dropped and so can't be
+  // deltas of each other
+  static void EncodeLayout(uint64_t version,
+                           const std::vector<CaptureField>& layout,
+                           std::vector<BYTE>* out);
+  static void EncodeKeyFrame(uint64_t sequence,
+                             uint64_t timestamp,
+                             const std::vector<BYTE>& data,
+                             std::vector<BYTE>* out);
+
+  // Appends the records of frame to out, as a delta of the previous frame
+  // where possible
+  void Encode(const CaptureFrame& frame, std::vector<BYTE>* out);
+
+ private:
+  // A key frame is written at least this often, so a damaged capture can be
+  // decoded again from the next one
+  static const uint32_t kKeyFrameInterval = 256;
+
+  bool has_previous = false;
+  uint32_t since_key = 0;
+  uint64_t sequence = 0;
+  uint64_t timestamp = 0;
+  std::vector<BYTE> previous;
+  std::vector<BYTE> delta;  // Reused between frames
+};
+
+class CaptureDecoder {
+ public:
+  enum class Record { Layout, Frame, End, Invalid };
+
+  // Checks the header and moves position past it
+  static bool DecodeHeader(const BYTE* data, size_t size, size_t* position);
+
+  // Decodes the record at position and moves position past it
+  Record Next(const BYTE* data, size_t size, size_t* position);
+
+  const std::vector<CaptureField>& Layout() const { return this->layout; }
+  uint64_t LayoutVersion() const { return this->layout_version; }
+  const std::vector<BYTE>& Data() const { return this->frame; }
+  uint64_t Sequence() const { return this->sequence; }
+  uint64_t Timestamp() const { return this->timestamp; }
+
+ private:
+  std::vector<CaptureField> layout;
+  uint64_t layout_version = 0;
+  size_t frame_size = 0;
+
+  bool has_frame = false;
+  std::vector<BYTE> frame;
+  uint64_t sequence = 0;
+  uint64_t timestamp = 0;
+};
+
+void PutVarint(uint64_t value, std::vector<BYTE>* out);
+bool GetVarint(const BYTE* data,
+               size_t size,
+               size_t* position,
+               uint64_t* value);
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,151 @@
+#include "Connection.h"
+
+#include <algorithm>
+
+namespace FSUIPC {
+
+ConnectionManager::ConnectionManager() {
+  this->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+  this->wake_event = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+ConnectionManager::~ConnectionManager() {
+  this->Stop();
+
+  if (this->stop_event) {
+    CloseHandle(this->stop_event);
+  }
+  if (this->wake_event) {
+    CloseHandle(this->wake_event);
+  }
+}
+
+bool ConnectionManager::Start(
+    IPCUser* ipc,
+    std::timed_mutex* mutex,
+    Simulator requested,
+    uint64_t min_backoff,
+    uint64_t max_backoff,
+    std::function<void(const ConnectionEvent&)> on_change) {
+  if (!this->stop_event || !this->wake_event || this->running) {
+    return false;
+  }
+
+  this->ipc = ipc;
+  this->mutex = mutex;
+  this->requested = requested;
+  this->min_backoff = std::max<uint64_t>(min_backoff, 1000000);
+  this->max_backoff = std::max<uint64_t>(max_backoff, this->min_backoff);
+  this->on_change = std::move(on_change);
+
+  ResetEvent(this->stop_event);
+  ResetEvent(this->wake_event);
+
+  this->running = true;
+  this->thread = std::thread(&ConnectionManager::Run, this);
+
+  return true;
+}
+
+void ConnectionManager::Stop() {
+  if (!this->running.exchange(false)) {
+    return;
+  }
+
+  SetEvent(this->stop_event);
+  this->thread.join();
+}
+
+void ConnectionManager::LinkFailed(Error error) {
+  this->last_error = static_cast<int>(error);
+
+  if (this->wake_event) {
+    SetEvent(this->wake_event);
+  }
+}
+
+bool ConnectionManager::Wait(uint64_t duration, bool wakeable) {
+  HANDLE handles[] = {this->stop_event, this->wake_event};
+
+  WaitForMultipleObjects(wakeable ? 2 : 1, handles, FALSE,
+                         (DWORD)std::min<uint64_t>(duration / 1000000,
+                                                   INFINITE - 1));
+
+  return this->running;
+}
+
+void ConnectionManager::Run() {
+  uint64_t backoff = this->min_backoff;
+  bool connected = false;
+
+  while (this->running) {
+    if (!connected) {
+      // Finding the window is cheap, the handshake is only tried once there
+      // is one
+      if (IPCUser::Probe()) {
+        // Closed after the mutex, if open() connected in the meantime
+        IPCUser link;
+        Simulator simulator = Simulator::ANY;
+        Error result;
+
+        {
+          std::lock_guard<std::timed_mutex> guard(*this->mutex);
+          connected = this->ipc->Alive();
+          simulator = this->ipc->GetSimulator();
+        }
+
+        if (!connected && link.Open(this->requested, &result)) {
+          std::lock_guard<std::timed_mutex> guard(*this->mutex);
+
+          if (!this->ipc->Alive()) {
+            this->ipc->Close();
+            this->ipc->Swap(&link);
+          }
+
+          connected = true;
+          simulator = this->ipc->GetSimulator();
+        }
+
+        if (connected) {
+          this->last_error = 0;
+          this->on_change(ConnectionEvent{true, Error::OK, simulator});
+        }
+      }
+
+      if (connected) {
+        backoff = this->min_backoff;
+        continue;
+      }
+
+      // Failing cycles don't shorten the backoff
+      if (!this->Wait(backoff, false)) {
+        break;
+      }
+
+      backoff = std::min<uint64_t>(backoff * 2, this->max_backoff);
+      continue;
+    }
+
+    if (!this->Wait(this->max_backoff, true)) {
+      break;
+    }
+
+    {
+      std::lock_guard<std::timed_mutex> guard(*this->mutex);
+
+      // A busy sim times out without the window going away
+      if (this->ipc->Alive()) {
+        continue;
+      }
+
+      this->ipc->Close();
+      connected = false;
+    }
+
+    Error error = static_cast<Error>(this->last_error.load());
+    this->on_change(ConnectionEvent{
+        false, error == Error::OK ? Error::NOFS : error, Simulator::ANY});
+  }
+}
+
+}  // namespace FSUIPC
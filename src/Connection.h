@@ -0,0 +1,71 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <windows.h>
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "IPCUser.h"
+
+namespace FSUIPC {
+
+struct ConnectionEvent {
+  bool connected;
+  Error error;          // Why the link was lost
+  Simulator simulator;  // The sim connected to
+};
+
+// Keeps an own IPC link open in the background. While disconnected, probes
+// for the window of FSUIPC or WideClient with exponential backoff, and opens
+// the link as soon as it appears. While connected, checks that the window
+// still exists every max_backoff, or right away when a cycle fails on the
+// link, and closes the link once it is gone.
+//
+// Changes are reported to on_change on the manager's thread, once the link's
+// mutex is released. The handshake runs on a link of its own, which is only
+// swapped in under the mutex, so cycles never wait for it.
+class ConnectionManager {
+ public:
+  ConnectionManager();
+  ~ConnectionManager();
+
+  bool Start(IPCUser* ipc,
+             std::timed_mutex* mutex,
+             Simulator requested,
+             uint64_t min_backoff,
+             uint64_t max_backoff,
+             std::function<void(const ConnectionEvent&)> on_change);
+  void Stop();
+
+  bool Running() const { return this->running.load(); }
+
+  // Wakes the manager to check the link after a cycle failed with error. May
+  // be called from any thread, also while stopped.
+  void LinkFailed(Error error);
+
+ private:
+  void Run();
+  // Waits for the given nanoseconds, or until LinkFailed() if wakeable.
+  // Returns false once stopping.
+  bool Wait(uint64_t duration, bool wakeable);
+
+  IPCUser* ipc = nullptr;
+  std::timed_mutex* mutex = nullptr;
+  Simulator requested = Simulator::ANY;
+  uint64_t min_backoff = 0;
+  uint64_t max_backoff = 0;
+  std::function<void(const ConnectionEvent&)> on_change;
+
+  HANDLE stop_event = NULL;
+  HANDLE wake_event = NULL;  // Auto-reset, set by LinkFailed()
+  std::atomic<int> last_error{0};
+  std::atomic<bool> running{false};
+  std::thread thread;
+};
+
+}  // namespace FSUIPC
+
+#endif
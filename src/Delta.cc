@@ -0,0 +1,317 @@
+#include "Delta.h"
+
+#include <cstring>
+
+#include "Capture.h"
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+static const BYTE kKeyFrameTag = 'K';
+static const BYTE kDeltaTag = 'D';
+
+enum class Encoding { Integer, Float, Raw };
+
+static Encoding GetEncoding(Type type) {
+  switch (type) {
+    case Type::Double:
+    case Type::Single:
+      return Encoding::Float;
+    case Type::ByteArray:
+    case Type::String:
+    case Type::BitArray:
+      return Encoding::Raw;
+    default:
+      return Encoding::Integer;
+  }
+}
+
+static bool IsSigned(Type type) {
+  return type == Type::SByte || type == Type::Int16 || type == Type::Int32 ||
+         type == Type::Int64;
+}
+
+// Reads a little-endian integer of size bytes, sign extended for signed
+// types
+static uint64_t LoadInteger(Type type, const BYTE* data, DWORD size) {
+  uint64_t value = 0;
+  CopyMemory(&value, data, size);
+
+  if (IsSigned(type) && size < 8 && (data[size - 1] & 0x80)) {
+    value |= ~(uint64_t)0 << (size * 8);
+  }
+
+  return value;
+}
+
+static uint64_t ZigZag(uint64_t value) {
+  return (value << 1) ^ (uint64_t)((int64_t)value >> 63);
+}
+
+static uint64_t UnZigZag(uint64_t value) {
+  return (value >> 1) ^ (~(value & 1) + 1);
+}
+
+static void EncodeValue(Type type,
+                        DWORD size,
+                        const BYTE* value,
+                        const BYTE* previous,
+                        std::vector<BYTE>* out) {
+  switch (GetEncoding(type)) {
+    case Encoding::Integer:
+      PutVarint(ZigZag(LoadInteger(type, value, size) -
+                       LoadInteger(type, previous, size)),
+                out);
+      break;
+    case Encoding::Float: {
+      BYTE bits[8];
+      for (DWORD i = 0; i < size; i++) {
+        bits[i] = value[i] ^ previous[i];
+      }
+
+      // Values that change a little share sign, exponent and often the low
+      // bits of the mantissa
+      DWORD trailing = 0;
+      while (trailing < size && !bits[trailing]) {
+        trailing++;
+      }
+      DWORD leading = 0;
+      while (leading < size - trailing && !bits[size - 1 - leading]) {
+        leading++;
+      }
+
+      out->push_back((BYTE)(leading << 4 | trailing));
+      out->insert(out->end(), bits + trailing, bits + size - leading);
+      break;
+    }
+    case Encoding::Raw:
+      out->insert(out->end(), value, value + size);
+      break;
+  }
+}
+
+void DeltaEncoder::Encode(uint64_t timestamp,
+                          const std::map<std::string, Offset>& offsets,
+                          uint64_t layout_version,
+                          std::vector<BYTE>* out) {
+  std::map<std::string, Offset>::const_iterator it;
+
+  size_t total = 0;
+  for (it = offsets.begin(); it != offsets.end(); ++it) {
+    total += it->second.size;
+  }
+
+  bool key = this->key_frame_requested ||
+             this->layout_version != layout_version ||
+             this->previous.size() != total ||
+             this->since_key >= this->key_frame_interval;
+
+  size_t bitmap = 0;
+
+  if (key) {
+    out->push_back(kKeyFrameTag);
+    PutVarint(this->sequence, out);
+    PutVarint(timestamp, out);
+    PutVarint(offsets.size(), out);
+
+    for (it = offsets.begin(); it != offsets.end(); ++it) {
+      PutVarint(it->second.name.size(), out);
+      out->insert(out->end(), it->second.name.begin(), it->second.name.end());
+      PutVarint(static_cast<uint64_t>(it->second.type), out);
+      PutVarint(it->second.size, out);
+    }
+
+    // Key frames encode every value against zero
+    this->previous.assign(total, 0);
+    this->layout_version = layout_version;
+    this->key_frame_requested = false;
+    this->since_key = 0;
+  } else {
+    out->push_back(kDeltaTag);
+    PutVarint(this->sequence, out);
+    PutVarint(timestamp >= this->timestamp ? timestamp - this->timestamp : 0,
+              out);
+
+    bitmap = out->size();
+    out->resize(bitmap + (offsets.size() + 7) / 8, 0);
+
+    this->since_key++;
+  }
+
+  size_t position = 0;
+  size_t index = 0;
+
+  for (it = offsets.begin(); it != offsets.end(); ++it, ++index) {
+    const BYTE* value = (const BYTE*)it->second.dest;
+    BYTE* previous = this->previous.data() + position;
+    DWORD size = it->second.size;
+
+    position += size;
+
+    if (!key) {
+      if (!memcmp(value, previous, size)) {
+        continue;
+      }
+      (*out)[bitmap + index / 8] |= (BYTE)(1 << (index % 8));
+    }
+
+    EncodeValue(it->second.type, size, value, previous, out);
+    CopyMemory(previous, value, size);
+  }
+
+  this->sequence++;
+  this->timestamp = timestamp;
+}
+
+DeltaDecoder::Result DeltaDecoder::Decode(const BYTE* data, size_t size) {
+  size_t position = 0;
+  uint64_t sequence;
+  uint64_t timestamp;
+
+  if (size == 0) {
+    return Result::Invalid;
+  }
+
+  BYTE tag = data[position++];
+
+  if (!GetVarint(data, size, &position, &sequence) ||
+      !GetVarint(data, size, &position, &timestamp)) {
+    return Result::Invalid;
+  }
+
+  const BYTE* bitmap = nullptr;
+
+  if (tag == kKeyFrameTag) {
+    uint64_t count;
+    if (!GetVarint(data, size, &position, &count) || count > size) {
+      return Result::Invalid;
+    }
+
+    this->has_key = false;
+    this->fields.clear();
+    this->positions.clear();
+
+    size_t total = 0;
+
+    for (uint64_t i = 0; i < count; i++) {
+      uint64_t name_length;
+      if (!GetVarint(data, size, &position, &name_length) ||
+          name_length > size - position) {
+        return Result::Invalid;
+      }
+
+      std::string name((const char*)data + position, (size_t)name_length);
+      position += (size_t)name_length;
+
+      uint64_t type;
+      uint64_t field_size;
+      if (!GetVarint(data, size, &position, &type) ||
+          !GetVarint(data, size, &position, &field_size) ||
+          type > static_cast<uint64_t>(Type::BitArray) || field_size == 0 ||
+          field_size > 0xFFFF) {
+        return Result::Invalid;
+      }
+
+      // Integers and floats are decoded through 8 bytes
+      if (GetEncoding((Type)type) != Encoding::Raw && field_size > 8) {
+        return Result::Invalid;
+      }
+
+      this->fields.push_back(
+          DeltaField{std::move(name), (Type)type, (DWORD)field_size});
+      this->positions.push_back(total);
+      total += (size_t)field_size;
+    }
+
+    this->values.assign(total, 0);
+    this->generation++;
+    this->timestamp = timestamp;
+  } else if (tag == kDeltaTag) {
+    if (!this->has_key) {
+      return Result::NeedKeyFrame;
+    }
+
+    size_t bitmap_size = (this->fields.size() + 7) / 8;
+    if (bitmap_size > size - position) {
+      this->has_key = false;
+      return Result::Invalid;
+    }
+
+    bitmap = data + position;
+    position += bitmap_size;
+
+    this->timestamp += timestamp;
+  } else {
+    return Result::Invalid;
+  }
+
+  // A frame that fails halfway leaves the values inconsistent
+  this->has_key = this->DecodeValues(data, size, &position, bitmap);
+  this->sequence = sequence;
+
+  return this->has_key ? Result::Frame : Result::Invalid;
+}
+
+bool DeltaDecoder::DecodeValues(const BYTE* data,
+                                size_t size,
+                                size_t* position,
+                                const BYTE* bitmap) {
+  for (size_t i = 0; i < this->fields.size(); i++) {
+    if (bitmap && !(bitmap[i / 8] & (1 << (i % 8)))) {
+      continue;
+    }
+
+    const DeltaField& field = this->fields[i];
+    BYTE* value = this->values.data() + this->positions[i];
+
+    switch (GetEncoding(field.type)) {
+      case Encoding::Integer: {
+        uint64_t delta;
+        if (!GetVarint(data, size, position, &delta)) {
+          return false;
+        }
+
+        uint64_t result =
+            LoadInteger(field.type, value, field.size) + UnZigZag(delta);
+        CopyMemory(value, &result, field.size);
+        break;
+      }
+      case Encoding::Float: {
+        if (*position >= size) {
+          return false;
+        }
+
+        BYTE control = data[(*position)++];
+        DWORD leading = control >> 4;
+        DWORD trailing = control & 0xF;
+
+        if (leading + trailing > field.size) {
+          return false;
+        }
+
+        DWORD count = field.size - leading - trailing;
+        if (count > size - *position) {
+          return false;
+        }
+
+        for (DWORD j = 0; j < count; j++) {
+          value[trailing + j] ^= data[*position + j];
+        }
+        *position += count;
+        break;
+      }
+      case Encoding::Raw:
+        if (field.size > size - *position) {
+          return false;
+        }
+
+        CopyMemory(value, data + *position, field.size);
+        *position += field.size;
+        break;
+    }
+  }
+
+  return *position == size;
+}
+
+}  // namespace FSUIPC
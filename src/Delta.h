@@ -0,0 +1,105 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <windows.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace FSUIPC {
+
+enum class Type;
+struct Offset;
+
+// Compact wire format for streaming values to remote clients, one message per
+// frame. All integers are LEB128 varints.
+//
+//   'K' key frame: sequence, timestamp, field count, then per field: name
+//                  length, name, type, size. Followed by the values of all
+//                  fields, encoded against a previous frame of zeros.
+//   'D' delta:     sequence, timestamp delta, then a bitmap with a bit per
+//                  field, least significant bit first, set if the field
+//                  changed. Followed by the values of the changed fields.
+//
+// Values are encoded against the previous value of the field:
+//   - integer types as the zigzag varint of the difference, wrapping at 64
+//     bits
+//   - single and double as the XOR of their bits, Gorilla-style: a byte
+//     with the number of leading zero bytes in the high and of trailing zero
+//     bytes in the low nibble, then the bytes in between
+//   - strings, byte and bit arrays as is
+//
+// Timestamps are uv_hrtime() nanoseconds.
+
+struct DeltaField {
+  std::string name;
+  Type type;
+  DWORD size;
+};
+
+class DeltaEncoder {
+ public:
+  explicit DeltaEncoder(uint32_t key_frame_interval)
+      : key_frame_interval(key_frame_interval) {}
+
+  // Makes the next frame a key frame, such as when a client joins
+  void RequestKeyFrame() { this->key_frame_requested = true; }
+
+  // Appends a frame with the current values of offsets to out. Must be
+  // called with offsets_mutex held.
+  void Encode(uint64_t timestamp,
+              const std::map<std::string, Offset>& offsets,
+              uint64_t layout_version,
+              std::vector<BYTE>* out);
+
+ private:
+  uint32_t key_frame_interval;
+  bool key_frame_requested = true;
+  uint32_t since_key = 0;
+
+  uint64_t layout_version = 0;
+  uint64_t sequence = 0;
+  uint64_t timestamp = 0;
+  std::vector<BYTE> previous;  // Values of the last frame, in layout order
+};
+
+class DeltaDecoder {
+ public:
+  enum class Result {
+    Frame,
+    // A delta arrived before any key frame, such as after joining a stream
+    NeedKeyFrame,
+    Invalid,
+  };
+
+  Result Decode(const BYTE* data, size_t size);
+
+  const std::vector<DeltaField>& Fields() const { return this->fields; }
+  // Position of the value of every field in Values()
+  const std::vector<size_t>& Positions() const { return this->positions; }
+  const std::vector<BYTE>& Values() const { return this->values; }
+  uint64_t Sequence() const { return this->sequence; }
+  uint64_t Timestamp() const { return this->timestamp; }
+  // Incremented whenever a key frame changes the fields
+  uint64_t Generation() const { return this->generation; }
+
+ private:
+  bool DecodeValues(const BYTE* data,
+                    size_t size,
+                    size_t* position,
+                    const BYTE* bitmap);
+
+  bool has_key = false;
+  std::vector<DeltaField> fields;
+  std::vector<size_t> positions;
+  std::vector<BYTE> values;
+  uint64_t sequence = 0;
+  uint64_t timestamp = 0;
+  uint64_t generation = 0;
+};
+
+}  // namespace FSUIPC
+
+#endif
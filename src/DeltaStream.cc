@@ -0,0 +1,163 @@
+#include "DeltaStream.h"
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+NAN_MODULE_INIT(DeltaStream::Init) {
+  v8::Local<v8::FunctionTemplate> ctor =
+      Nan::New<v8::FunctionTemplate>(DeltaStream::New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("DeltaStream").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "next", Next);
+  Nan::SetPrototypeMethod(ctor, "keyFrame", KeyFrame);
+
+  target->Set(Nan::GetCurrentContext(),
+              Nan::New("DeltaStream").ToLocalChecked(),
+              ctor->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
+}
+
+NAN_METHOD(DeltaStream::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError(
+        Nan::New("DeltaStream.new - called without new keyword")
+            .ToLocalChecked());
+  }
+
+  if (info.Length() < 1 ||
+      !Nan::New(AddonData::Get()->constructor)->HasInstance(info[0])) {
+    return Nan::ThrowTypeError(
+        Nan::New("DeltaStream.new - expected first argument to be FSUIPC")
+            .ToLocalChecked());
+  }
+
+  uint32_t key_frame_interval = 100;
+
+  if (info.Length() > 1) {
+    if (!info[1]->IsObject()) {
+      return Nan::ThrowTypeError(
+          Nan::New("DeltaStream.new - expected second argument to be object")
+              .ToLocalChecked());
+    }
+
+    v8::Local<v8::Value> interval_value =
+        Nan::Get(info[1].As<v8::Object>(),
+                 Nan::New("keyFrameInterval").ToLocalChecked())
+            .ToLocalChecked();
+
+    if (!interval_value->IsUndefined()) {
+      if (!interval_value->IsUint32()) {
+        return Nan::ThrowTypeError(
+            Nan::New("DeltaStream.new - expected keyFrameInterval to be uint")
+                .ToLocalChecked());
+      }
+
+      key_frame_interval =
+          interval_value->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+    }
+  }
+
+  v8::Local<v8::Object> owner = info[0].As<v8::Object>();
+
+  DeltaStream* stream = new DeltaStream(key_frame_interval);
+  stream->fsuipc = Nan::ObjectWrap::Unwrap<FSUIPC>(owner);
+  stream->owner.Reset(owner);
+  stream->Wrap(info.Holder());
+
+  info.GetReturnValue().Set(info.Holder());
+}
+
+DeltaStream::~DeltaStream() {
+  this->owner.Reset();
+}
+
+NAN_METHOD(DeltaStream::Next) {
+  DeltaStream* self = Nan::ObjectWrap::Unwrap<DeltaStream>(info.This());
+  FSUIPC* fsuipc = self->fsuipc;
+
+  self->buffer.clear();
+
+  {
+    std::lock_guard<std::timed_mutex> guard(fsuipc->offsets_mutex);
+    self->encoder.Encode(fsuipc->last_cycle, fsuipc->offsets,
+                         fsuipc->layout_version, &self->buffer);
+  }
+
+  info.GetReturnValue().Set(
+      Nan::CopyBuffer((const char*)self->buffer.data(),
+                      (uint32_t)self->buffer.size())
+          .ToLocalChecked());
+}
+
+NAN_METHOD(DeltaStream::KeyFrame) {
+  DeltaStream* self = Nan::ObjectWrap::Unwrap<DeltaStream>(info.This());
+
+  self->encoder.RequestKeyFrame();
+}
+
+NAN_MODULE_INIT(DeltaReader::Init) {
+  v8::Local<v8::FunctionTemplate> ctor =
+      Nan::New<v8::FunctionTemplate>(DeltaReader::New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("DeltaReader").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "decode", Decode);
+
+  target->Set(Nan::GetCurrentContext(),
+              Nan::New("DeltaReader").ToLocalChecked(),
+              ctor->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
+}
+
+NAN_METHOD(DeltaReader::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError(
+        Nan::New("DeltaReader.new - called without new keyword")
+            .ToLocalChecked());
+  }
+
+  DeltaReader* reader = new DeltaReader();
+  reader->Wrap(info.Holder());
+
+  info.GetReturnValue().Set(info.Holder());
+}
+
+NAN_METHOD(DeltaReader::Decode) {
+  DeltaReader* self = Nan::ObjectWrap::Unwrap<DeltaReader>(info.This());
+
+  if (info.Length() != 1 || !info[0]->IsArrayBufferView()) {
+    return Nan::ThrowTypeError(
+        Nan::New("DeltaReader.decode - expected first argument to be "
+                 "ArrayBufferView")
+            .ToLocalChecked());
+  }
+
+  Nan::TypedArrayContents<uint8_t> frame(info[0]);
+
+  switch (self->decoder.Decode(*frame, frame.length())) {
+    case DeltaDecoder::Result::Frame:
+      break;
+    case DeltaDecoder::Result::NeedKeyFrame:
+      info.GetReturnValue().Set(Nan::Null());
+      return;
+    default:
+      return Nan::ThrowError(
+          Nan::New("DeltaReader.decode - invalid frame").ToLocalChecked());
+  }
+
+  const std::vector<DeltaField>& fields = self->decoder.Fields();
+  const std::vector<size_t>& positions = self->decoder.Positions();
+  BYTE* values = (BYTE*)self->decoder.Values().data();
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  for (size_t i = 0; i < fields.size(); i++) {
+    Nan::Set(obj, Nan::New(fields[i].name).ToLocalChecked(),
+             GetOffsetValue(fields[i].type, values + positions[i],
+                            fields[i].size));
+  }
+
+  info.GetReturnValue().Set(obj);
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,53 @@
+#ifndef DELTASTREAM_H
+#define DELTASTREAM_H
+
+#include <nan.h>
+
+#include <vector>
+
+#include "Delta.h"
+
+namespace FSUIPC {
+
+class FSUIPC;
+
+// Encodes the values of the last cycle of an FSUIPC instance as a frame of
+// the delta wire format, for streaming to remote clients
+class DeltaStream : public Nan::ObjectWrap {
+ public:
+  static NAN_MODULE_INIT(Init);
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(Next);
+  static NAN_METHOD(KeyFrame);
+
+  ~DeltaStream();
+
+ protected:
+  explicit DeltaStream(uint32_t key_frame_interval)
+      : encoder(key_frame_interval) {}
+
+  FSUIPC* fsuipc = nullptr;
+  // Keeps the instance alive as long as the stream
+  Nan::Persistent<v8::Object> owner;
+
+  DeltaEncoder encoder;
+  std::vector<BYTE> buffer;  // Reused between frames
+};
+
+// Decodes frames of the delta wire format into the result object of
+// process()
+class DeltaReader : public Nan::ObjectWrap {
+ public:
+  static NAN_MODULE_INIT(Init);
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(Decode);
+
+ protected:
+  DeltaDecoder decoder;
+};
+
+}  // namespace FSUIPC
+
+#endif
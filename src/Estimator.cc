@@ -0,0 +1,92 @@
+#include "Estimator.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace FSUIPC {
+
+void Estimator::Record(uint64_t timestamp, double value, double rate) {
+  Sample sample{timestamp, value, rate * this->velocity_scale};
+
+  if (this->count && timestamp <= this->last.timestamp) {
+    this->last = sample;
+    return;
+  }
+
+  this->previous = this->last;
+  this->last = sample;
+  this->count = std::min<int>(this->count + 1, 2);
+}
+
+bool Estimator::Estimate(uint64_t timestamp, double* value) const {
+  if (!this->count) {
+    return false;
+  }
+
+  const Sample& last = this->last;
+
+  if (timestamp >= last.timestamp) {
+    double elapsed =
+        std::min<uint64_t>(timestamp - last.timestamp,
+                           this->max_extrapolation) /
+        1e9;
+
+    double rate;
+    if (!this->velocity.empty() && !std::isnan(last.rate)) {
+      rate = last.rate;
+    } else if (this->count == 2) {
+      rate = this->Difference(this->previous.value, last.value) /
+             ((last.timestamp - this->previous.timestamp) / 1e9);
+    } else {
+      rate = 0;
+    }
+
+    *value = this->Normalize(last.value + rate * elapsed);
+    return true;
+  }
+
+  if (this->count == 1 || timestamp <= this->previous.timestamp) {
+    // Nothing is kept from before the previous sample
+    *value = this->count == 1 ? last.value : this->previous.value;
+    return true;
+  }
+
+  double fraction = (double)(timestamp - this->previous.timestamp) /
+                    (last.timestamp - this->previous.timestamp);
+  *value = this->Normalize(
+      this->previous.value +
+      this->Difference(this->previous.value, last.value) * fraction);
+  return true;
+}
+
+double Estimator::Difference(double from, double to) const {
+  double difference = to - from;
+
+  if (this->wrap) {
+    difference = std::fmod(difference, this->wrap);
+    if (difference >= this->wrap / 2) {
+      difference -= this->wrap;
+    } else if (difference < -this->wrap / 2) {
+      difference += this->wrap;
+    }
+  }
+
+  return difference;
+}
+
+double Estimator::Normalize(double value) const {
+  if (!this->wrap) {
+    return value;
+  }
+
+  // Values that can be negative, such as longitude, are centered on zero
+  double low = this->last.value < 0 ? -this->wrap / 2 : 0;
+  value = std::fmod(value - low, this->wrap);
+  if (value < 0) {
+    value += this->wrap;
+  }
+
+  return value + low;
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,65 @@
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <cstdint>
+#include <string>
+
+namespace FSUIPC {
+
+// Dead reckoning for a single numeric offset, so renderers can ask for its
+// value at any time between and after the cycles that read it.
+//
+// Times between the last two samples are interpolated linearly. Later times
+// are extrapolated from the last sample, either along the line through the
+// last two samples or, if a velocity offset is set, with the rate read along
+// with the last sample. Extrapolation stops max_extrapolation nanoseconds
+// after the last sample, so a stalled link holds the value instead of running
+// away.
+//
+// Values that wrap around, such as headings, have a non-zero wrap: the
+// period, over which differences take the shorter way around.
+class Estimator {
+ public:
+  Estimator(const std::string& velocity,
+            double velocity_scale,
+            double wrap,
+            uint64_t max_extrapolation)
+      : velocity(velocity),
+        velocity_scale(velocity_scale),
+        wrap(wrap),
+        max_extrapolation(max_extrapolation) {}
+
+  // rate is the raw value of the velocity offset, ignored without one
+  void Record(uint64_t timestamp, double value, double rate);
+
+  // Returns false until the first sample
+  bool Estimate(uint64_t timestamp, double* value) const;
+
+  // Name of the offset with the rate of change, empty for linear
+  // extrapolation
+  const std::string velocity;
+
+ private:
+  struct Sample {
+    uint64_t timestamp;
+    double value;
+    double rate;  // Per second, after velocity_scale
+  };
+
+  // to - from, the shorter way around if wrapping
+  double Difference(double from, double to) const;
+  // Brings a wrapped value back into the range of the samples
+  double Normalize(double value) const;
+
+  double velocity_scale;
+  double wrap;
+  uint64_t max_extrapolation;
+
+  Sample previous;
+  Sample last;
+  int count = 0;
+};
+
+}  // namespace FSUIPC
+
+#endif
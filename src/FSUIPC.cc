@@ -5,36 +5,124 @@
 #include <node.h>
 #include <windows.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
 #include <string>
+#include <thread>
 
 #include "IPCUser.h"
+#include "Multiplexer.h"
+#include "Publisher.h"
+#include "Recorder.h"
+#include "Serializer.h"
+#include "StateFile.h"
+#include "Snapshot.h"
+
+#define CONTROL_OFFSET 0x3110
 
 namespace FSUIPC {
 
-Nan::Persistent<v8::FunctionTemplate> FSUIPC::constructor;
-Nan::Persistent<v8::Object> FSUIPCError;
+static std::mutex addon_data_mutex;
+static std::map<v8::Isolate*, AddonData*> addon_data;
+
+AddonData* AddonData::Get(v8::Isolate* isolate) {
+  std::lock_guard<std::mutex> guard(addon_data_mutex);
+
+  auto it = addon_data.find(isolate);
+  if (it != addon_data.end()) {
+    return it->second;
+  }
+
+  AddonData* data = new AddonData();
+  addon_data[isolate] = data;
+
+  node::AddEnvironmentCleanupHook(
+      isolate,
+      [](void* arg) {
+        std::lock_guard<std::mutex> guard(addon_data_mutex);
+
+        auto it = addon_data.find(static_cast<v8::Isolate*>(arg));
+        delete it->second;
+        addon_data.erase(it);
+      },
+      isolate);
+
+  return data;
+}
 
 NAN_MODULE_INIT(FSUIPC::Init) {
   v8::Local<v8::FunctionTemplate> ctor =
       Nan::New<v8::FunctionTemplate>(FSUIPC::New);
-  constructor.Reset(ctor);
+  AddonData::Get()->constructor.Reset(ctor);
   ctor->InstanceTemplate()->SetInternalFieldCount(1);
   ctor->SetClassName(Nan::New("FSUIPC").ToLocalChecked());
 
   Nan::SetPrototypeMethod(ctor, "open", Open);
+  Nan::SetPrototypeMethod(ctor, "connect", Connect);
   Nan::SetPrototypeMethod(ctor, "close", Close);
+  Nan::SetPrototypeMethod(ctor, "on", On);
+  Nan::SetPrototypeMethod(ctor, "off", Off);
+  Nan::SetPrototypeMethod(ctor, "seek", Seek);
 
   Nan::SetPrototypeMethod(ctor, "process", Process);
+  Nan::SetPrototypeMethod(ctor, "processSync", ProcessSync);
+  Nan::SetPrototypeMethod(ctor, "processSerialized", ProcessSerialized);
+  Nan::SetPrototypeMethod(ctor, "sample", Sample);
+  Nan::SetPrototypeMethod(ctor, "startPolling", StartPolling);
+  Nan::SetPrototypeMethod(ctor, "stopPolling", StopPolling);
+  Nan::SetPrototypeMethod(ctor, "pollingStats", GetPollingStats);
 
   Nan::SetPrototypeMethod(ctor, "add", Add);
   Nan::SetPrototypeMethod(ctor, "remove", Remove);
 
   Nan::SetPrototypeMethod(ctor, "write", Write);
+  Nan::SetPrototypeMethod(ctor, "writeNow", WriteNow);
+  Nan::SetPrototypeMethod(ctor, "flush", Flush);
+  Nan::SetPrototypeMethod(ctor, "sendControls", SendControls);
+  Nan::SetPrototypeMethod(ctor, "shareSnapshot", ShareSnapshot);
+  Nan::SetPrototypeMethod(ctor, "shareState", ShareState);
+
+  Nan::SetPrototypeMethod(ctor, "stats", GetStats);
+  Nan::SetPrototypeMethod(ctor, "resetStats", ResetStats);
+  Nan::SetPrototypeMethod(ctor, "startTrace", StartTrace);
+  Nan::SetPrototypeMethod(ctor, "stopTrace", StopTrace);
+
+  Nan::SetPrototypeMethod(ctor, "enableHistory", EnableHistory);
+  Nan::SetPrototypeMethod(ctor, "disableHistory", DisableHistory);
+  Nan::SetPrototypeMethod(ctor, "history", GetHistory);
+  Nan::SetPrototypeMethod(ctor, "enableEstimate", EnableEstimate);
+  Nan::SetPrototypeMethod(ctor, "disableEstimate", DisableEstimate);
+  Nan::SetPrototypeMethod(ctor, "estimate", Estimate);
+  Nan::SetPrototypeMethod(ctor, "aggregate", AggregateHistory);
+  Nan::SetPrototypeMethod(ctor, "downsample", DownsampleHistory);
+
+  Nan::SetPrototypeMethod(ctor, "startRecording", StartRecording);
+  Nan::SetPrototypeMethod(ctor, "stopRecording", StopRecording);
+  Nan::SetPrototypeMethod(ctor, "startPublishing", StartPublishing);
+  Nan::SetPrototypeMethod(ctor, "stopPublishing", StopPublishing);
+  Nan::SetPrototypeMethod(ctor, "publishingStats", GetPublishingStats);
+  Nan::SetPrototypeMethod(ctor, "enableAdaptive", EnableAdaptive);
+  Nan::SetPrototypeMethod(ctor, "disableAdaptive", DisableAdaptive);
+  Nan::SetPrototypeMethod(ctor, "adaptiveIntervals", GetAdaptiveIntervals);
+  Nan::SetPrototypeMethod(ctor, "quarantined", GetQuarantined);
+  Nan::SetPrototypeMethod(ctor, "clearQuarantine", ClearQuarantine);
 
   target->Set(Nan::GetCurrentContext(), Nan::New("FSUIPC").ToLocalChecked(),
               ctor->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
 }
 
+// Converts milliseconds from JS, such as timestamps on the process.hrtime()
+// clock, to uv_hrtime() nanoseconds
+static uint64_t MsToHrtime(double ms) {
+  if (!(ms > 0)) {
+    return 0;
+  }
+
+  return ms < UINT64_MAX / 1e6 ? (uint64_t)(ms * 1e6) : UINT64_MAX;
+}
+
 NAN_METHOD(FSUIPC::New) {
   // throw an error if constructor is called without new keyword
   if (!info.IsConstructCall()) {
@@ -42,23 +130,125 @@ NAN_METHOD(FSUIPC::New) {
         Nan::New("FSUIPC.new - called without new keyword").ToLocalChecked());
   }
 
-  if (info.Length() != 0) {
+  if (info.Length() > 1 || (info.Length() == 1 && !info[0]->IsObject())) {
     return Nan::ThrowError(
-        Nan::New("FSUIPC.new - expected no arguments").ToLocalChecked());
+        Nan::New("FSUIPC.new - expected no arguments or an options object")
+            .ToLocalChecked());
+  }
+
+  bool shared = false;
+
+  if (info.Length() == 1) {
+    v8::Local<v8::Value> shared_value =
+        Nan::Get(info[0].As<v8::Object>(), Nan::New("shared").ToLocalChecked())
+            .ToLocalChecked();
+    shared = shared_value->BooleanValue(v8::Isolate::GetCurrent());
   }
 
   FSUIPC* fsuipc = new FSUIPC();
-  fsuipc->ipc = new IPCUser();
+  fsuipc->shared = shared;
+  if (shared) {
+    fsuipc->ipc = Multiplexer::Instance().ipc();
+    fsuipc->fsuipc_mutex = Multiplexer::Instance().mutex();
+    fsuipc->deferred_notifier =
+        new Notifier([fsuipc]() { fsuipc->DeliverDeferred(); });
+    fsuipc->deferred_notifier->Unref();
+  } else {
+    fsuipc->ipc = new IPCUser();
+    fsuipc->fsuipc_mutex = new std::timed_mutex();
+  }
   fsuipc->Wrap(info.Holder());
 
   info.GetReturnValue().Set(info.Holder());
 }
 
+FSUIPC::~FSUIPC() {
+  this->StopScheduler();
+
+  delete this->connection.load();
+
+  {
+    std::lock_guard<std::mutex> guard(this->events_mutex);
+    if (this->event_notifier) {
+      this->event_notifier->Close();
+      this->event_notifier = nullptr;
+    }
+  }
+
+  delete this->mirror.load();
+
+  if (this->snapshot) {
+    this->snapshot->Release(this);
+  }
+
+  if (this->deferred_notifier) {
+    this->deferred_notifier->Close();
+  }
+
+  for (auto it = this->process_pool.begin(); it != this->process_pool.end();
+       ++it) {
+    delete *it;
+  }
+
+  if (this->shared) {
+    Multiplexer::Instance().Close(this);
+    return;
+  }
+
+  if (this->ipc) {
+    delete this->ipc;
+  }
+  if (this->fsuipc_mutex) {
+    delete this->fsuipc_mutex;
+  }
+}
+
 NAN_METHOD(FSUIPC::Open) {
   FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
 
   Simulator requestedSim = Simulator::ANY;
 
+  if (info.Length() > 0 && info[0]->IsObject()) {
+    v8::Local<v8::Object> options = info[0].As<v8::Object>();
+    v8::Local<v8::Value> replay_value =
+        Nan::Get(options, Nan::New("replay").ToLocalChecked()).ToLocalChecked();
+    v8::Local<v8::Value> speed_value =
+        Nan::Get(options, Nan::New("speed").ToLocalChecked()).ToLocalChecked();
+
+    if (!replay_value->IsString()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.open - expected replay to be a path")
+              .ToLocalChecked());
+    }
+
+    double speed = 1;
+
+    if (!speed_value->IsUndefined()) {
+      if (!speed_value->IsNumber() ||
+          !(speed_value->NumberValue(Nan::GetCurrentContext()).ToChecked() >=
+            0)) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.open - expected speed to be a number >= 0")
+                .ToLocalChecked());
+      }
+
+      speed = speed_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+    }
+
+    if (self->shared) {
+      return Nan::ThrowError(
+          Nan::New("FSUIPC.open - shared instances can't replay a capture")
+              .ToLocalChecked());
+    }
+
+    auto worker = new OpenAsyncWorker(self, requestedSim);
+    worker->Replay(std::string(*Nan::Utf8String(replay_value)), speed);
+
+    PromiseQueueWorker(worker);
+
+    return info.GetReturnValue().Set(worker->GetPromise());
+  }
+
   if (info.Length() > 0) {
     if (!info[0]->IsUint32()) {
       return Nan::ThrowTypeError(
@@ -77,436 +267,3382 @@ NAN_METHOD(FSUIPC::Open) {
   info.GetReturnValue().Set(worker->GetPromise());
 }
 
-NAN_METHOD(FSUIPC::Close) {
+NAN_METHOD(FSUIPC::Connect) {
   FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
 
-  auto worker = new CloseAsyncWorker(self);
-
-  PromiseQueueWorker(worker);
+  if (info.Length() > 0 && !info[0]->IsObject()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.connect - expected first argument to be object")
+            .ToLocalChecked());
+  }
 
-  info.GetReturnValue().Set(worker->GetPromise());
-}
+  if (self->shared) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.connect - shared instances can't manage the link")
+            .ToLocalChecked());
+  }
 
-NAN_METHOD(FSUIPC::Process) {
-  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+  Simulator requested = Simulator::ANY;
+  double min_backoff = 250;
+  double max_backoff = 5000;
 
-  auto worker = new ProcessAsyncWorker(self);
+  if (info.Length() > 0) {
+    v8::Local<v8::Object> options = info[0].As<v8::Object>();
+    v8::Local<v8::Value> simulator_value =
+        Nan::Get(options, Nan::New("simulator").ToLocalChecked())
+            .ToLocalChecked();
+    v8::Local<v8::Value> min_value =
+        Nan::Get(options, Nan::New("minBackoffMs").ToLocalChecked())
+            .ToLocalChecked();
+    v8::Local<v8::Value> max_value =
+        Nan::Get(options, Nan::New("maxBackoffMs").ToLocalChecked())
+            .ToLocalChecked();
+
+    if (!simulator_value->IsUndefined()) {
+      if (!simulator_value->IsUint32()) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.connect - expected simulator to be Simulator")
+                .ToLocalChecked());
+      }
+      requested = static_cast<Simulator>(
+          simulator_value->Uint32Value(Nan::GetCurrentContext()).ToChecked());
+    }
 
-  PromiseQueueWorker(worker);
+    if (!min_value->IsUndefined()) {
+      if (!min_value->IsNumber() ||
+          !(min_value->NumberValue(Nan::GetCurrentContext()).ToChecked() >
+            0)) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.connect - expected minBackoffMs to be > 0")
+                .ToLocalChecked());
+      }
+      min_backoff =
+          min_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+    }
 
-  info.GetReturnValue().Set(worker->GetPromise());
-}
+    if (!max_value->IsUndefined()) {
+      if (!max_value->IsNumber() ||
+          !(max_value->NumberValue(Nan::GetCurrentContext()).ToChecked() >=
+            min_backoff)) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.connect - expected maxBackoffMs to be >= "
+                     "minBackoffMs")
+                .ToLocalChecked());
+      }
+      max_backoff =
+          max_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+    }
+  }
 
-NAN_METHOD(FSUIPC::Add) {
-  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+  ConnectionManager* connection = self->connection.load();
 
-  if (info.Length() < 3) {
+  if (connection && connection->Running()) {
     return Nan::ThrowError(
-        Nan::New("FSUIPC.Add: requires at least 3 arguments").ToLocalChecked());
+        Nan::New("FSUIPC.connect - already connecting").ToLocalChecked());
   }
 
-  if (!info[0]->IsString()) {
-    return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Add: expected first argument to be string")
+  if (!connection) {
+    connection = new ConnectionManager();
+    self->connection = connection;
+  }
+
+  self->CreateEventNotifier();
+
+  bool started = connection->Start(
+      self->ipc, self->fsuipc_mutex, requested, MsToHrtime(min_backoff),
+      MsToHrtime(max_backoff), [self](const ConnectionEvent& event) {
+        // The next connection may well be to another sim
+        Mirror* mirror = self->mirror.load();
+        if (!event.connected && mirror) {
+          std::lock_guard<std::timed_mutex> guard(*self->fsuipc_mutex);
+          mirror->Invalidate();
+        }
+
+        self->Emit(PendingEvent{event.connected ? "connected" : "disconnected",
+                                event.error, event.simulator});
+      });
+
+  if (!started) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.connect - could not start connecting")
             .ToLocalChecked());
   }
 
-  if (!info[1]->IsUint32()) {
+  // Connecting keeps the instance and the event loop alive until close()
+  self->event_notifier->Ref();
+  self->Ref();
+}
+
+void FSUIPC::StopConnection() {
+  ConnectionManager* connection = this->connection.load();
+
+  if (!connection || !connection->Running()) {
+    return;
+  }
+
+  connection->Stop();
+
+  this->event_notifier->Unref();
+  this->Unref();
+}
+
+NAN_METHOD(FSUIPC::On) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 2 || !info[0]->IsString() || !info[1]->IsFunction()) {
     return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Add: expected second argument to be uint")
+        Nan::New("FSUIPC.on - expected a string and a function")
             .ToLocalChecked());
   }
 
-  if (!info[2]->IsInt32()) {
+  self->CreateEventNotifier();
+  self->listeners.emplace_back(
+      std::string(*Nan::Utf8String(info[0])),
+      std::make_shared<Nan::Callback>(info[1].As<v8::Function>()));
+
+  info.GetReturnValue().Set(info.Holder());
+}
+
+NAN_METHOD(FSUIPC::Off) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 2 || !info[0]->IsString() || !info[1]->IsFunction()) {
     return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Add: expected third argument to be int")
+        Nan::New("FSUIPC.off - expected a string and a function")
             .ToLocalChecked());
   }
 
   std::string name = std::string(*Nan::Utf8String(info[0]));
-  DWORD offset = info[1]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
-  Type type = (Type)info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
 
-  DWORD size;
-
-  if (type == Type::ByteArray || type == Type::BitArray ||
-      type == Type::String) {
-    if (info.Length() < 4) {
-      return Nan::ThrowTypeError(
-          Nan::New("FSUIPC.Add: requires at least 4 arguments if type is "
-                   "byteArray, bitArray or string")
-              .ToLocalChecked());
+  for (auto it = self->listeners.begin(); it != self->listeners.end(); ++it) {
+    if (it->first == name &&
+        it->second->GetFunction()->StrictEquals(info[1])) {
+      self->listeners.erase(it);
+      break;
     }
+  }
 
-    if (!info[3]->IsUint32()) {
-      return Nan::ThrowTypeError(
-          Nan::New("FSUIPC.Add: expected fourth argument to be uint")
-              .ToLocalChecked());
-    }
+  info.GetReturnValue().Set(info.Holder());
+}
 
-    size = (int)info[3]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
-  } else {
-    size = get_size_of_type(type);
-  }
+void FSUIPC::CreateEventNotifier() {
+  std::lock_guard<std::mutex> guard(this->events_mutex);
 
-  if (size == 0) {
-    return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Add: expected fourth argument to be a size > 0")
-            .ToLocalChecked());
+  if (this->event_notifier) {
+    return;
   }
 
-  self->offsets[name] = Offset{name, type, offset, size, malloc(size)};
+  this->event_notifier = new Notifier([this]() { this->DeliverEvents(); });
+  this->event_notifier->Unref();
+}
 
-  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+void FSUIPC::Emit(PendingEvent event) {
+  std::lock_guard<std::mutex> guard(this->events_mutex);
 
-  Nan::Set(obj, Nan::New("name").ToLocalChecked(),
-           Nan::New(name).ToLocalChecked());
-  Nan::Set(obj, Nan::New("offset").ToLocalChecked(), info[1]);
-  Nan::Set(obj, Nan::New("type").ToLocalChecked(), Nan::New((int)type));
-  Nan::Set(obj, Nan::New("size").ToLocalChecked(), Nan::New((int)size));
+  // Nobody can be listening before the first on()
+  if (!this->event_notifier) {
+    return;
+  }
 
-  info.GetReturnValue().Set(obj);
+  this->pending_events.push_back(std::move(event));
+  this->event_notifier->Notify();
 }
 
-NAN_METHOD(FSUIPC::Remove) {
-  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+void FSUIPC::DeliverEvents() {
+  Nan::HandleScope scope;
 
-  if (info.Length() != 1) {
-    return Nan::ThrowError(
-        Nan::New("FSUIPC.Remove: requires one argument").ToLocalChecked());
+  std::vector<PendingEvent> events;
+  {
+    std::lock_guard<std::mutex> guard(this->events_mutex);
+    events.swap(this->pending_events);
   }
 
-  if (!info[0]->IsString()) {
-    return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Remove: expected first argument to be string")
-            .ToLocalChecked());
-  }
+  Nan::AsyncResource resource("FSUIPC:event");
+
+  for (auto event = events.begin(); event != events.end(); ++event) {
+    v8::Local<v8::Value> argv[1];
+
+    if (event->name == "connected") {
+      argv[0] = Nan::New(static_cast<int>(event->simulator));
+    } else {
+      v8::Local<v8::Value> error_argv[] = {
+          Nan::New(ErrorToString(event->error)).ToLocalChecked(),
+          Nan::New(static_cast<int>(event->error))};
+      v8::Local<v8::Object> error =
+          Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2,
+                                 error_argv)
+              .ToLocalChecked()
+              .As<v8::Object>();
+
+      if (event->name == "error") {
+        v8::Local<v8::Array> offsets = Nan::New<v8::Array>();
+        for (uint32_t i = 0; i < event->offsets.size(); i++) {
+          Nan::Set(offsets, i, Nan::New(event->offsets[i]).ToLocalChecked());
+        }
+        Nan::Set(error, Nan::New("offsets").ToLocalChecked(), offsets);
+      }
 
-  std::string name = std::string(*Nan::Utf8String(info[0]));
+      argv[0] = error;
+    }
 
-  auto it = self->offsets.find(name);
+    // Listeners may remove themselves or others while being called
+    std::vector<std::shared_ptr<Nan::Callback>> callbacks;
+    for (auto it = this->listeners.begin(); it != this->listeners.end();
+         ++it) {
+      if (it->first == event->name) {
+        callbacks.push_back(it->second);
+      }
+    }
 
-  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+    for (auto it = callbacks.begin(); it != callbacks.end(); ++it) {
+      (*it)->Call(1, argv, &resource);
+    }
+  }
+}
 
-  Nan::Set(obj, Nan::New("name").ToLocalChecked(),
-           Nan::New(it->second.name).ToLocalChecked());
-  Nan::Set(obj, Nan::New("offset").ToLocalChecked(),
-           Nan::New((int)it->second.offset));
-  Nan::Set(obj, Nan::New("type").ToLocalChecked(),
-           Nan::New((int)it->second.type));
-  Nan::Set(obj, Nan::New("size").ToLocalChecked(),
-           Nan::New((int)it->second.size));
+NAN_METHOD(FSUIPC::Close) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
 
-  self->offsets.erase(it);
+  self->StopConnection();
 
-  info.GetReturnValue().Set(obj);
+  auto worker = new CloseAsyncWorker(self);
+
+  PromiseQueueWorker(worker);
+
+  info.GetReturnValue().Set(worker->GetPromise());
 }
 
-NAN_METHOD(FSUIPC::Write) {
+NAN_METHOD(FSUIPC::Seek) {
   FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
 
-  if (info.Length() < 3) {
-    return Nan::ThrowError(
-        Nan::New("FSUIPC.Write: requires at least 3 arguments")
+  if (info.Length() < 1 || !info[0]->IsNumber()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.seek - expected first argument to be number")
             .ToLocalChecked());
   }
 
-  if (!info[0]->IsUint32()) {
-    return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Write: expected first argument to be uint")
-            .ToLocalChecked());
+  uint64_t offset =
+      MsToHrtime(info[0]->NumberValue(Nan::GetCurrentContext()).ToChecked());
+
+  Error result;
+
+  {
+    std::lock_guard<std::timed_mutex> fsuipc_guard(*self->fsuipc_mutex);
+    if (self->ipc->Seek(offset, &result)) {
+      return;
+    }
   }
 
-  if (!info[1]->IsInt32()) {
+  v8::Local<v8::Value> argv[] = {
+      Nan::New(ErrorToString(result)).ToLocalChecked(),
+      Nan::New(static_cast<int>(result))};
+  v8::Local<v8::Value> error =
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
+  Nan::ThrowError(error);
+}
+
+NAN_METHOD(FSUIPC::Process) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() > 0 && !info[0]->IsObject()) {
     return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Write: expected second argument to be int")
+        Nan::New("FSUIPC.Process: expected first argument to be object")
             .ToLocalChecked());
   }
 
-  DWORD offset = info[0]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
-  Type type = (Type)info[1]->Int32Value(Nan::GetCurrentContext()).ToChecked();
-
-  DWORD size;
-  void* value;
+  if (info.Length() > 0) {
+    v8::Local<v8::Value> max_age =
+        Nan::Get(info[0].As<v8::Object>(),
+                 Nan::New("maxAgeMs").ToLocalChecked())
+            .ToLocalChecked();
 
-  if (type == Type::ByteArray || type == Type::BitArray ||
-      type == Type::String) {
-    if (info.Length() < 4) {
+    if (!max_age->IsUndefined() && !max_age->IsNumber()) {
       return Nan::ThrowTypeError(
-          Nan::New("FSUIPC.Write: requires at least 4 arguments if type is "
-                   "byteArray, bitArray or string")
+          Nan::New("FSUIPC.Process: expected maxAgeMs to be number")
               .ToLocalChecked());
     }
 
-    if (!info[2]->IsUint32()) {
-      return Nan::ThrowTypeError(
-          Nan::New("FSUIPC.Write: expected third argument to be uint")
-              .ToLocalChecked());
+    // Serve the values of the last cycle if they are recent enough, unless a
+    // cycle is busy writing them
+    uint64_t last_cycle = self->last_cycle.load();
+    if (max_age->IsNumber() && last_cycle &&
+        (uv_hrtime() - last_cycle) / 1e6 <=
+            max_age->NumberValue(Nan::GetCurrentContext()).ToChecked()) {
+      std::unique_lock<std::timed_mutex> guard(self->offsets_mutex,
+                                         std::try_to_lock);
+
+      if (guard.owns_lock()) {
+        v8::Local<v8::Promise::Resolver> resolver =
+            v8::Promise::Resolver::New(Nan::GetCurrentContext())
+                .ToLocalChecked();
+        resolver->Resolve(Nan::GetCurrentContext(),
+                          self->BuildResultLocked());
+
+        info.GetReturnValue().Set(resolver->GetPromise());
+        return;
+      }
     }
+  }
 
-    size = (int)info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
-  } else {
-    size = get_size_of_type(type);
+  // Join a cycle that has not started yet instead of queueing another one
+  if (self->pending_process && !self->pending_process->Started()) {
+    info.GetReturnValue().Set(self->pending_process->Join());
+    return;
   }
 
-  if (size == 0) {
-    return Nan::ThrowTypeError(
-        Nan::New("FSUIPC.Add: expected size to be > 0").ToLocalChecked());
+  ProcessAsyncWorker* worker;
+  if (self->process_pool.empty()) {
+    worker = new ProcessAsyncWorker(self);
+  } else {
+    worker = self->process_pool.back();
+    self->process_pool.pop_back();
+    worker->Reset();
   }
+  self->pending_process = worker;
 
-  value = malloc(size);
+  PromiseQueueWorker(worker);
 
-  switch (type) {
-    case Type::Byte: {
-      uint8_t x =
-          (uint8_t)info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+  info.GetReturnValue().Set(worker->GetPromise());
+}
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+NAN_METHOD(FSUIPC::ProcessSync) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
 
-      break;
-    }
-    case Type::SByte: {
-      int8_t x =
-          (int8_t)info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
-
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+  DWORD timeout = 1000;
 
-      break;
+  if (info.Length() > 0) {
+    if (!info[0]->IsObject()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.processSync: expected first argument to be object")
+              .ToLocalChecked());
     }
-    case Type::Int16: {
-      int16_t x =
-          (int16_t)info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+    v8::Local<v8::Value> timeout_value =
+        Nan::Get(info[0].As<v8::Object>(),
+                 Nan::New("timeout").ToLocalChecked())
+            .ToLocalChecked();
 
-      break;
+    if (!timeout_value->IsUndefined()) {
+      if (!timeout_value->IsUint32() ||
+          timeout_value->Uint32Value(Nan::GetCurrentContext()).ToChecked() ==
+              0) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.processSync: expected timeout to be uint > 0")
+                .ToLocalChecked());
+      }
+
+      timeout =
+          timeout_value->Uint32Value(Nan::GetCurrentContext()).ToChecked();
     }
-    case Type::Int32: {
-      int32_t x = info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
+  }
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+  Error result;
+  CycleTiming timing = CycleTiming{uv_hrtime()};
+
+  if (!self->RunCycle(&result, timeout, &timing)) {
+    v8::Local<v8::Value> argv[] = {
+        Nan::New(ErrorToString(result)).ToLocalChecked(),
+        Nan::New(static_cast<int>(result))};
+    v8::Local<v8::Value> error =
+        Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+            .ToLocalChecked();
+    return Nan::ThrowError(error);
+  }
 
-      break;
-    }
-    case Type::UInt16: {
-      uint16_t x =
-          (uint16_t)info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+  uint64_t start = uv_hrtime();
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+  v8::Local<v8::Object> obj = self->BuildResult();
 
-      break;
-    }
-    case Type::UInt32: {
-      uint32_t x = info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+  self->stats.RecordPhase(Phase::Materialize, start, uv_hrtime() - start);
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+  info.GetReturnValue().Set(obj);
+}
 
-      break;
-    }
-    case Type::Double: {
-      double x = info[2]->NumberValue(Nan::GetCurrentContext()).ToChecked();
+NAN_METHOD(FSUIPC::ProcessSerialized) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+  SerializeFormat format = SerializeFormat::Json;
 
-      break;
+  if (info.Length() > 0) {
+    if (!info[0]->IsObject()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.processSerialized: expected first argument to be "
+                   "object")
+              .ToLocalChecked());
     }
-    case Type::Single: {
-      float x =
-          (float)info[2]->NumberValue(Nan::GetCurrentContext()).ToChecked();
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+    v8::Local<v8::Value> format_value =
+        Nan::Get(info[0].As<v8::Object>(), Nan::New("format").ToLocalChecked())
+            .ToLocalChecked();
 
-      break;
-    }
-    case Type::Int64: {
-      int64_t x;
+    if (!format_value->IsUndefined()) {
+      std::string name = *Nan::Utf8String(format_value);
 
-      if (info[3]->IsString()) {
-        std::string x_str = std::string(*Nan::Utf8String(info[3]));
-        x = std::stoll(x_str);
-      } else if (info[3]->IsInt32()) {
-        x = (int64_t)info[3]->Int32Value(Nan::GetCurrentContext()).ToChecked();
-      } else {
+      if (!format_value->IsString() || (name != "json" && name != "msgpack")) {
         return Nan::ThrowTypeError(
-            Nan::New("FSUIPC.Write: expected fourth argument to be a string or "
-                     "int when type is int64")
+            Nan::New("FSUIPC.processSerialized: expected format to be 'json' "
+                     "or 'msgpack'")
                 .ToLocalChecked());
       }
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
-
-      break;
+      if (name == "msgpack") {
+        format = SerializeFormat::MsgPack;
+      }
     }
-    case Type::UInt64: {
-      uint64_t x;
+  }
 
-      if (info[3]->IsString()) {
-        std::string x_str = std::string(*Nan::Utf8String(info[3]));
-        x = std::stoll(x_str);
-      } else if (info[3]->IsUint32()) {
-        x = (uint64_t)info[3]
-                ->Uint32Value(Nan::GetCurrentContext())
-                .ToChecked();
-      } else {
-        return Nan::ThrowTypeError(
-            Nan::New("FSUIPC.Write: expected fourth argument to be a string or "
-                     "int when type is uint64")
-                .ToLocalChecked());
-      }
+  SerializeAsyncWorker* worker = new SerializeAsyncWorker(self, format);
 
-      std::copy(
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
-          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
-          static_cast<uint8_t*>(value));
+  PromiseQueueWorker(worker);
 
-      break;
+  info.GetReturnValue().Set(worker->GetPromise());
+}
+
+NAN_METHOD(FSUIPC::Sample) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsObject()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Sample: expected first argument to be object")
+            .ToLocalChecked());
+  }
+
+  v8::Local<v8::Object> options = info[0].As<v8::Object>();
+  v8::Local<v8::Value> cycles_value =
+      Nan::Get(options, Nan::New("cycles").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> hz_value =
+      Nan::Get(options, Nan::New("hz").ToLocalChecked()).ToLocalChecked();
+
+  if (!cycles_value->IsUint32() ||
+      cycles_value->Uint32Value(Nan::GetCurrentContext()).ToChecked() == 0 ||
+      cycles_value->Uint32Value(Nan::GetCurrentContext()).ToChecked() >
+          SampleAsyncWorker::kMaxCycles) {
+    return Nan::ThrowRangeError(
+        Nan::New("FSUIPC.Sample: expected cycles to be uint > 0 and <= " +
+                 std::to_string(SampleAsyncWorker::kMaxCycles))
+            .ToLocalChecked());
+  }
+
+  double hz = 0;
+
+  if (!hz_value->IsUndefined()) {
+    if (!hz_value->IsNumber()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.Sample: expected hz to be number").ToLocalChecked());
     }
-    case Type::String: {
-      std::memset(value, 0, size);
 
-      std::string x_str = std::string(*Nan::Utf8String(info[3]));
-      if (x_str.length() >= size) {
-        return Nan::ThrowTypeError(
-            Nan::New("FSUIPC.Write: expected string's length to be less than "
-                     "the supplied size")
-                .ToLocalChecked());
-      }
+    hz = hz_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
 
-      const char* x_c_str = x_str.c_str();
+    // The period in nanoseconds has to fit in an int64_t
+    if (!(hz == 0 || hz >= SampleAsyncWorker::kMinHz)) {
+      return Nan::ThrowRangeError(
+          Nan::New("FSUIPC.Sample: expected hz to be 0 or >= 0.001")
+              .ToLocalChecked());
+    }
+  }
 
-      strcpy_s((char*)value, size, x_str.c_str());
+  auto worker = new SampleAsyncWorker(
+      self, cycles_value->Uint32Value(Nan::GetCurrentContext()).ToChecked(),
+      hz);
 
-      break;
+  PromiseQueueWorker(worker);
+
+  info.GetReturnValue().Set(worker->GetPromise());
+}
+
+NAN_METHOD(FSUIPC::StartPolling) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 2 || !info[0]->IsObject() || !info[1]->IsFunction()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.StartPolling: expected an object and a function")
+            .ToLocalChecked());
+  }
+
+  if (self->scheduler) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.StartPolling: already polling").ToLocalChecked());
+  }
+
+  v8::Local<v8::Object> options = info[0].As<v8::Object>();
+  v8::Local<v8::Value> hz_value =
+      Nan::Get(options, Nan::New("hz").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> overrun_value =
+      Nan::Get(options, Nan::New("overrun").ToLocalChecked()).ToLocalChecked();
+
+  if (!hz_value->IsNumber() ||
+      !(hz_value->NumberValue(Nan::GetCurrentContext()).ToChecked() > 0)) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.StartPolling: expected hz to be a number > 0")
+            .ToLocalChecked());
+  }
+
+  OverrunPolicy policy = OverrunPolicy::Skip;
+
+  if (!overrun_value->IsUndefined()) {
+    std::string overrun = std::string(*Nan::Utf8String(overrun_value));
+
+    if (overrun == "catchUp") {
+      policy = OverrunPolicy::CatchUp;
+    } else if (overrun != "skip") {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.StartPolling: expected overrun to be 'skip' or "
+                   "'catchUp'")
+              .ToLocalChecked());
     }
-    case Type::ByteArray: {
-      std::memset(value, 0, size);
+  }
 
-      if (info[3]->IsArrayBuffer()) {
-        v8::Local<v8::ArrayBufferView> view =
-            v8::Local<v8::ArrayBufferView>::Cast(info[3]);
+  v8::Local<v8::Value> sentinels_value =
+      Nan::Get(options, Nan::New("sentinels").ToLocalChecked())
+          .ToLocalChecked();
+  v8::Local<v8::Value> backoff_value =
+      Nan::Get(options, Nan::New("maxBackoffMs").ToLocalChecked())
+          .ToLocalChecked();
 
-        view->CopyContents(value, size);
-      } else {
+  std::vector<Sentinel> sentinels;
+
+  if (!sentinels_value->IsUndefined()) {
+    if (!sentinels_value->IsArray()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.StartPolling: expected sentinels to be array")
+              .ToLocalChecked());
+    }
+
+    v8::Local<v8::Array> array = sentinels_value.As<v8::Array>();
+
+    for (uint32_t i = 0; i < array->Length(); i++) {
+      v8::Local<v8::Value> item = Nan::Get(array, i).ToLocalChecked();
+
+      if (!item->IsObject()) {
         return Nan::ThrowTypeError(
-            Nan::New("FSUIPC.Write: expected to receive ArrayBufferView for "
-                     "byte array type")
+            Nan::New("FSUIPC.StartPolling: expected sentinels to be objects")
                 .ToLocalChecked());
       }
 
-      break;
+      v8::Local<v8::Value> offset_value =
+          Nan::Get(item.As<v8::Object>(), Nan::New("offset").ToLocalChecked())
+              .ToLocalChecked();
+      v8::Local<v8::Value> size_value =
+          Nan::Get(item.As<v8::Object>(), Nan::New("size").ToLocalChecked())
+              .ToLocalChecked();
+      v8::Local<v8::Value> paused_value =
+          Nan::Get(item.As<v8::Object>(), Nan::New("paused").ToLocalChecked())
+              .ToLocalChecked();
+
+      if (!offset_value->IsUint32() || !size_value->IsUint32() ||
+          size_value->Uint32Value(Nan::GetCurrentContext()).ToChecked() == 0 ||
+          size_value->Uint32Value(Nan::GetCurrentContext()).ToChecked() >
+              8) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.StartPolling: expected sentinel offset to be "
+                     "uint and size to be 1 to 8")
+                .ToLocalChecked());
+      }
+
+      sentinels.push_back(Sentinel{
+          offset_value->Uint32Value(Nan::GetCurrentContext()).ToChecked(),
+          size_value->Uint32Value(Nan::GetCurrentContext()).ToChecked(),
+          paused_value->BooleanValue(v8::Isolate::GetCurrent())});
     }
-    default: {
+  }
+
+  double max_backoff = 1000;
+
+  if (!backoff_value->IsUndefined()) {
+    if (!backoff_value->IsNumber() ||
+        !(backoff_value->NumberValue(Nan::GetCurrentContext()).ToChecked() >=
+          0)) {
       return Nan::ThrowTypeError(
-          Nan::New("FSUIPC.Write: unsupported type for write")
+          Nan::New("FSUIPC.StartPolling: expected maxBackoffMs to be >= 0")
               .ToLocalChecked());
     }
+    max_backoff =
+        backoff_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+  }
+
+  double hz = hz_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+    size_t size = 0;
+    for (auto it = sentinels.begin(); it != sentinels.end(); ++it) {
+      size += it->size;
+    }
+
+    self->sentinels.swap(sentinels);
+    self->sentinel_values.assign(size, 0);
+    self->sentinel_staging.assign(size, 0);
+    self->sentinels_seeded = false;
+    self->sentinels_unchanged = 0;
+    self->sim_idle = false;
+  }
+
+  self->poll_callback.Reset(info[1].As<v8::Function>());
+  self->poll_resource = new Nan::AsyncResource("FSUIPC:poll");
+  self->poll_notifier = new Notifier([self]() { self->DeliverPoll(); });
+  self->scheduler = new Scheduler();
+
+  bool started = self->scheduler->Start(
+      (uint64_t)(1e9 / hz), policy, MsToHrtime(max_backoff), [self]() {
+        Error result;
+
+        // While the sim is idle, the full batch waits for the sentinels
+        if (self->sim_idle) {
+          bool advanced;
+
+          if (!self->ProbeSentinels(&result, kProbeTimeout, &advanced)) {
+            self->poll_error = static_cast<int>(result);
+            self->poll_notifier->Notify();
+            return true;
+          }
+
+          if (!advanced) {
+            return false;
+          }
+        }
+
+        CycleTiming timing = CycleTiming{uv_hrtime()};
+
+        if (self->RunCycle(&result, 0, &timing)) {
+          self->CopyPoll();
+          self->poll_error = 0;
+        } else {
+          self->poll_error = static_cast<int>(result);
+        }
+        self->poll_notifier->Notify();
+        return true;
+      });
+
+  if (!started) {
+    self->StopScheduler();
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.StartPolling: could not create timer")
+            .ToLocalChecked());
   }
 
-  self->offset_writes.push_back(OffsetWrite{type, offset, size, value});
+  // Polling keeps the instance alive until stopPolling()
+  self->Ref();
 }
 
-void ProcessAsyncWorker::Execute() {
-  Error result;
+void FSUIPC::CopyPoll() {
+  PollBuffer& buffer = this->poll_write;
 
-  std::lock_guard<std::mutex> guard(this->fsuipc->offsets_mutex);
-  std::lock_guard<std::mutex> fsuipc_guard(this->fsuipc->fsuipc_mutex);
+  {
+    std::lock_guard<std::timed_mutex> guard(this->offsets_mutex);
 
-  auto offsets = this->fsuipc->offsets;
+    if (!buffer.has_layout || buffer.layout_version != this->layout_version) {
+      size_t total = 0;
 
-  std::map<std::string, Offset>::iterator it = offsets.begin();
+      buffer.fields.clear();
+      for (auto it = this->offsets.begin(); it != this->offsets.end(); ++it) {
+        buffer.fields.push_back(PollBuffer::Field{
+            it->second.name, it->second.type, it->second.size, total});
+        total += it->second.size;
+      }
 
-  for (; it != offsets.end(); ++it) {
-    if (!this->fsuipc->ipc->Read(it->second.offset, it->second.size,
-                                 it->second.dest, &result)) {
-      this->SetErrorMessage(ErrorToString(result));
-      this->errorCode = static_cast<int>(result);
-      return;
+      buffer.data.resize(total);
+      buffer.has_layout = true;
+      buffer.layout_version = this->layout_version;
+    }
+
+    BYTE* dest = buffer.data.data();
+    for (auto it = this->offsets.begin(); it != this->offsets.end(); ++it) {
+      CopyMemory(dest, it->second.dest, it->second.size);
+      dest += it->second.size;
     }
   }
 
-  auto offset_writes = this->fsuipc->offset_writes;
+  std::lock_guard<std::mutex> guard(this->poll_mutex);
+  std::swap(this->poll_write, this->poll_ready);
+  this->poll_fresh = true;
+}
 
-  std::vector<OffsetWrite>::iterator write_it = offset_writes.begin();
+void FSUIPC::DeliverPoll() {
+  Nan::HandleScope scope;
 
-  for (; write_it != offset_writes.end(); ++write_it) {
-    if (!this->fsuipc->ipc->Write(write_it->offset, write_it->size,
-                                  write_it->src, &result)) {
-      this->SetErrorMessage(ErrorToString(result));
-      this->errorCode = static_cast<int>(result);
-      return;
+  if (!this->scheduler) {
+    return;
+  }
+
+  int error_code = this->poll_error;
+
+  if (error_code) {
+    v8::Local<v8::Value> argv[] = {
+        Nan::New(ErrorToString(static_cast<Error>(error_code)))
+            .ToLocalChecked(),
+        Nan::New(error_code)};
+    v8::Local<v8::Value> error =
+        Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+            .ToLocalChecked();
+
+    v8::Local<v8::Value> callback_argv[] = {error};
+    this->poll_callback.Call(1, callback_argv, this->poll_resource);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(this->poll_mutex);
+
+    if (this->poll_fresh) {
+      std::swap(this->poll_read, this->poll_ready);
+      this->poll_fresh = false;
     }
+  }
 
-    free(write_it->src);
+  uint64_t start = uv_hrtime();
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  PollBuffer& buffer = this->poll_read;
+
+  for (auto it = buffer.fields.begin(); it != buffer.fields.end(); ++it) {
+    Nan::Set(obj, Nan::New(it->name).ToLocalChecked(),
+             GetOffsetValue(it->type, buffer.data.data() + it->position,
+                            it->size));
   }
 
-  this->fsuipc->offset_writes.clear();
+  this->stats.RecordPhase(Phase::Materialize, start, uv_hrtime() - start);
 
-  if (!this->fsuipc->ipc->Process(&result)) {
-    this->SetErrorMessage(ErrorToString(result));
-    this->errorCode = static_cast<int>(result);
-    return;
+  v8::Local<v8::Value> callback_argv[] = {Nan::Null(), obj};
+  this->poll_callback.Call(2, callback_argv, this->poll_resource);
+}
+
+void FSUIPC::StopScheduler() {
+  if (this->scheduler) {
+    this->scheduler->Stop();
+    delete this->scheduler;
+    this->scheduler = nullptr;
+
+    std::lock_guard<std::timed_mutex> guard(this->offsets_mutex);
+    this->sentinels.clear();
+    this->sim_idle = false;
+  }
+
+  if (this->poll_notifier) {
+    this->poll_notifier->Close();
+    this->poll_notifier = nullptr;
+  }
+
+  if (this->poll_resource) {
+    delete this->poll_resource;
+    this->poll_resource = nullptr;
   }
+
+  this->poll_callback.Reset();
 }
 
-void ProcessAsyncWorker::HandleOKCallback() {
-  Nan::HandleScope scope;
+NAN_METHOD(FSUIPC::Add) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
 
-  std::lock_guard<std::mutex> guard(this->fsuipc->offsets_mutex);
+  if (info.Length() < 3) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.Add: requires at least 3 arguments").ToLocalChecked());
+  }
 
-  auto offsets = this->fsuipc->offsets;
+  if (!info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Add: expected first argument to be string")
+            .ToLocalChecked());
+  }
 
-  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
-  std::map<std::string, Offset>::iterator it = offsets.begin();
+  if (!info[1]->IsUint32()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Add: expected second argument to be uint")
+            .ToLocalChecked());
+  }
 
-  for (; it != offsets.end(); ++it) {
-    Nan::Set(obj, Nan::New(it->second.name).ToLocalChecked(),
-             this->GetValue(it->second.type, it->second.dest, it->second.size));
+  if (!info[2]->IsInt32()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Add: expected third argument to be int")
+            .ToLocalChecked());
   }
 
-  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), obj);
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+  DWORD offset = info[1]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+  Type type = (Type)info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
+
+  DWORD size;
+
+  if (type == Type::ByteArray || type == Type::BitArray ||
+      type == Type::String) {
+    if (info.Length() < 4) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.Add: requires at least 4 arguments if type is "
+                   "byteArray, bitArray or string")
+              .ToLocalChecked());
+    }
+
+    if (!info[3]->IsUint32()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.Add: expected fourth argument to be uint")
+              .ToLocalChecked());
+    }
+
+    size = (int)info[3]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+  } else {
+    size = get_size_of_type(type);
+  }
+
+  if (size == 0) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Add: expected fourth argument to be a size > 0")
+            .ToLocalChecked());
+  }
+
+  // Options follow the size, if there is one
+  int options_index = type == Type::ByteArray || type == Type::BitArray ||
+                              type == Type::String
+                          ? 4
+                          : 3;
+  uint64_t max_age = 0;
+
+  if (info.Length() > options_index) {
+    if (!info[options_index]->IsObject()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.Add: expected options to be object")
+              .ToLocalChecked());
+    }
+
+    v8::Local<v8::Value> max_age_value =
+        Nan::Get(info[options_index].As<v8::Object>(),
+                 Nan::New("maxAgeMs").ToLocalChecked())
+            .ToLocalChecked();
+
+    if (!max_age_value->IsUndefined()) {
+      if (!max_age_value->IsNumber() ||
+          max_age_value->NumberValue(Nan::GetCurrentContext()).ToChecked() <
+              0) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.Add: expected maxAgeMs to be number >= 0")
+                .ToLocalChecked());
+      }
+
+      max_age = MsToHrtime(
+          max_age_value->NumberValue(Nan::GetCurrentContext()).ToChecked());
+    }
+  }
+
+  {
+    // An offset added again starts over without estimation
+    std::lock_guard<std::mutex> estimators_guard(self->estimators_mutex);
+    self->estimators.erase(name);
+  }
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    Offset& value = self->offsets[name] =
+        Offset{name, type, offset, size, malloc(size)};
+    value.max_age = max_age;
+    if (self->adaptive) {
+      value.adaptive = std::make_shared<AdaptiveRate>(size);
+    }
+    self->layout_version++;
+
+    // The multiplexer already reads each offset once per tick for all the
+    // instances sharing the link
+    if (max_age && !self->shared && !self->mirror.load()) {
+      self->mirror = new Mirror();
+    }
+  }
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  Nan::Set(obj, Nan::New("name").ToLocalChecked(),
+           Nan::New(name).ToLocalChecked());
+  Nan::Set(obj, Nan::New("offset").ToLocalChecked(), info[1]);
+  Nan::Set(obj, Nan::New("type").ToLocalChecked(), Nan::New((int)type));
+  Nan::Set(obj, Nan::New("size").ToLocalChecked(), Nan::New((int)size));
+
+  info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(FSUIPC::Remove) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() != 1) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.Remove: requires one argument").ToLocalChecked());
+  }
+
+  if (!info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Remove: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  {
+    std::lock_guard<std::mutex> estimators_guard(self->estimators_mutex);
+    self->estimators.erase(name);
+  }
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  auto it = self->offsets.find(name);
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  Nan::Set(obj, Nan::New("name").ToLocalChecked(),
+           Nan::New(it->second.name).ToLocalChecked());
+  Nan::Set(obj, Nan::New("offset").ToLocalChecked(),
+           Nan::New((int)it->second.offset));
+  Nan::Set(obj, Nan::New("type").ToLocalChecked(),
+           Nan::New((int)it->second.type));
+  Nan::Set(obj, Nan::New("size").ToLocalChecked(),
+           Nan::New((int)it->second.size));
+
+  self->offsets.erase(it);
+  self->layout_version++;
+
+  info.GetReturnValue().Set(obj);
+}
+
+// Parses the offset, type, optional size and value arguments shared by
+// write() and writeNow(). Throws and returns false if they are invalid.
+static bool ParseWrite(const Nan::FunctionCallbackInfo<v8::Value>& info,
+                       const std::string& method,
+                       OffsetWrite* write) {
+  if (info.Length() < 3) {
+    Nan::ThrowError(
+        Nan::New(method + ": requires at least 3 arguments")
+            .ToLocalChecked());
+    return false;
+  }
+
+  if (!info[0]->IsUint32()) {
+    Nan::ThrowTypeError(
+        Nan::New(method + ": expected first argument to be uint")
+            .ToLocalChecked());
+    return false;
+  }
+
+  if (!info[1]->IsInt32()) {
+    Nan::ThrowTypeError(
+        Nan::New(method + ": expected second argument to be int")
+            .ToLocalChecked());
+    return false;
+  }
+
+  DWORD offset = info[0]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+  Type type = (Type)info[1]->Int32Value(Nan::GetCurrentContext()).ToChecked();
+
+  DWORD size;
+  void* value;
+
+  if (type == Type::ByteArray || type == Type::BitArray ||
+      type == Type::String) {
+    if (info.Length() < 4) {
+      Nan::ThrowTypeError(
+          Nan::New(method + ": requires at least 4 arguments if type is "
+                            "byteArray, bitArray or string")
+              .ToLocalChecked());
+      return false;
+    }
+
+    if (!info[2]->IsUint32()) {
+      Nan::ThrowTypeError(
+          Nan::New(method + ": expected third argument to be uint")
+              .ToLocalChecked());
+      return false;
+    }
+
+    size = (int)info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+  } else {
+    size = get_size_of_type(type);
+  }
+
+  if (size == 0) {
+    Nan::ThrowTypeError(
+        Nan::New(method + ": expected size to be > 0")
+            .ToLocalChecked());
+    return false;
+  }
+
+  value = malloc(size);
+
+  switch (type) {
+    case Type::Byte: {
+      uint8_t x =
+          (uint8_t)info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::SByte: {
+      int8_t x =
+          (int8_t)info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::Int16: {
+      int16_t x =
+          (int16_t)info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::Int32: {
+      int32_t x = info[2]->Int32Value(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::UInt16: {
+      uint16_t x =
+          (uint16_t)info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::UInt32: {
+      uint32_t x = info[2]->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::Double: {
+      double x = info[2]->NumberValue(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::Single: {
+      float x =
+          (float)info[2]->NumberValue(Nan::GetCurrentContext()).ToChecked();
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::Int64: {
+      int64_t x;
+
+      if (info[3]->IsString()) {
+        std::string x_str = std::string(*Nan::Utf8String(info[3]));
+        x = std::stoll(x_str);
+      } else if (info[3]->IsInt32()) {
+        x = (int64_t)info[3]->Int32Value(Nan::GetCurrentContext()).ToChecked();
+      } else {
+        Nan::ThrowTypeError(
+            Nan::New(method + ": expected fourth argument to be a string or "
+                              "int when type is int64")
+                .ToLocalChecked());
+        free(value);
+        return false;
+      }
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::UInt64: {
+      uint64_t x;
+
+      if (info[3]->IsString()) {
+        std::string x_str = std::string(*Nan::Utf8String(info[3]));
+        x = std::stoll(x_str);
+      } else if (info[3]->IsUint32()) {
+        x = (uint64_t)info[3]
+                ->Uint32Value(Nan::GetCurrentContext())
+                .ToChecked();
+      } else {
+        Nan::ThrowTypeError(
+            Nan::New(method + ": expected fourth argument to be a string or "
+                              "int when type is uint64")
+                .ToLocalChecked());
+        free(value);
+        return false;
+      }
+
+      std::copy(
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)),
+          static_cast<const uint8_t*>(static_cast<const void*>(&x)) + sizeof x,
+          static_cast<uint8_t*>(value));
+
+      break;
+    }
+    case Type::String: {
+      std::memset(value, 0, size);
+
+      std::string x_str = std::string(*Nan::Utf8String(info[3]));
+      if (x_str.length() >= size) {
+        Nan::ThrowTypeError(
+            Nan::New(method + ": expected string's length to be less than the "
+                              "supplied size")
+                .ToLocalChecked());
+        free(value);
+        return false;
+      }
+
+      const char* x_c_str = x_str.c_str();
+
+      strcpy_s((char*)value, size, x_str.c_str());
+
+      break;
+    }
+    case Type::ByteArray: {
+      std::memset(value, 0, size);
+
+      if (info[3]->IsArrayBuffer()) {
+        v8::Local<v8::ArrayBufferView> view =
+            v8::Local<v8::ArrayBufferView>::Cast(info[3]);
+
+        view->CopyContents(value, size);
+      } else {
+        Nan::ThrowTypeError(
+            Nan::New(method + ": expected to receive ArrayBufferView for byte "
+                              "array type")
+                .ToLocalChecked());
+        free(value);
+        return false;
+      }
+
+      break;
+    }
+    default: {
+      Nan::ThrowTypeError(
+          Nan::New(method + ": unsupported type for write")
+              .ToLocalChecked());
+      free(value);
+      return false;
+    }
+  }
+
+  *write = OffsetWrite{type, offset, size, value};
+  return true;
+}
+
+// Whether the options object that may follow the value of a write asks for
+// the value to be read back
+static bool ParseVerify(const Nan::FunctionCallbackInfo<v8::Value>& info) {
+  if (info.Length() < 4) {
+    return false;
+  }
+
+  v8::Local<v8::Value> options = info[info.Length() - 1];
+
+  if (!options->IsObject() || options->IsArrayBufferView()) {
+    return false;
+  }
+
+  return Nan::Get(options.As<v8::Object>(), Nan::New("verify").ToLocalChecked())
+      .ToLocalChecked()
+      ->BooleanValue(v8::Isolate::GetCurrent());
+}
+
+NAN_METHOD(FSUIPC::Write) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  uint64_t queued = uv_hrtime();
+
+  OffsetWrite write;
+  if (!ParseWrite(info, "FSUIPC.Write", &write)) {
+    return;
+  }
+
+  // The read-back needs a request of its own to resolve with, so verified
+  // writes go out like writeNow() rather than with the next process()
+  if (ParseVerify(info)) {
+    info.GetReturnValue().Set(self->QueuePriorityWrite(write, queued, true));
+    return;
+  }
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+  self->offset_writes.push_back(write);
+}
+
+NAN_METHOD(FSUIPC::WriteNow) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  uint64_t queued = uv_hrtime();
+
+  OffsetWrite write;
+  if (!ParseWrite(info, "FSUIPC.WriteNow", &write)) {
+    return;
+  }
+
+  info.GetReturnValue().Set(
+      self->QueuePriorityWrite(write, queued, ParseVerify(info)));
+}
+
+v8::Local<v8::Promise> FSUIPC::QueuePriorityWrite(const OffsetWrite& write,
+                                                  uint64_t queued,
+                                                  bool verify) {
+  auto ack = std::make_shared<WriteAck>(WriteAck{queued, 0, Error::OK, false});
+
+  if (verify) {
+    ack->verify = true;
+    ack->type = write.type;
+    ack->readback.resize(write.size);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(this->priority_mutex);
+    this->priority_writes.push_back(PriorityWrite{write, ack});
+  }
+
+  auto worker = new WriteNowAsyncWorker(this, ack);
+
+  PromiseQueueWorker(worker);
+
+  return worker->GetPromise();
+}
+
+NAN_METHOD(FSUIPC::Flush) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  DWORD timeout = 1000;
+
+  if (info.Length() > 0) {
+    if (!info[0]->IsObject()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.flush: expected first argument to be object")
+              .ToLocalChecked());
+    }
+
+    v8::Local<v8::Value> timeout_value =
+        Nan::Get(info[0].As<v8::Object>(),
+                 Nan::New("timeout").ToLocalChecked())
+            .ToLocalChecked();
+
+    if (!timeout_value->IsUndefined()) {
+      if (!timeout_value->IsUint32() ||
+          timeout_value->Uint32Value(Nan::GetCurrentContext()).ToChecked() ==
+              0) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.flush: expected timeout to be uint > 0")
+                .ToLocalChecked());
+      }
+
+      timeout =
+          timeout_value->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+    }
+  }
+
+  auto worker = new FlushAsyncWorker(self, timeout);
+
+  PromiseQueueWorker(worker);
+
+  info.GetReturnValue().Set(worker->GetPromise());
+}
+
+NAN_METHOD(FSUIPC::SendControls) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() != 1 || !info[0]->IsArray()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.SendControls: expected first argument to be array")
+            .ToLocalChecked());
+  }
+
+  v8::Local<v8::Array> arr = info[0].As<v8::Array>();
+  v8::Local<v8::String> control_key = Nan::New("control").ToLocalChecked();
+  v8::Local<v8::String> param_key = Nan::New("param").ToLocalChecked();
+
+  std::vector<Control> controls;
+  controls.reserve(arr->Length());
+
+  for (uint32_t i = 0; i < arr->Length(); i++) {
+    v8::Local<v8::Value> item = Nan::Get(arr, i).ToLocalChecked();
+
+    if (!item->IsObject()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.SendControls: expected array of objects")
+              .ToLocalChecked());
+    }
+
+    v8::Local<v8::Object> obj = item.As<v8::Object>();
+    v8::Local<v8::Value> control = Nan::Get(obj, control_key).ToLocalChecked();
+    v8::Local<v8::Value> param = Nan::Get(obj, param_key).ToLocalChecked();
+
+    if (!control->IsUint32()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.SendControls: expected control to be uint")
+              .ToLocalChecked());
+    }
+
+    // Axis controls take negative parameters, so accept both signed and
+    // unsigned values and send their bits as-is
+    DWORD param_value = 0;
+    if (param->IsInt32()) {
+      param_value = static_cast<DWORD>(
+          param->Int32Value(Nan::GetCurrentContext()).ToChecked());
+    } else if (param->IsUint32()) {
+      param_value = param->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+    } else if (!param->IsUndefined()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.SendControls: expected param to be int")
+              .ToLocalChecked());
+    }
+
+    controls.push_back(Control{
+        control->Uint32Value(Nan::GetCurrentContext()).ToChecked(),
+        param_value});
+  }
+
+  auto worker = new SendControlsAsyncWorker(self, std::move(controls));
+
+  PromiseQueueWorker(worker);
+
+  info.GetReturnValue().Set(worker->GetPromise());
+}
+
+NAN_METHOD(FSUIPC::ShareSnapshot) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() != 1 || !(info[0]->IsString() || info[0]->IsNull())) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.ShareSnapshot: expected first argument to be string "
+                 "or null")
+            .ToLocalChecked());
+  }
+
+  std::shared_ptr<Snapshot> snapshot;
+  if (info[0]->IsString()) {
+    snapshot = Snapshot::Get(std::string(*Nan::Utf8String(info[0])));
+
+    // A second publisher would write the same seqlock concurrently
+    if (!snapshot->Claim(self)) {
+      return Nan::ThrowError(
+          Nan::New("FSUIPC.ShareSnapshot: snapshot is already shared by "
+                   "another instance")
+              .ToLocalChecked());
+    }
+  }
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+  if (self->snapshot && self->snapshot != snapshot) {
+    self->snapshot->Release(self);
+  }
+  self->snapshot = snapshot;
+}
+
+NAN_METHOD(FSUIPC::ShareState) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !(info[0]->IsString() || info[0]->IsNull())) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.ShareState: expected first argument to be string or "
+                 "null")
+            .ToLocalChecked());
+  }
+
+  if (info[0]->IsString()) {
+    std::string path;
+    uint32_t max_fields = 256;
+    uint32_t capacity = 65536;
+
+    if (info.Length() > 1) {
+      if (!info[1]->IsObject()) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.ShareState: expected second argument to be "
+                     "object")
+                .ToLocalChecked());
+      }
+
+      v8::Local<v8::Object> options = info[1].As<v8::Object>();
+      v8::Local<v8::Value> path_value =
+          Nan::Get(options, Nan::New("path").ToLocalChecked())
+              .ToLocalChecked();
+      v8::Local<v8::Value> max_fields_value =
+          Nan::Get(options, Nan::New("maxFields").ToLocalChecked())
+              .ToLocalChecked();
+      v8::Local<v8::Value> capacity_value =
+          Nan::Get(options, Nan::New("capacity").ToLocalChecked())
+              .ToLocalChecked();
+
+      if (!path_value->IsUndefined()) {
+        if (!path_value->IsString()) {
+          return Nan::ThrowTypeError(
+              Nan::New("FSUIPC.ShareState: expected path to be string")
+                  .ToLocalChecked());
+        }
+        path = std::string(*Nan::Utf8String(path_value));
+      }
+
+      if (!max_fields_value->IsUndefined()) {
+        if (!max_fields_value->IsUint32()) {
+          return Nan::ThrowTypeError(
+              Nan::New("FSUIPC.ShareState: expected maxFields to be uint")
+                  .ToLocalChecked());
+        }
+        max_fields =
+            max_fields_value->Uint32Value(Nan::GetCurrentContext())
+                .ToChecked();
+      }
+
+      if (!capacity_value->IsUndefined()) {
+        if (!capacity_value->IsUint32()) {
+          return Nan::ThrowTypeError(
+              Nan::New("FSUIPC.ShareState: expected capacity to be uint")
+                  .ToLocalChecked());
+        }
+        capacity =
+            capacity_value->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+      }
+    }
+
+    // Keeps the whole mapping well below 4 GB
+    if (max_fields > 65536 || capacity > 0x10000000) {
+      return Nan::ThrowRangeError(
+          Nan::New("FSUIPC.ShareState: maxFields or capacity is too large")
+              .ToLocalChecked());
+    }
+
+    std::string name = std::string(*Nan::Utf8String(info[0]));
+    std::string error;
+
+    std::shared_ptr<StateFile> state_file = std::make_shared<StateFile>();
+
+    // Opened with cycles held off, as a mapping shared again under the same
+    // name is reinitialized. The previous state file only gives up its
+    // mapping first when the name is the same, so that the new one can claim
+    // it; otherwise it is kept until the new one is open.
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    if (self->state_file && self->state_file->Name() == name) {
+      self->state_file.reset();
+    }
+
+    if (!state_file->Open(name, path, max_fields, capacity, &error)) {
+      return Nan::ThrowError(
+          Nan::New("FSUIPC.ShareState: " + error).ToLocalChecked());
+    }
+
+    self->state_file = state_file;
+    return;
+  }
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+  self->state_file.reset();
+}
+
+// Converts a histogram summary to JS, dividing all values by scale
+static v8::Local<v8::Object> HistogramToObject(const HistogramSummary& summary,
+                                               double scale) {
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  Nan::Set(obj, Nan::New("count").ToLocalChecked(),
+           Nan::New((double)summary.count));
+  Nan::Set(obj, Nan::New("min").ToLocalChecked(),
+           Nan::New(summary.min / scale));
+  Nan::Set(obj, Nan::New("max").ToLocalChecked(),
+           Nan::New(summary.max / scale));
+  Nan::Set(obj, Nan::New("mean").ToLocalChecked(),
+           Nan::New(summary.mean / scale));
+  Nan::Set(obj, Nan::New("p50").ToLocalChecked(),
+           Nan::New(summary.p50 / scale));
+  Nan::Set(obj, Nan::New("p90").ToLocalChecked(),
+           Nan::New(summary.p90 / scale));
+  Nan::Set(obj, Nan::New("p99").ToLocalChecked(),
+           Nan::New(summary.p99 / scale));
+  Nan::Set(obj, Nan::New("p999").ToLocalChecked(),
+           Nan::New(summary.p999 / scale));
+
+  return obj;
+}
+
+NAN_METHOD(FSUIPC::GetStats) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  Stats::Summary summary;
+  self->stats.GetSummary(&summary);
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  Nan::Set(obj, Nan::New("cycles").ToLocalChecked(),
+           Nan::New((double)summary.cycles));
+  Nan::Set(obj, Nan::New("errors").ToLocalChecked(),
+           Nan::New((double)summary.errors));
+  Nan::Set(obj, Nan::New("requests").ToLocalChecked(),
+           Nan::New((double)summary.link.requests));
+  Nan::Set(obj, Nan::New("bytes").ToLocalChecked(),
+           Nan::New((double)summary.link.bytes));
+  Nan::Set(obj, Nan::New("retries").ToLocalChecked(),
+           Nan::New((double)summary.link.retries));
+  Nan::Set(obj, Nan::New("timeouts").ToLocalChecked(),
+           Nan::New((double)summary.link.timeouts));
+
+  Nan::Set(obj, Nan::New("bytesPerCycle").ToLocalChecked(),
+           HistogramToObject(summary.bytes, 1));
+  Nan::Set(obj, Nan::New("requestsPerCycle").ToLocalChecked(),
+           HistogramToObject(summary.requests, 1));
+
+  // Phase durations are reported in milliseconds
+  v8::Local<v8::Object> phases = Nan::New<v8::Object>();
+  for (int i = 0; i < static_cast<int>(Phase::Count); i++) {
+    Nan::Set(phases,
+             Nan::New(PhaseToString(static_cast<Phase>(i))).ToLocalChecked(),
+             HistogramToObject(summary.phases[i], 1e6));
+  }
+  Nan::Set(obj, Nan::New("phases").ToLocalChecked(), phases);
+
+  info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(FSUIPC::ResetStats) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  self->stats.Reset();
+}
+
+NAN_METHOD(FSUIPC::StartTrace) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  self->stats.StartTrace();
+}
+
+NAN_METHOD(FSUIPC::StopTrace) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  info.GetReturnValue().Set(
+      Nan::New(self->stats.StopTrace()).ToLocalChecked());
+}
+
+static v8::Local<v8::Object> SchedulerStatsToObject(
+    const SchedulerStats& stats) {
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  Nan::Set(obj, Nan::New("cycles").ToLocalChecked(),
+           Nan::New((double)stats.cycles));
+  Nan::Set(obj, Nan::New("idle").ToLocalChecked(),
+           Nan::New((double)stats.idle));
+  Nan::Set(obj, Nan::New("requestedHz").ToLocalChecked(),
+           Nan::New(stats.requested_hz));
+  Nan::Set(obj, Nan::New("effectiveHz").ToLocalChecked(),
+           Nan::New(stats.effective_hz));
+  Nan::Set(obj, Nan::New("overruns").ToLocalChecked(),
+           Nan::New((double)stats.overruns));
+  Nan::Set(obj, Nan::New("missed").ToLocalChecked(),
+           Nan::New((double)stats.missed));
+
+  // Reported in milliseconds, like the phases of stats()
+  Nan::Set(obj, Nan::New("lateness").ToLocalChecked(),
+           HistogramToObject(stats.lateness, 1e6));
+  Nan::Set(obj, Nan::New("jitter").ToLocalChecked(),
+           HistogramToObject(stats.jitter, 1e6));
+
+  return obj;
+}
+
+NAN_METHOD(FSUIPC::StopPolling) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (!self->scheduler) {
+    return;
+  }
+
+  // Waits for a cycle in progress
+  self->scheduler->Stop();
+  SchedulerStats stats = self->scheduler->GetStats();
+
+  self->StopScheduler();
+  self->Unref();
+
+  info.GetReturnValue().Set(SchedulerStatsToObject(stats));
+}
+
+NAN_METHOD(FSUIPC::GetPollingStats) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (!self->scheduler) {
+    return;
+  }
+
+  info.GetReturnValue().Set(
+      SchedulerStatsToObject(self->scheduler->GetStats()));
+}
+
+NAN_METHOD(FSUIPC::EnableAdaptive) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsObject()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableAdaptive: expected first argument to be object")
+            .ToLocalChecked());
+  }
+
+  v8::Local<v8::Object> options = info[0].As<v8::Object>();
+  v8::Local<v8::Value> min_value =
+      Nan::Get(options, Nan::New("minHz").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> max_value =
+      Nan::Get(options, Nan::New("maxHz").ToLocalChecked()).ToLocalChecked();
+
+  if (!min_value->IsNumber() ||
+      !(min_value->NumberValue(Nan::GetCurrentContext()).ToChecked() > 0)) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableAdaptive: expected minHz to be a number > 0")
+            .ToLocalChecked());
+  }
+
+  double min_hz = min_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+  uint64_t min_interval = 0;
+
+  if (!max_value->IsUndefined()) {
+    if (!max_value->IsNumber() ||
+        !(max_value->NumberValue(Nan::GetCurrentContext()).ToChecked() >=
+          min_hz)) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.EnableAdaptive: expected maxHz to be a number >= "
+                   "minHz")
+              .ToLocalChecked());
+    }
+
+    min_interval = (uint64_t)(
+        1e9 / max_value->NumberValue(Nan::GetCurrentContext()).ToChecked());
+  }
+
+  // The multiplexer already reads each offset once per tick for all the
+  // instances sharing the link
+  if (self->shared) {
+    return;
+  }
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  self->adaptive_min_interval = min_interval;
+  self->adaptive_max_interval = (uint64_t)(1e9 / min_hz);
+
+  if (self->adaptive) {
+    return;
+  }
+
+  self->adaptive = true;
+
+  std::map<std::string, Offset>::iterator it = self->offsets.begin();
+  for (; it != self->offsets.end(); ++it) {
+    it->second.adaptive = std::make_shared<AdaptiveRate>(it->second.size);
+  }
+}
+
+NAN_METHOD(FSUIPC::DisableAdaptive) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  self->adaptive = false;
+
+  std::map<std::string, Offset>::iterator it = self->offsets.begin();
+  for (; it != self->offsets.end(); ++it) {
+    it->second.adaptive.reset();
+  }
+}
+
+NAN_METHOD(FSUIPC::GetAdaptiveIntervals) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  if (!self->adaptive) {
+    return;
+  }
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  std::map<std::string, Offset>::iterator it = self->offsets.begin();
+  for (; it != self->offsets.end(); ++it) {
+    Nan::Set(obj, Nan::New(it->second.name).ToLocalChecked(),
+             Nan::New(it->second.adaptive->Interval() / 1e6));
+  }
+
+  info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(FSUIPC::GetQuarantined) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  v8::Local<v8::Array> names = Nan::New<v8::Array>();
+  uint32_t i = 0;
+
+  std::map<std::string, Offset>::iterator it = self->offsets.begin();
+  for (; it != self->offsets.end(); ++it) {
+    if (it->second.quarantined) {
+      Nan::Set(names, i++, Nan::New(it->second.name).ToLocalChecked());
+    }
+  }
+
+  info.GetReturnValue().Set(names);
+}
+
+NAN_METHOD(FSUIPC::ClearQuarantine) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  std::map<std::string, Offset>::iterator it = self->offsets.begin();
+  for (; it != self->offsets.end(); ++it) {
+    it->second.quarantined = false;
+  }
+
+  std::vector<Sentinel>::iterator sentinel = self->sentinels.begin();
+  for (; sentinel != self->sentinels.end(); ++sentinel) {
+    sentinel->quarantined = false;
+  }
+}
+
+NAN_METHOD(FSUIPC::EnableHistory) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableHistory: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  if (info.Length() > 1 && !info[1]->IsObject()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableHistory: expected second argument to be object")
+            .ToLocalChecked());
+  }
+
+  uint32_t samples = 0;
+  uint32_t window = 0;
+
+  if (info.Length() > 1) {
+    v8::Local<v8::Object> options = info[1].As<v8::Object>();
+    v8::Local<v8::Value> samples_value =
+        Nan::Get(options, Nan::New("samples").ToLocalChecked())
+            .ToLocalChecked();
+    v8::Local<v8::Value> window_value =
+        Nan::Get(options, Nan::New("windowMs").ToLocalChecked())
+            .ToLocalChecked();
+
+    if (!samples_value->IsUndefined()) {
+      if (!samples_value->IsUint32()) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.EnableHistory: expected samples to be uint")
+                .ToLocalChecked());
+      }
+      samples =
+          samples_value->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+    }
+
+    if (!window_value->IsUndefined()) {
+      if (!window_value->IsUint32()) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.EnableHistory: expected windowMs to be uint")
+                .ToLocalChecked());
+      }
+      window =
+          window_value->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+    }
+  }
+
+  if (samples == 0 && window == 0) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableHistory: expected samples or windowMs to be "
+                 "> 0")
+            .ToLocalChecked());
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  auto it = self->offsets.find(name);
+
+  if (it == self->offsets.end()) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.EnableHistory: no offset named " + name)
+            .ToLocalChecked());
+  }
+
+  if (!IsNumericType(it->second.type)) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableHistory: history requires a numeric type")
+            .ToLocalChecked());
+  }
+
+  it->second.history =
+      std::make_shared<History>(samples, (uint64_t)window * 1000000);
+}
+
+NAN_METHOD(FSUIPC::DisableHistory) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.DisableHistory: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  auto it = self->offsets.find(name);
+
+  if (it != self->offsets.end()) {
+    it->second.history.reset();
+  }
+}
+
+// Creates a Float64Array of length elements and returns its contents
+static v8::Local<v8::Float64Array> NewFloat64Array(size_t length,
+                                                   double** contents) {
+  v8::Local<v8::ArrayBuffer> buffer =
+      v8::ArrayBuffer::New(v8::Isolate::GetCurrent(), length * sizeof(double));
+  v8::Local<v8::Float64Array> array =
+      v8::Float64Array::New(buffer, 0, length);
+
+  Nan::TypedArrayContents<double> typed(array);
+  *contents = *typed;
+
+  return array;
+}
+
+NAN_METHOD(FSUIPC::GetHistory) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.History: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  if ((info.Length() > 1 && !info[1]->IsNumber() && !info[1]->IsUndefined()) ||
+      (info.Length() > 2 && !info[2]->IsNumber() && !info[2]->IsUndefined())) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.History: expected fromTs and toTs to be numbers")
+            .ToLocalChecked());
+  }
+
+  uint64_t from = 0;
+  uint64_t to = UINT64_MAX;
+
+  if (info.Length() > 1 && info[1]->IsNumber()) {
+    from =
+        MsToHrtime(info[1]->NumberValue(Nan::GetCurrentContext()).ToChecked());
+  }
+
+  if (info.Length() > 2 && info[2]->IsNumber()) {
+    to = MsToHrtime(info[2]->NumberValue(Nan::GetCurrentContext()).ToChecked());
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+
+  auto it = self->offsets.find(name);
+
+  if (it == self->offsets.end() || !it->second.history) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.History: history is not enabled for " + name)
+            .ToLocalChecked());
+  }
+
+  size_t first;
+  size_t count = it->second.history->Find(from, to, &first);
+
+  double* timestamps;
+  double* values;
+  v8::Local<v8::Float64Array> timestamps_array =
+      NewFloat64Array(count, &timestamps);
+  v8::Local<v8::Float64Array> values_array = NewFloat64Array(count, &values);
+
+  it->second.history->CopyTo(first, count, timestamps, values);
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("timestamps").ToLocalChecked(), timestamps_array);
+  Nan::Set(obj, Nan::New("values").ToLocalChecked(), values_array);
+
+  info.GetReturnValue().Set(obj);
+}
+
+NAN_METHOD(FSUIPC::EnableEstimate) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableEstimate: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  if (info.Length() > 1 && !info[1]->IsObject()) {
+    return Nan::ThrowTypeError(
+        Nan::New(
+            "FSUIPC.EnableEstimate: expected second argument to be object")
+            .ToLocalChecked());
+  }
+
+  std::string velocity;
+  double velocity_scale = 1;
+  double wrap = 0;
+  double max_extrapolation = 500;
+
+  if (info.Length() > 1) {
+    v8::Local<v8::Object> options = info[1].As<v8::Object>();
+    v8::Local<v8::Value> velocity_value =
+        Nan::Get(options, Nan::New("velocity").ToLocalChecked())
+            .ToLocalChecked();
+    v8::Local<v8::Value> scale_value =
+        Nan::Get(options, Nan::New("velocityScale").ToLocalChecked())
+            .ToLocalChecked();
+    v8::Local<v8::Value> wrap_value =
+        Nan::Get(options, Nan::New("wrap").ToLocalChecked()).ToLocalChecked();
+    v8::Local<v8::Value> max_value =
+        Nan::Get(options, Nan::New("maxExtrapolationMs").ToLocalChecked())
+            .ToLocalChecked();
+
+    if (!velocity_value->IsUndefined()) {
+      if (!velocity_value->IsString()) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.EnableEstimate: expected velocity to be string")
+                .ToLocalChecked());
+      }
+      velocity = *Nan::Utf8String(velocity_value);
+    }
+
+    if (!scale_value->IsUndefined()) {
+      if (!scale_value->IsNumber()) {
+        return Nan::ThrowTypeError(
+            Nan::New(
+                "FSUIPC.EnableEstimate: expected velocityScale to be number")
+                .ToLocalChecked());
+      }
+      velocity_scale =
+          scale_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+    }
+
+    if (!wrap_value->IsUndefined()) {
+      if (!wrap_value->IsNumber() ||
+          !(wrap_value->NumberValue(Nan::GetCurrentContext()).ToChecked() >
+            0)) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.EnableEstimate: expected wrap to be > 0")
+                .ToLocalChecked());
+      }
+      wrap = wrap_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+    }
+
+    if (!max_value->IsUndefined()) {
+      if (!max_value->IsNumber() ||
+          !(max_value->NumberValue(Nan::GetCurrentContext()).ToChecked() >=
+            0)) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.EnableEstimate: expected maxExtrapolationMs to "
+                     "be >= 0")
+                .ToLocalChecked());
+      }
+      max_extrapolation =
+          max_value->NumberValue(Nan::GetCurrentContext()).ToChecked();
+    }
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  // Offsets are only added and removed on the main thread, so they can be
+  // looked up here without waiting for a cycle
+  auto it = self->offsets.find(name);
+
+  if (it == self->offsets.end()) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.EnableEstimate: no offset named " + name)
+            .ToLocalChecked());
+  }
+
+  if (!IsNumericType(it->second.type)) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.EnableEstimate: estimation requires a numeric type")
+            .ToLocalChecked());
+  }
+
+  if (!velocity.empty()) {
+    auto velocity_it = self->offsets.find(velocity);
+
+    if (velocity_it == self->offsets.end() ||
+        !IsNumericType(velocity_it->second.type)) {
+      return Nan::ThrowError(
+          Nan::New("FSUIPC.EnableEstimate: no numeric offset named " +
+                   velocity)
+              .ToLocalChecked());
+    }
+  }
+
+  std::lock_guard<std::mutex> guard(self->estimators_mutex);
+  self->estimators[name] = std::unique_ptr<Estimator>(new Estimator(
+      velocity, velocity_scale, wrap, MsToHrtime(max_extrapolation)));
+}
+
+NAN_METHOD(FSUIPC::DisableEstimate) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New(
+            "FSUIPC.DisableEstimate: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  std::lock_guard<std::mutex> guard(self->estimators_mutex);
+  self->estimators.erase(name);
+}
+
+NAN_METHOD(FSUIPC::Estimate) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Estimate: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  if (info.Length() > 1 && !info[1]->IsNumber() && !info[1]->IsUndefined()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Estimate: expected t to be number")
+            .ToLocalChecked());
+  }
+
+  uint64_t timestamp = uv_hrtime();
+
+  if (info.Length() > 1 && info[1]->IsNumber()) {
+    timestamp =
+        MsToHrtime(info[1]->NumberValue(Nan::GetCurrentContext()).ToChecked());
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  double value;
+  bool estimated;
+  {
+    std::lock_guard<std::mutex> guard(self->estimators_mutex);
+
+    auto it = self->estimators.find(name);
+
+    if (it == self->estimators.end()) {
+      return Nan::ThrowError(
+          Nan::New("FSUIPC.Estimate: estimation is not enabled for " + name)
+              .ToLocalChecked());
+    }
+
+    estimated = it->second->Estimate(timestamp, &value);
+  }
+
+  if (estimated) {
+    info.GetReturnValue().Set(Nan::New(value));
+  }
+}
+
+// Parses the offset names and time range shared by aggregate() and
+// downsample(), and looks up their history buffers
+static bool ParseHistoryJobs(const Nan::FunctionCallbackInfo<v8::Value>& info,
+                             const std::string& method,
+                             std::map<std::string, Offset>& offsets,
+                             std::vector<AggregateAsyncWorker::Job>* jobs,
+                             uint64_t* from,
+                             uint64_t* to) {
+  if (info.Length() < 2 || !info[0]->IsArray() || !info[1]->IsObject()) {
+    Nan::ThrowTypeError(
+        Nan::New(method + ": expected an array of names and an object")
+            .ToLocalChecked());
+    return false;
+  }
+
+  v8::Local<v8::Object> options = info[1].As<v8::Object>();
+  v8::Local<v8::Value> from_value =
+      Nan::Get(options, Nan::New("fromTs").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> to_value =
+      Nan::Get(options, Nan::New("toTs").ToLocalChecked()).ToLocalChecked();
+
+  if ((!from_value->IsUndefined() && !from_value->IsNumber()) ||
+      (!to_value->IsUndefined() && !to_value->IsNumber())) {
+    Nan::ThrowTypeError(
+        Nan::New(method + ": expected fromTs and toTs to be numbers")
+            .ToLocalChecked());
+    return false;
+  }
+
+  *from = 0;
+  *to = UINT64_MAX;
+
+  if (from_value->IsNumber()) {
+    *from = MsToHrtime(
+        from_value->NumberValue(Nan::GetCurrentContext()).ToChecked());
+  }
+
+  if (to_value->IsNumber()) {
+    *to =
+        MsToHrtime(to_value->NumberValue(Nan::GetCurrentContext()).ToChecked());
+  }
+
+  v8::Local<v8::Array> names = info[0].As<v8::Array>();
+
+  for (uint32_t i = 0; i < names->Length(); i++) {
+    v8::Local<v8::Value> name_value = Nan::Get(names, i).ToLocalChecked();
+
+    if (!name_value->IsString()) {
+      Nan::ThrowTypeError(Nan::New(method + ": expected names to be strings")
+                              .ToLocalChecked());
+      return false;
+    }
+
+    std::string name = std::string(*Nan::Utf8String(name_value));
+
+    auto it = offsets.find(name);
+
+    if (it == offsets.end() || !it->second.history) {
+      Nan::ThrowError(
+          Nan::New(method + ": history is not enabled for " + name)
+              .ToLocalChecked());
+      return false;
+    }
+
+    AggregateAsyncWorker::Job job;
+    job.name = name;
+    job.history = it->second.history;
+    jobs->push_back(std::move(job));
+  }
+
+  return true;
+}
+
+NAN_METHOD(FSUIPC::AggregateHistory) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::vector<AggregateAsyncWorker::Job> jobs;
+  uint64_t from;
+  uint64_t to;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    if (!ParseHistoryJobs(info, "FSUIPC.Aggregate", self->offsets, &jobs,
+                          &from, &to)) {
+      return;
+    }
+  }
+
+  v8::Local<v8::Value> window_value =
+      Nan::Get(info[1].As<v8::Object>(), Nan::New("windowMs").ToLocalChecked())
+          .ToLocalChecked();
+
+  if (!window_value->IsNumber() ||
+      !(window_value->NumberValue(Nan::GetCurrentContext()).ToChecked() > 0)) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Aggregate: expected windowMs to be a number > 0")
+            .ToLocalChecked());
+  }
+
+  AggregateAsyncWorker* worker =
+      new AggregateAsyncWorker(self, std::move(jobs), from, to);
+  worker->Aggregate(
+      window_value->NumberValue(Nan::GetCurrentContext()).ToChecked());
+
+  PromiseQueueWorker(worker);
+
+  info.GetReturnValue().Set(worker->GetPromise());
+}
+
+NAN_METHOD(FSUIPC::DownsampleHistory) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::vector<AggregateAsyncWorker::Job> jobs;
+  uint64_t from;
+  uint64_t to;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    if (!ParseHistoryJobs(info, "FSUIPC.Downsample", self->offsets, &jobs,
+                          &from, &to)) {
+      return;
+    }
+  }
+
+  v8::Local<v8::Object> options = info[1].As<v8::Object>();
+  v8::Local<v8::Value> points_value =
+      Nan::Get(options, Nan::New("points").ToLocalChecked()).ToLocalChecked();
+  v8::Local<v8::Value> method_value =
+      Nan::Get(options, Nan::New("method").ToLocalChecked()).ToLocalChecked();
+
+  if (!points_value->IsUint32() ||
+      points_value->Uint32Value(Nan::GetCurrentContext()).ToChecked() < 3) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.Downsample: expected points to be uint >= 3")
+            .ToLocalChecked());
+  }
+
+  DownsampleMethod method = DownsampleMethod::LTTB;
+
+  if (!method_value->IsUndefined()) {
+    std::string method_name = std::string(*Nan::Utf8String(method_value));
+
+    if (method_name == "minmax") {
+      method = DownsampleMethod::MinMax;
+    } else if (method_name != "lttb") {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.Downsample: expected method to be 'lttb' or "
+                   "'minmax'")
+              .ToLocalChecked());
+    }
+  }
+
+  AggregateAsyncWorker* worker =
+      new AggregateAsyncWorker(self, std::move(jobs), from, to);
+  worker->Downsample(
+      method, points_value->Uint32Value(Nan::GetCurrentContext()).ToChecked());
+
+  PromiseQueueWorker(worker);
+
+  info.GetReturnValue().Set(worker->GetPromise());
+}
+
+NAN_METHOD(FSUIPC::StartRecording) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.StartRecording: expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  std::string path = std::string(*Nan::Utf8String(info[0]));
+
+  std::shared_ptr<Recorder> recorder = std::make_shared<Recorder>();
+  std::string error;
+
+  if (!recorder->Start(path, &error)) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.StartRecording: " + error).ToLocalChecked());
+  }
+
+  std::shared_ptr<Recorder> previous;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    previous.swap(self->recorder);
+    self->recorder = recorder;
+  }
+
+  // Stopping joins the writer thread, so don't hold up cycles meanwhile
+  if (previous) {
+    previous->Stop();
+  }
+}
+
+NAN_METHOD(FSUIPC::StopRecording) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::shared_ptr<Recorder> recorder;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    recorder.swap(self->recorder);
+  }
+
+  if (!recorder) {
+    return;
+  }
+
+  recorder->Stop();
+
+  RecorderStats stats = recorder->GetStats();
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("frames").ToLocalChecked(),
+           Nan::New((double)stats.frames));
+  Nan::Set(obj, Nan::New("dropped").ToLocalChecked(),
+           Nan::New((double)stats.dropped));
+  Nan::Set(obj, Nan::New("bytes").ToLocalChecked(),
+           Nan::New((double)stats.bytes));
+  if (!stats.error.empty()) {
+    Nan::Set(obj, Nan::New("error").ToLocalChecked(),
+             Nan::New(stats.error).ToLocalChecked());
+  }
+
+  info.GetReturnValue().Set(obj);
+}
+
+static v8::Local<v8::Object> PublisherStatsToObject(
+    const PublisherStats& stats) {
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("subscribers").ToLocalChecked(),
+           Nan::New((double)stats.subscribers));
+  Nan::Set(obj, Nan::New("frames").ToLocalChecked(),
+           Nan::New((double)stats.frames));
+  Nan::Set(obj, Nan::New("dropped").ToLocalChecked(),
+           Nan::New((double)stats.dropped));
+  if (!stats.error.empty()) {
+    Nan::Set(obj, Nan::New("error").ToLocalChecked(),
+             Nan::New(stats.error).ToLocalChecked());
+  }
+  return obj;
+}
+
+NAN_METHOD(FSUIPC::StartPublishing) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  if (info.Length() < 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("FSUIPC.StartPublishing: expected first argument to be "
+                 "string")
+            .ToLocalChecked());
+  }
+
+  size_t queue_size = 4;
+
+  if (info.Length() > 1) {
+    if (!info[1]->IsObject()) {
+      return Nan::ThrowTypeError(
+          Nan::New("FSUIPC.StartPublishing: expected second argument to be "
+                   "object")
+              .ToLocalChecked());
+    }
+
+    v8::Local<v8::Value> queue_size_value =
+        Nan::Get(info[1].As<v8::Object>(),
+                 Nan::New("queueSize").ToLocalChecked())
+            .ToLocalChecked();
+
+    if (!queue_size_value->IsUndefined()) {
+      if (!queue_size_value->IsUint32() ||
+          queue_size_value->Uint32Value(Nan::GetCurrentContext())
+                  .ToChecked() == 0) {
+        return Nan::ThrowTypeError(
+            Nan::New("FSUIPC.StartPublishing: expected queueSize to be "
+                     "uint > 0")
+                .ToLocalChecked());
+      }
+
+      queue_size =
+          queue_size_value->Uint32Value(Nan::GetCurrentContext()).ToChecked();
+    }
+  }
+
+  std::string name = std::string(*Nan::Utf8String(info[0]));
+
+  std::shared_ptr<Publisher> publisher = std::make_shared<Publisher>();
+  std::string error;
+
+  if (!publisher->Start(name, queue_size, &error)) {
+    return Nan::ThrowError(
+        Nan::New("FSUIPC.StartPublishing: " + error).ToLocalChecked());
+  }
+
+  std::shared_ptr<Publisher> previous;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    previous.swap(self->publisher);
+    self->publisher = publisher;
+  }
+
+  // Stopping joins the subscriber threads, so don't hold up cycles meanwhile
+  if (previous) {
+    previous->Stop();
+  }
+}
+
+NAN_METHOD(FSUIPC::StopPublishing) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::shared_ptr<Publisher> publisher;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    publisher.swap(self->publisher);
+  }
+
+  if (!publisher) {
+    return;
+  }
+
+  PublisherStats stats = publisher->GetStats();
+  publisher->Stop();
+
+  info.GetReturnValue().Set(PublisherStatsToObject(stats));
+}
+
+NAN_METHOD(FSUIPC::GetPublishingStats) {
+  FSUIPC* self = Nan::ObjectWrap::Unwrap<FSUIPC>(info.This());
+
+  std::shared_ptr<Publisher> publisher;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(self->offsets_mutex);
+    publisher = self->publisher;
+  }
+
+  if (!publisher) {
+    return;
+  }
+
+  info.GetReturnValue().Set(PublisherStatsToObject(publisher->GetStats()));
+}
+
+// Milliseconds left of a timeout that started at start, or 0 if there is no
+// timeout
+static DWORD RemainingMs(uint64_t start, DWORD timeout) {
+  if (!timeout) {
+    return 0;
+  }
+
+  uint64_t elapsed = (uv_hrtime() - start) / 1000000;
+  return elapsed < timeout ? timeout - (DWORD)elapsed : 1;
+}
+
+// Whether the read-back of a verified write shows the value written. Strings
+// only have to match up to their terminator, the sim may keep anything after.
+static bool VerifyMatches(const WriteAck& ack, const OffsetWrite& write) {
+  const char* src = static_cast<const char*>(write.src);
+  const BYTE* readback = ack.readback.data();
+
+  if (ack.type != Type::String) {
+    return memcmp(readback, src, write.size) == 0;
+  }
+
+  size_t length = strnlen(src, write.size);
+
+  return memcmp(readback, src, length) == 0 &&
+         (length == write.size || readback[length] == 0);
+}
+
+bool FSUIPC::FlushPriorityWrites(Error* result, DWORD timeout) {
+  uint64_t start = uv_hrtime();
+  std::vector<PriorityWrite> writes;
+
+  {
+    std::lock_guard<std::mutex> guard(this->priority_mutex);
+    writes.swap(this->priority_writes);
+  }
+
+  *result = Error::OK;
+
+  if (writes.empty()) {
+    return true;
+  }
+
+  bool ok = true;
+  // Writes before sent were acknowledged by a request that succeeded, and
+  // queued ones are in the request being built
+  size_t sent = 0;
+  size_t queued = 0;
+
+  auto acknowledge = [&](bool acked_ok) {
+    uint64_t acked = uv_hrtime();
+
+    for (; sent < queued; sent++) {
+      PriorityWrite& priority = writes[sent];
+
+      if (acked_ok) {
+        this->WriteThrough(priority.write, acked);
+      }
+      if (acked_ok && priority.ack->verify) {
+        priority.ack->mismatch = !VerifyMatches(*priority.ack, priority.write);
+      }
+      free(priority.write.src);
+
+      priority.ack->acked = acked;
+      priority.ack->result = *result;
+      priority.ack->done = true;
+    }
+  };
+
+  for (; ok && queued < writes.size(); queued++) {
+    PriorityWrite& priority = writes[queued];
+
+    // FSUIPC handles a request in order, so a read of the same range right
+    // after the write returns what the sim made of it. Both have to go in
+    // the same request.
+    DWORD readback = priority.ack->verify ? priority.write.size : 0;
+
+    // Request area is full, send what we have and start a new request. A
+    // write that doesn't fit in an empty request can never be sent.
+    if (!this->ipc->Fits(priority.write.size, readback)) {
+      if (queued == sent) {
+        *result = Error::SIZE;
+        ok = false;
+        break;
+      }
+
+      ok = this->ipc->Process(result, RemainingMs(start, timeout));
+      if (!ok) {
+        break;
+      }
+
+      acknowledge(true);
+    }
+
+    ok = this->ipc->Write(priority.write.offset, priority.write.size,
+                          priority.write.src, result);
+
+    if (ok && priority.ack->verify) {
+      ok = this->ipc->Read(priority.write.offset, priority.write.size,
+                           priority.ack->readback.data(), result);
+    }
+  }
+
+  if (ok) {
+    ok = this->ipc->Process(result, RemainingMs(start, timeout));
+  } else {
+    this->ipc->Discard();
+  }
+
+  // The rest of the writes failed with the request that would have sent them
+  queued = writes.size();
+  acknowledge(ok);
+
+  return ok;
+}
+
+void FSUIPC::WriteThrough(const OffsetWrite& write, uint64_t timestamp) {
+  Mirror* mirror = this->mirror.load();
+
+  if (mirror && Mirror::Covers(write.offset, write.size)) {
+    mirror->Store(write.offset, write.size, write.src, timestamp);
+  }
+}
+
+bool FSUIPC::RunCycle(Error* result, DWORD timeout, CycleTiming* timing) {
+  CycleStart start;
+  this->StartCycle(&start, timing);
+
+  bool ok = this->shared
+                ? Multiplexer::Instance().Process(this, result, timeout)
+                : this->RunOwnCycle(result, timeout, start.time, timing);
+
+  this->FinishCycle(ok, *result, start, timing);
+
+  return ok;
+}
+
+void FSUIPC::StartCycle(CycleStart* start, CycleTiming* timing) {
+  start->time = uv_hrtime();
+  start->counters = this->ipc->GetCounters();
+
+  timing->phases[static_cast<int>(Phase::MutexWait)] = 0;
+}
+
+void FSUIPC::FinishCycle(bool ok,
+                         Error result,
+                         const CycleStart& start,
+                         CycleTiming* timing) {
+  const LinkCounters& before = start.counters;
+  LinkCounters after = this->ipc->GetCounters();
+
+  uint64_t* phases = timing->phases;
+  phases[static_cast<int>(Phase::RoundTrip)] =
+      after.round_trip - before.round_trip;
+  phases[static_cast<int>(Phase::Decode)] = after.decode - before.decode;
+  phases[static_cast<int>(Phase::Encode)] = after.encode - before.encode;
+
+  this->stats.RecordCycle(*timing, before, after, ok);
+
+  // The connection manager checks whether the sim is still there
+  ConnectionManager* connection = this->connection.load();
+  if (!ok && connection &&
+      (result == Error::SENDMSG || result == Error::TIMEOUT)) {
+    connection->LinkFailed(result);
+  }
+
+  if (ok) {
+    this->last_cycle = uv_hrtime();
+  }
+}
+
+bool FSUIPC::RunOwnCycle(Error* result,
+                         DWORD timeout,
+                         uint64_t start,
+                         CycleTiming* timing) {
+  std::unique_lock<std::timed_mutex> guard(this->offsets_mutex,
+                                           std::defer_lock);
+  std::unique_lock<std::timed_mutex> fsuipc_guard(*this->fsuipc_mutex,
+                                                  std::defer_lock);
+
+  if (timeout) {
+    auto until =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+    if (!guard.try_lock_until(until) || !fsuipc_guard.try_lock_until(until)) {
+      *result = Error::TIMEOUT;
+      return false;
+    }
+  } else {
+    guard.lock();
+    fsuipc_guard.lock();
+  }
+
+  timing->phases[static_cast<int>(Phase::MutexWait)] = uv_hrtime() - start;
+
+  // Priority writes preempt the polling batch and go out in their own request
+  if (!this->FlushPriorityWrites(result, RemainingMs(start, timeout))) {
+    return false;
+  }
+
+  Mirror* mirror = this->mirror.load();
+  uint64_t now = uv_hrtime();
+  bool queued = false;
+  // Set when an offset isn't read directly, because it is quarantined, not
+  // due or read through the mirror
+  bool skipped = false;
+
+  this->queued_offsets.clear();
+
+  std::map<std::string, Offset>::iterator it = this->offsets.begin();
+
+  for (; it != this->offsets.end(); ++it) {
+    Offset& value = it->second;
+
+    if (value.quarantined) {
+      skipped = true;
+      continue;
+    }
+
+    // Quiet offsets keep the value of their last read until they are due
+    if (value.adaptive && !value.adaptive->Due(now)) {
+      skipped = true;
+      continue;
+    }
+
+    if (mirror && Mirror::Covers(value.offset, value.size)) {
+      skipped = true;
+      // Fresh enough values are copied from the mirror after the request
+      if (!value.max_age ||
+          !mirror->Fresh(value.offset, value.size,
+                         now > value.max_age ? now - value.max_age : 1)) {
+        mirror->Want(value.offset, value.size);
+      }
+      continue;
+    }
+
+    if (!this->ipc->Read(value.offset, value.size, value.dest, result)) {
+      this->ipc->Discard();
+      return false;
+    }
+    this->queued_offsets.push_back(&value);
+    queued = true;
+  }
+
+  if (!this->QueueSentinels(result, &queued)) {
+    this->ipc->Discard();
+    return false;
+  }
+
+  const std::vector<Mirror::Range>* ranges =
+      mirror ? &mirror->Coalesce() : nullptr;
+
+  if (ranges) {
+    std::vector<Mirror::Range>::const_iterator range = ranges->begin();
+
+    for (; range != ranges->end(); ++range) {
+      if (!this->ipc->Read(range->offset, range->size,
+                           mirror->At(range->offset), result)) {
+        this->ipc->Discard();
+        return false;
+      }
+      queued = true;
+    }
+  }
+
+  std::vector<OffsetWrite>::iterator write_it = this->offset_writes.begin();
+
+  for (; write_it != this->offset_writes.end(); ++write_it) {
+    if (!this->ipc->Write(write_it->offset, write_it->size, write_it->src,
+                          result)) {
+      // Writes stay queued for the next cycle
+      this->ipc->Discard();
+      return false;
+    }
+    queued = true;
+  }
+
+  // Sent writes are kept until the request is done, for the mirror
+  this->sent_writes.swap(this->offset_writes);
+
+  // Every read was served by the mirror, skipped as not due or quarantined,
+  // so the sim isn't bothered at all
+  bool ok = (!queued && skipped) ||
+            this->ipc->Process(result, RemainingMs(start, timeout));
+
+  // FSUIPC fails the whole request over a single offset it doesn't have.
+  // Once the bad offsets are quarantined, all reads done while looking for
+  // them are current, so only the writes are sent again.
+  if (!ok && *result == Error::DATA &&
+      this->QuarantineRejected(result, ranges, start, timeout)) {
+    ok = true;
+
+    for (write_it = this->sent_writes.begin();
+         ok && write_it != this->sent_writes.end(); ++write_it) {
+      ok = this->ipc->Write(write_it->offset, write_it->size, write_it->src,
+                            result);
+    }
+
+    if (!ok) {
+      this->ipc->Discard();
+    } else if (!this->sent_writes.empty()) {
+      ok = this->ipc->Process(result, RemainingMs(start, timeout));
+    }
+  }
+
+  uint64_t fetched = uv_hrtime();
+
+  if (ok && mirror) {
+    mirror->MarkCoalesced(fetched);
+
+    for (write_it = this->sent_writes.begin();
+         write_it != this->sent_writes.end(); ++write_it) {
+      this->WriteThrough(*write_it, fetched);
+    }
+
+    for (it = this->offsets.begin(); it != this->offsets.end(); ++it) {
+      if (Mirror::Covers(it->second.offset, it->second.size)) {
+        CopyMemory(it->second.dest, mirror->At(it->second.offset),
+                   it->second.size);
+        it->second.read_at =
+            mirror->FetchedAt(it->second.offset, it->second.size);
+      }
+    }
+  }
+
+  for (write_it = this->sent_writes.begin();
+       write_it != this->sent_writes.end(); ++write_it) {
+    free(write_it->src);
+  }
+
+  // Keeps its capacity, so steady-state cycles don't allocate
+  this->sent_writes.clear();
+
+  if (!ok) {
+    return false;
+  }
+
+  std::vector<Offset*>::iterator queued_it = this->queued_offsets.begin();
+  for (; queued_it != this->queued_offsets.end(); ++queued_it) {
+    if (!(*queued_it)->quarantined) {
+      (*queued_it)->read_at = fetched;
+    }
+  }
+
+  if (this->adaptive) {
+    for (it = this->offsets.begin(); it != this->offsets.end(); ++it) {
+      AdaptiveRate* adaptive = it->second.adaptive.get();
+
+      if (adaptive && adaptive->Due(now)) {
+        adaptive->Update(fetched, it->second.dest, this->adaptive_min_interval,
+                         this->adaptive_max_interval);
+      }
+    }
+  }
+
+  if (!this->sentinels.empty()) {
+    // The first cycle only seeds the values the next ones compare against
+    this->sim_idle = this->sentinels_seeded && this->SentinelsIdle();
+    this->sentinel_values.swap(this->sentinel_staging);
+    this->sentinels_seeded = true;
+  }
+
+  this->PublishCycle();
+
+  return true;
+}
+
+bool FSUIPC::QuarantineRejected(Error* result,
+                                const std::vector<Mirror::Range>* ranges,
+                                uint64_t start,
+                                DWORD timeout) {
+  // Each bad offset costs about two requests per halving, so a burst of
+  // them gives up rather than stalling the cycle
+  static const int kMaxRequests = 32;
+
+  Mirror* mirror = this->mirror.load();
+  std::vector<RejectedRead> reads;
+
+  std::vector<Offset*>::iterator queued = this->queued_offsets.begin();
+  for (; queued != this->queued_offsets.end(); ++queued) {
+    Offset* value = *queued;
+    reads.push_back(
+        RejectedRead{value->offset, value->size, value->dest, value, nullptr});
+  }
+
+  if (ranges) {
+    std::vector<Mirror::Range>::const_iterator range = ranges->begin();
+
+    for (; range != ranges->end(); ++range) {
+      std::map<std::string, Offset>::iterator it = this->offsets.begin();
+
+      for (; it != this->offsets.end(); ++it) {
+        Offset& value = it->second;
+
+        if (!value.quarantined && Mirror::Covers(value.offset, value.size) &&
+            value.offset >= range->offset &&
+            value.offset + value.size <= range->offset + range->size) {
+          reads.push_back(RejectedRead{value.offset, value.size,
+                                       mirror->At(value.offset), &value,
+                                       nullptr});
+        }
+      }
+    }
+  }
+
+  BYTE* staging = this->sentinel_staging.data();
+
+  std::vector<Sentinel>::iterator sentinel = this->sentinels.begin();
+  for (; sentinel != this->sentinels.end(); ++sentinel) {
+    if (!sentinel->quarantined) {
+      reads.push_back(RejectedRead{sentinel->offset, sentinel->size, staging,
+                                   nullptr, &*sentinel});
+    }
+    staging += sentinel->size;
+  }
+
+  std::vector<const RejectedRead*> rejected;
+  int budget = kMaxRequests;
+
+  if (!this->BisectRejected(reads.data(), reads.size(), false, &budget,
+                            &rejected, result, start, timeout)) {
+    return false;
+  }
+
+  if (rejected.empty()) {
+    // Something other than a read was rejected
+    *result = Error::DATA;
+    return false;
+  }
+
+  PendingEvent event{"error", Error::DATA, Simulator::ANY};
+
+  std::vector<const RejectedRead*>::iterator it = rejected.begin();
+  for (; it != rejected.end(); ++it) {
+    if ((*it)->value) {
+      (*it)->value->quarantined = true;
+      event.offsets.push_back((*it)->value->name);
+    } else {
+      char name[32];
+      snprintf(name, sizeof(name), "sentinel 0x%04X",
+               (unsigned int)(*it)->sentinel->offset);
+      (*it)->sentinel->quarantined = true;
+      event.offsets.push_back(name);
+    }
+  }
+
+  // Only the ranges of the offsets left were read again
+  if (ranges) {
+    std::vector<RejectedRead>::iterator read = reads.begin();
+    for (; read != reads.end(); ++read) {
+      if (read->value && !read->value->quarantined &&
+          Mirror::Covers(read->offset, read->size)) {
+        mirror->Want(read->offset, read->size);
+      }
+    }
+    mirror->Coalesce();
+  }
+
+  this->Emit(std::move(event));
+
+  return true;
+}
+
+bool FSUIPC::BisectRejected(const RejectedRead* first,
+                            size_t count,
+                            bool failed,
+                            int* budget,
+                            std::vector<const RejectedRead*>* rejected,
+                            Error* result,
+                            uint64_t start,
+                            DWORD timeout) {
+  if (!count) {
+    return true;
+  }
+
+  if (!failed) {
+    if ((*budget)-- <= 0) {
+      *result = Error::DATA;
+      return false;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      if (!this->ipc->Read(first[i].offset, first[i].size, first[i].dest,
+                           result)) {
+        this->ipc->Discard();
+        return false;
+      }
+    }
+
+    if (this->ipc->Process(result, RemainingMs(start, timeout))) {
+      return true;
+    }
+
+    if (*result != Error::DATA) {
+      return false;
+    }
+  }
+
+  if (count == 1) {
+    rejected->push_back(first);
+    return true;
+  }
+
+  size_t half = count / 2;
+  size_t found = rejected->size();
+
+  if (!this->BisectRejected(first, half, false, budget, rejected, result,
+                            start, timeout)) {
+    return false;
+  }
+
+  // If the first half was fine, the second half is known to fail
+  return this->BisectRejected(first + half, count - half,
+                              rejected->size() == found, budget, rejected,
+                              result, start, timeout);
+}
+
+bool FSUIPC::QueueSentinels(Error* result, bool* queued) {
+  BYTE* staging = this->sentinel_staging.data();
+
+  std::vector<Sentinel>::iterator it = this->sentinels.begin();
+  for (; it != this->sentinels.end(); ++it) {
+    if (!it->quarantined) {
+      if (!this->ipc->Read(it->offset, it->size, staging, result)) {
+        return false;
+      }
+      *queued = true;
+    }
+    staging += it->size;
+  }
+
+  return true;
+}
+
+bool FSUIPC::SentinelsIdle() {
+  const BYTE* staging = this->sentinel_staging.data();
+  const BYTE* values = this->sentinel_values.data();
+  bool watched = false;
+  bool changed = false;
+
+  std::vector<Sentinel>::iterator it = this->sentinels.begin();
+  for (; it != this->sentinels.end(); ++it) {
+    // Quarantined sentinels aren't read anymore, so they don't count
+    if (it->quarantined) {
+      staging += it->size;
+      values += it->size;
+      continue;
+    }
+
+    if (it->paused) {
+      for (DWORD i = 0; i < it->size; i++) {
+        if (staging[i]) {
+          return true;
+        }
+      }
+    } else {
+      watched = true;
+      changed = changed || memcmp(staging, values, it->size);
+    }
+
+    staging += it->size;
+    values += it->size;
+  }
+
+  if (!watched || changed) {
+    this->sentinels_unchanged = 0;
+    return false;
+  }
+
+  // A single unchanged read may just have come before the next frame
+  if (this->sentinels_unchanged < kIdleCycles) {
+    this->sentinels_unchanged++;
+  }
+
+  return this->sentinels_unchanged >= kIdleCycles;
+}
+
+bool FSUIPC::ProbeSentinels(Error* result, DWORD timeout, bool* advanced) {
+  uint64_t start = uv_hrtime();
+  auto until =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout);
+
+  std::unique_lock<std::timed_mutex> guard(this->offsets_mutex,
+                                           std::defer_lock);
+  std::unique_lock<std::timed_mutex> fsuipc_guard(*this->fsuipc_mutex,
+                                                  std::defer_lock);
+
+  if (!guard.try_lock_until(until) || !fsuipc_guard.try_lock_until(until)) {
+    *result = Error::TIMEOUT;
+    return false;
+  }
+
+  // Queued writes go out with the full batch, paused or not
+  if (!this->offset_writes.empty()) {
+    *advanced = true;
+    return true;
+  }
+
+  bool queued = false;
+
+  if (!this->QueueSentinels(result, &queued)) {
+    this->ipc->Discard();
+    return false;
+  }
+
+  // With every sentinel quarantined there is nothing to probe, so the cycle
+  // runs in full
+  if (!queued) {
+    *advanced = true;
+    return true;
+  }
+
+  if (!this->ipc->Process(result, RemainingMs(start, timeout))) {
+    return false;
+  }
+
+  // The values stay those of the last cycle, which the next cycle compares
+  // against
+  *advanced = !this->SentinelsIdle();
+  return true;
+}
+
+void FSUIPC::PublishCycle() {
+  uint64_t timestamp = uv_hrtime();
+
+  if (this->snapshot) {
+    this->snapshot->Publish(this->offsets, this->layout_version);
+  }
+
+  if (this->state_file) {
+    this->state_file->Publish(timestamp, this->offsets, this->layout_version);
+  }
+
+  this->RecordSamples();
+
+  if (this->recorder) {
+    this->recorder->Capture(timestamp, this->offsets, this->layout_version);
+  }
+
+  if (this->publisher) {
+    this->publisher->Publish(timestamp, this->offsets, this->layout_version);
+  }
+}
+
+void FSUIPC::RecordSamples() {
+  std::lock_guard<std::mutex> guard(this->estimators_mutex);
+
+  std::map<std::string, Offset>::iterator it = this->offsets.begin();
+
+  for (; it != this->offsets.end(); ++it) {
+    Offset& value = it->second;
+
+    // Values kept from an earlier fetch were recorded back then
+    if (!value.read_at || value.read_at <= value.recorded_at) {
+      continue;
+    }
+
+    value.recorded_at = value.read_at;
+
+    if (value.history) {
+      value.history->Record(value.read_at,
+                            GetOffsetNumber(value.type, value.dest));
+    }
+
+    auto estimator = this->estimators.find(value.name);
+    if (estimator == this->estimators.end()) {
+      continue;
+    }
+
+    double rate = NAN;
+
+    // Only a velocity fetched along with the value is its rate
+    if (!estimator->second->velocity.empty()) {
+      auto velocity = this->offsets.find(estimator->second->velocity);
+      if (velocity != this->offsets.end() &&
+          velocity->second.read_at == value.read_at) {
+        rate = GetOffsetNumber(velocity->second.type, velocity->second.dest);
+      }
+    }
+
+    estimator->second->Record(value.read_at,
+                              GetOffsetNumber(value.type, value.dest), rate);
+  }
+}
+
+void CycleWorker::Execute() {
+  this->timing.phases[static_cast<int>(Phase::QueueWait)] =
+      uv_hrtime() - this->timing.start;
+
+  if (!this->fsuipc->shared) {
+    Error result;
+    bool ok = this->fsuipc->RunCycle(&result, 0, &this->timing);
+    this->CycleDone(ok, result);
+    return;
+  }
+
+  this->fsuipc->StartCycle(&this->start, &this->timing);
+
+  this->ticket = Multiplexer::Ticket{this->fsuipc, 0, &CycleWorker::TicketDone,
+                                     this, Error::OK, false};
+  this->deferred = !Multiplexer::Instance().Submit(&this->ticket);
+}
+
+void CycleWorker::TicketDone(void* context, Error result) {
+  CycleWorker* worker = static_cast<CycleWorker*>(context);
+  bool ok = result == Error::OK;
+
+  worker->fsuipc->FinishCycle(ok, result, worker->start, &worker->timing);
+  worker->CycleDone(ok, result);
+
+  if (worker->Arrive()) {
+    worker->fsuipc->FinishDeferred(worker);
+  }
+}
+
+void CycleWorker::Deferring() {
+  if (this->fsuipc->deferred_count++ == 0) {
+    this->fsuipc->deferred_notifier->Ref();
+  }
+}
+
+void FSUIPC::FinishDeferred(PromiseWorker* worker) {
+  std::lock_guard<std::mutex> guard(this->deferred_mutex);
+
+  this->deferred_workers.push_back(worker);
+  this->deferred_notifier->Notify();
+}
+
+void FSUIPC::DeliverDeferred() {
+  std::vector<PromiseWorker*> workers;
+  {
+    std::lock_guard<std::mutex> guard(this->deferred_mutex);
+    workers.swap(this->deferred_workers);
+  }
+
+  for (auto it = workers.begin(); it != workers.end(); ++it) {
+    (*it)->WorkComplete();
+    (*it)->Destroy();
+
+    if (--this->deferred_count == 0) {
+      this->deferred_notifier->Unref();
+    }
+  }
+}
+
+void ProcessAsyncWorker::Execute() {
+  this->started = true;
+
+  CycleWorker::Execute();
+}
+
+void ProcessAsyncWorker::CycleDone(bool ok, Error result) {
+  if (!ok) {
+    this->SetErrorMessage(ErrorToString(result));
+    this->errorCode = static_cast<int>(result);
+  }
+}
+
+void ProcessAsyncWorker::Reset() {
+  PromiseWorker::Reset();
+
+  this->started = false;
+  this->joined.clear();
+  this->timing = CycleTiming{uv_hrtime()};
+  this->errorCode = 0;
+  this->owner.Reset(this->fsuipc->handle());
+}
+
+void ProcessAsyncWorker::Destroy() {
+  // The owner is still referenced here, and its pool is emptied when it is
+  // collected
+  this->owner.Reset();
+  this->fsuipc->process_pool.push_back(this);
+}
+
+v8::Local<v8::Promise> ProcessAsyncWorker::Join() {
+  Nan::EscapableHandleScope scope;
+
+  v8::Local<v8::Promise::Resolver> resolver =
+      v8::Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked();
+  this->joined.emplace_back(resolver);
+
+  return scope.Escape(resolver->GetPromise());
+}
+
+v8::Local<v8::Object> FSUIPC::BuildResult() {
+  std::lock_guard<std::timed_mutex> guard(this->offsets_mutex);
+
+  return this->BuildResultLocked();
+}
+
+v8::Local<v8::Object> FSUIPC::BuildResultLocked() {
+  Nan::EscapableHandleScope scope;
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  std::map<std::string, Offset>::iterator it = this->offsets.begin();
+
+  for (; it != this->offsets.end(); ++it) {
+    Nan::Set(obj, Nan::New(it->second.name).ToLocalChecked(),
+             GetOffsetValue(it->second.type, it->second.dest, it->second.size));
+  }
+
+  return scope.Escape(obj);
+}
+
+void ProcessAsyncWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  if (this->fsuipc->pending_process == this) {
+    this->fsuipc->pending_process = nullptr;
+  }
+
+  uint64_t start = uv_hrtime();
+
+  v8::Local<v8::Object> obj = this->fsuipc->BuildResult();
+
+  this->fsuipc->stats.RecordPhase(Phase::Materialize, start,
+                                  uv_hrtime() - start);
+
+  // Callers that joined this cycle share the same result object
+  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), obj);
+  for (auto it = this->joined.begin(); it != this->joined.end(); ++it) {
+    Nan::New(*it)->Resolve(Nan::GetCurrentContext(), obj);
+  }
+}
+
+void ProcessAsyncWorker::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  if (this->fsuipc->pending_process == this) {
+    this->fsuipc->pending_process = nullptr;
+  }
+
+  v8::Local<v8::Value> argv[] = {Nan::New(ErrorMessage()).ToLocalChecked(),
+                                 Nan::New(this->errorCode)};
+  v8::Local<v8::Value> error =
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
+
+  Nan::New(resolver)->Reject(Nan::GetCurrentContext(), error);
+  for (auto it = this->joined.begin(); it != this->joined.end(); ++it) {
+    Nan::New(*it)->Reject(Nan::GetCurrentContext(), error);
+  }
+}
+
+void SerializeAsyncWorker::CycleDone(bool ok, Error result) {
+  if (!ok) {
+    this->SetErrorMessage(ErrorToString(result));
+    this->errorCode = static_cast<int>(result);
+    return;
+  }
+
+  uint64_t start = uv_hrtime();
+
+  {
+    std::lock_guard<std::timed_mutex> guard(this->fsuipc->offsets_mutex);
+
+    Serializer& serializer = this->format == SerializeFormat::Json
+                                 ? this->fsuipc->json_serializer
+                                 : this->fsuipc->msgpack_serializer;
+
+    this->buffer.clear();
+    serializer.Serialize(this->fsuipc->offsets, this->fsuipc->layout_version,
+                         &this->buffer);
+  }
+
+  // Serializing takes the place of creating the result object
+  this->fsuipc->stats.RecordPhase(Phase::Materialize, start,
+                                  uv_hrtime() - start);
+}
+
+void SerializeAsyncWorker::Release() {
+  if (this->buffer.capacity() > this->fsuipc->serialize_buffer.capacity()) {
+    this->buffer.swap(this->fsuipc->serialize_buffer);
+  }
+}
+
+void SerializeAsyncWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::Object> buffer =
+      Nan::CopyBuffer((const char*)this->buffer.data(),
+                      (uint32_t)this->buffer.size())
+          .ToLocalChecked();
+
+  this->Release();
+
+  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), buffer);
 }
 
-void ProcessAsyncWorker::HandleErrorCallback() {
+void SerializeAsyncWorker::HandleErrorCallback() {
   Nan::HandleScope scope;
 
+  this->Release();
+
   v8::Local<v8::Value> argv[] = {Nan::New(ErrorMessage()).ToLocalChecked(),
                                  Nan::New(this->errorCode)};
   v8::Local<v8::Value> error =
-      Nan::CallAsConstructor(Nan::New(FSUIPCError), 2, argv).ToLocalChecked();
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
 
   Nan::New(resolver)->Reject(Nan::GetCurrentContext(), error);
 }
 
-v8::Local<v8::Value> ProcessAsyncWorker::GetValue(Type type,
-                                                  void* data,
-                                                  size_t length) {
+bool IsNumericType(Type type) {
+  return type != Type::ByteArray && type != Type::String &&
+         type != Type::BitArray;
+}
+
+double GetOffsetNumber(Type type, void* data) {
+  switch (type) {
+    case Type::Byte:
+      return *((uint8_t*)data);
+    case Type::SByte:
+      return *((int8_t*)data);
+    case Type::Int16:
+      return *((int16_t*)data);
+    case Type::Int32:
+      return *((int32_t*)data);
+    case Type::Int64:
+      return (double)*((int64_t*)data);
+    case Type::UInt16:
+      return *((uint16_t*)data);
+    case Type::UInt32:
+      return *((uint32_t*)data);
+    case Type::UInt64:
+      return (double)*((uint64_t*)data);
+    case Type::Double:
+      return *((double*)data);
+    case Type::Single:
+      return *((float*)data);
+    default:
+      return 0;
+  }
+}
+
+v8::Local<v8::Value> GetOffsetValue(Type type, void* data, size_t length) {
   Nan::EscapableHandleScope scope;
 
   switch (type) {
@@ -533,8 +3669,11 @@ v8::Local<v8::Value> ProcessAsyncWorker::GetValue(Type type,
     case Type::Single:
       return scope.Escape(Nan::New(*((float*)data)));
     case Type::String: {
+      // Strings that fill the whole field have no NUL, and buffers decoded
+      // from a frame don't have one after the field either
       char* str = (char*)data;
-      return scope.Escape(Nan::New(str).ToLocalChecked());
+      return scope.Escape(
+          Nan::New(str, (int)strnlen(str, length)).ToLocalChecked());
     }
     case Type::BitArray: {
       v8::Local<v8::Array> arr = Nan::New<v8::Array>(length * 8);
@@ -587,7 +3726,24 @@ DWORD get_size_of_type(Type type) {
 void OpenAsyncWorker::Execute() {
   Error result;
 
-  std::lock_guard<std::mutex> fsuipc_guard(this->fsuipc->fsuipc_mutex);
+  if (this->fsuipc->shared) {
+    if (!Multiplexer::Instance().Open(this->fsuipc, this->requestedSim,
+                                      &result)) {
+      this->SetErrorMessage(ErrorToString(result));
+      this->errorCode = static_cast<int>(result);
+    }
+    return;
+  }
+
+  std::lock_guard<std::timed_mutex> fsuipc_guard(*this->fsuipc->fsuipc_mutex);
+
+  if (this->replay) {
+    if (!this->fsuipc->ipc->OpenReplay(this->path, this->speed, &result)) {
+      this->SetErrorMessage(ErrorToString(result));
+      this->errorCode = static_cast<int>(result);
+    }
+    return;
+  }
 
   if (!this->fsuipc->ipc->Open(this->requestedSim, &result)) {
     this->SetErrorMessage(ErrorToString(result));
@@ -608,15 +3764,27 @@ void OpenAsyncWorker::HandleErrorCallback() {
   v8::Local<v8::Value> argv[] = {Nan::New(ErrorMessage()).ToLocalChecked(),
                                  Nan::New(this->errorCode)};
   v8::Local<v8::Value> error =
-      Nan::CallAsConstructor(Nan::New(FSUIPCError), 2, argv).ToLocalChecked();
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
 
   Nan::New(resolver)->Reject(Nan::GetCurrentContext(), error);
 }
 
 void CloseAsyncWorker::Execute() {
-  std::lock_guard<std::mutex> fsuipc_guard(this->fsuipc->fsuipc_mutex);
+  if (this->fsuipc->shared) {
+    Multiplexer::Instance().Close(this->fsuipc);
+    return;
+  }
+
+  std::lock_guard<std::timed_mutex> fsuipc_guard(*this->fsuipc->fsuipc_mutex);
 
   this->fsuipc->ipc->Close();
+
+  // The next connection may well be to another sim
+  Mirror* mirror = this->fsuipc->mirror.load();
+  if (mirror) {
+    mirror->Invalidate();
+  }
 }
 
 void CloseAsyncWorker::HandleOKCallback() {
@@ -625,6 +3793,501 @@ void CloseAsyncWorker::HandleOKCallback() {
   Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), this->fsuipc->handle());
 }
 
+void WriteNowAsyncWorker::Execute() {
+  Error result;
+
+  std::lock_guard<std::timed_mutex> fsuipc_guard(*this->fsuipc->fsuipc_mutex);
+
+  // Another worker may already have sent this write as part of its own flush
+  if (!this->ack->done) {
+    this->fsuipc->FlushPriorityWrites(&result);
+  }
+
+  if (this->ack->result != Error::OK) {
+    this->SetErrorMessage(ErrorToString(this->ack->result));
+    this->errorCode = static_cast<int>(this->ack->result);
+    return;
+  }
+}
+
+void WriteNowAsyncWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("latency").ToLocalChecked(),
+           Nan::New((this->ack->acked - this->ack->queued) / 1e6));
+
+  if (this->ack->verify) {
+    Nan::Set(obj, Nan::New("value").ToLocalChecked(),
+             GetOffsetValue(this->ack->type, this->ack->readback.data(),
+                            this->ack->readback.size()));
+    Nan::Set(obj, Nan::New("mismatch").ToLocalChecked(),
+             Nan::New(this->ack->mismatch));
+  }
+
+  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), obj);
+}
+
+void WriteNowAsyncWorker::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::Value> argv[] = {Nan::New(ErrorMessage()).ToLocalChecked(),
+                                 Nan::New(this->errorCode)};
+  v8::Local<v8::Value> error =
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
+
+  Nan::New(resolver)->Reject(Nan::GetCurrentContext(), error);
+}
+
+void FlushAsyncWorker::Execute() {
+  Error result;
+
+  uint64_t start = uv_hrtime();
+  std::vector<OffsetWrite> offset_writes;
+
+  // Take the queued writes before locking the link, which may be shared with
+  // a Multiplexer that locks offsets_mutex while holding the link
+  {
+    std::lock_guard<std::timed_mutex> guard(this->fsuipc->offsets_mutex);
+    offset_writes.swap(this->fsuipc->offset_writes);
+  }
+
+  std::unique_lock<std::timed_mutex> fsuipc_guard(*this->fsuipc->fsuipc_mutex,
+                                                  std::defer_lock);
+
+  bool ok =
+      fsuipc_guard.try_lock_for(std::chrono::milliseconds(this->timeout));
+  if (!ok) {
+    result = Error::TIMEOUT;
+  }
+
+  ok = ok && this->fsuipc->FlushPriorityWrites(
+                  &result, RemainingMs(start, this->timeout));
+
+  IPCUser* ipc = this->fsuipc->ipc;
+  // Writes before sent went out in a request that succeeded, and queued
+  // ones are in the request being built
+  size_t sent = 0;
+  size_t queued = 0;
+
+  auto complete = [&](size_t end) {
+    uint64_t now = uv_hrtime();
+
+    for (; sent < end; sent++) {
+      this->fsuipc->WriteThrough(offset_writes[sent], now);
+      free(offset_writes[sent].src);
+    }
+  };
+
+  for (; ok && queued < offset_writes.size(); queued++) {
+    const OffsetWrite& write = offset_writes[queued];
+
+    // A full request goes out before the next write, as a cycle splits its
+    // reads. A write that doesn't fit in an empty request fails with SIZE.
+    if (queued > sent && !ipc->Fits(write.size, 0)) {
+      ok = ipc->Process(&result, RemainingMs(start, this->timeout));
+      if (ok) {
+        complete(queued);
+      }
+    }
+
+    if (ok && !ipc->Write(write.offset, write.size, write.src, &result)) {
+      ipc->Discard();
+      ok = false;
+    }
+  }
+
+  if (ok && queued > sent) {
+    ok = ipc->Process(&result, RemainingMs(start, this->timeout));
+    if (ok) {
+      complete(queued);
+    }
+  }
+
+  if (!ok) {
+    // Unsent writes go back ahead of the ones queued since, so the next cycle
+    // or flush sends them in order. The link is released first, as cycles
+    // lock offsets_mutex before it.
+    if (fsuipc_guard.owns_lock()) {
+      fsuipc_guard.unlock();
+    }
+
+    std::lock_guard<std::timed_mutex> guard(this->fsuipc->offsets_mutex);
+    this->fsuipc->offset_writes.insert(this->fsuipc->offset_writes.begin(),
+                                       offset_writes.begin() + sent,
+                                       offset_writes.end());
+
+    this->SetErrorMessage(ErrorToString(result));
+    this->errorCode = static_cast<int>(result);
+    return;
+  }
+}
+
+void FlushAsyncWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), this->fsuipc->handle());
+}
+
+void FlushAsyncWorker::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::Value> argv[] = {Nan::New(ErrorMessage()).ToLocalChecked(),
+                                 Nan::New(this->errorCode)};
+  v8::Local<v8::Value> error =
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
+
+  Nan::New(resolver)->Reject(Nan::GetCurrentContext(), error);
+}
+
+void SampleAsyncWorker::Execute() {
+  this->timing.phases[static_cast<int>(Phase::QueueWait)] =
+      uv_hrtime() - this->timing.start;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(this->fsuipc->offsets_mutex);
+
+    uint64_t row = 0;
+    std::map<std::string, Offset>::iterator it = this->fsuipc->offsets.begin();
+    for (; it != this->fsuipc->offsets.end(); ++it) {
+      row += it->second.size;
+    }
+
+    if (row * this->cycles > kMaxBytes) {
+      this->SetErrorMessage(ErrorToString(Error::SIZE));
+      this->errorCode = static_cast<int>(Error::SIZE);
+      return;
+    }
+
+    for (it = this->fsuipc->offsets.begin(); it != this->fsuipc->offsets.end();
+         ++it) {
+      this->columns.push_back(
+          Column{it->first, it->second.type, it->second.size,
+                 std::vector<BYTE>((size_t)it->second.size * this->cycles)});
+    }
+  }
+
+  this->timestamps.reserve(this->cycles);
+
+  std::chrono::nanoseconds period(
+      this->hz > 0 ? (int64_t)(1e9 / this->hz) : 0);
+  auto next = std::chrono::steady_clock::now();
+
+  Error result;
+
+  for (uint32_t i = 0; i < this->cycles; i++) {
+    if (i > 0) {
+      this->timing = CycleTiming{uv_hrtime()};
+
+      if (this->hz > 0) {
+        next += period;
+        std::this_thread::sleep_until(next);
+      }
+    }
+
+    if (!this->fsuipc->RunCycle(&result, 0, &this->timing)) {
+      this->SetErrorMessage(ErrorToString(result));
+      this->errorCode = static_cast<int>(result);
+      return;
+    }
+
+    std::lock_guard<std::timed_mutex> guard(this->fsuipc->offsets_mutex);
+
+    // Offsets removed during the sample keep their zeroed rows, and offsets
+    // added during the sample are not collected
+    std::vector<Column>::iterator it = this->columns.begin();
+    for (; it != this->columns.end(); ++it) {
+      auto offset = this->fsuipc->offsets.find(it->name);
+      if (offset != this->fsuipc->offsets.end() &&
+          offset->second.size == it->size) {
+        CopyMemory(it->data.data() + (size_t)i * it->size,
+                   offset->second.dest, it->size);
+      }
+    }
+
+    this->timestamps.push_back(this->fsuipc->last_cycle.load() / 1e6);
+  }
+}
+
+// Creates a typed array of T over a new buffer of length elements of
+// element_size bytes, and returns the contents of the buffer
+template <typename T>
+static v8::Local<T> NewTypedArray(size_t length,
+                                  size_t element_size,
+                                  void** contents) {
+  v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(
+      v8::Isolate::GetCurrent(), length * element_size);
+  v8::Local<T> array = T::New(buffer, 0, length);
+
+  Nan::TypedArrayContents<uint8_t> typed(array);
+  *contents = *typed;
+
+  return array;
+}
+
+// Creates the typed array of a numeric column, with the native element type
+static v8::Local<v8::Value> NewNumericColumn(Type type,
+                                             size_t rows,
+                                             void** contents) {
+  switch (type) {
+    case Type::Byte:
+      return NewTypedArray<v8::Uint8Array>(rows, 1, contents);
+    case Type::SByte:
+      return NewTypedArray<v8::Int8Array>(rows, 1, contents);
+    case Type::Int16:
+      return NewTypedArray<v8::Int16Array>(rows, 2, contents);
+    case Type::Int32:
+      return NewTypedArray<v8::Int32Array>(rows, 4, contents);
+    case Type::Int64:
+      return NewTypedArray<v8::BigInt64Array>(rows, 8, contents);
+    case Type::UInt16:
+      return NewTypedArray<v8::Uint16Array>(rows, 2, contents);
+    case Type::UInt32:
+      return NewTypedArray<v8::Uint32Array>(rows, 4, contents);
+    case Type::UInt64:
+      return NewTypedArray<v8::BigUint64Array>(rows, 8, contents);
+    case Type::Double:
+      return NewTypedArray<v8::Float64Array>(rows, 8, contents);
+    case Type::Single:
+    default:
+      return NewTypedArray<v8::Float32Array>(rows, 4, contents);
+  }
+}
+
+void SampleAsyncWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  size_t rows = this->timestamps.size();
+
+  double* timestamps;
+  v8::Local<v8::Float64Array> timestamps_array =
+      NewFloat64Array(rows, &timestamps);
+  std::copy(this->timestamps.begin(), this->timestamps.end(), timestamps);
+
+  v8::Local<v8::Object> columns = Nan::New<v8::Object>();
+
+  std::vector<Column>::iterator it = this->columns.begin();
+  for (; it != this->columns.end(); ++it) {
+    v8::Local<v8::Value> column;
+    void* contents;
+
+    if (it->type == Type::String) {
+      // Arrow-style: the value of row i is values[offsets[i]..offsets[i + 1]]
+      v8::Local<v8::Int32Array> offsets =
+          NewTypedArray<v8::Int32Array>(rows + 1, 4, &contents);
+      int32_t* positions = (int32_t*)contents;
+
+      size_t total = 0;
+      positions[0] = 0;
+      for (size_t row = 0; row < rows; row++) {
+        total += strnlen((const char*)it->data.data() + row * it->size,
+                         it->size);
+        positions[row + 1] = (int32_t)total;
+      }
+
+      v8::Local<v8::Uint8Array> values =
+          NewTypedArray<v8::Uint8Array>(total, 1, &contents);
+      BYTE* dest = (BYTE*)contents;
+      for (size_t row = 0; row < rows; row++) {
+        size_t length = positions[row + 1] - positions[row];
+        CopyMemory(dest, it->data.data() + row * it->size, length);
+        dest += length;
+      }
+
+      v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+      Nan::Set(obj, Nan::New("offsets").ToLocalChecked(), offsets);
+      Nan::Set(obj, Nan::New("values").ToLocalChecked(), values);
+      column = obj;
+    } else if (IsNumericType(it->type)) {
+      column = NewNumericColumn(it->type, rows, &contents);
+      CopyMemory(contents, it->data.data(), rows * it->size);
+    } else {
+      // Byte and bit arrays: fixed-size rows of size bytes
+      column = NewTypedArray<v8::Uint8Array>(rows * it->size, 1, &contents);
+      CopyMemory(contents, it->data.data(), rows * it->size);
+    }
+
+    Nan::Set(columns, Nan::New(it->name).ToLocalChecked(), column);
+  }
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  Nan::Set(obj, Nan::New("timestamps").ToLocalChecked(), timestamps_array);
+  Nan::Set(obj, Nan::New("columns").ToLocalChecked(), columns);
+
+  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), obj);
+}
+
+void SampleAsyncWorker::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::Value> argv[] = {Nan::New(ErrorMessage()).ToLocalChecked(),
+                                 Nan::New(this->errorCode)};
+  v8::Local<v8::Value> error =
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
+
+  Nan::New(resolver)->Reject(Nan::GetCurrentContext(), error);
+}
+
+// Below this many samples in total, offsets are not worth a thread each
+#define PARALLEL_AGGREGATE_SAMPLES 65536
+
+void AggregateAsyncWorker::Execute() {
+  size_t total = 0;
+
+  {
+    std::lock_guard<std::timed_mutex> guard(this->fsuipc->offsets_mutex);
+
+    std::vector<Job>::iterator it = this->jobs.begin();
+    for (; it != this->jobs.end(); ++it) {
+      size_t first;
+      size_t count = it->history->Find(this->from, this->to, &first);
+
+      it->series.timestamps.resize(count);
+      it->series.values.resize(count);
+      it->history->CopyTo(first, count, it->series.timestamps.data(),
+                          it->series.values.data());
+
+      total += count;
+    }
+  }
+
+  size_t threads = std::min<size_t>(std::thread::hardware_concurrency(),
+                                    this->jobs.size());
+
+  if (threads < 2 || total < PARALLEL_AGGREGATE_SAMPLES) {
+    for (size_t i = 0; i < this->jobs.size(); i++) {
+      this->Run(&this->jobs[i]);
+    }
+    return;
+  }
+
+  // Offsets are handed out one at a time, as their sizes can differ a lot
+  std::atomic<size_t> next{0};
+  std::vector<std::thread> pool;
+
+  auto work = [this, &next]() {
+    size_t i;
+    while ((i = next.fetch_add(1)) < this->jobs.size()) {
+      this->Run(&this->jobs[i]);
+    }
+  };
+
+  for (size_t i = 1; i < threads; i++) {
+    pool.emplace_back(work);
+  }
+  work();
+
+  for (auto it = pool.begin(); it != pool.end(); ++it) {
+    it->join();
+  }
+}
+
+void AggregateAsyncWorker::Run(Job* job) {
+  if (this->downsample) {
+    ::FSUIPC::Downsample(job->series, this->method, this->points,
+                         &job->result);
+  } else {
+    ::FSUIPC::Aggregate(job->series, this->window_ms, &job->stats);
+  }
+}
+
+static v8::Local<v8::Float64Array> VectorToFloat64Array(
+    const std::vector<double>& vector) {
+  double* contents;
+  v8::Local<v8::Float64Array> array = NewFloat64Array(vector.size(), &contents);
+
+  std::copy(vector.begin(), vector.end(), contents);
+
+  return array;
+}
+
+void AggregateAsyncWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  std::vector<Job>::iterator it = this->jobs.begin();
+  for (; it != this->jobs.end(); ++it) {
+    v8::Local<v8::Object> result = Nan::New<v8::Object>();
+
+    if (this->downsample) {
+      Nan::Set(result, Nan::New("timestamps").ToLocalChecked(),
+               VectorToFloat64Array(it->result.timestamps));
+      Nan::Set(result, Nan::New("values").ToLocalChecked(),
+               VectorToFloat64Array(it->result.values));
+    } else {
+      Nan::Set(result, Nan::New("start").ToLocalChecked(),
+               VectorToFloat64Array(it->stats.start));
+      Nan::Set(result, Nan::New("count").ToLocalChecked(),
+               VectorToFloat64Array(it->stats.count));
+      Nan::Set(result, Nan::New("min").ToLocalChecked(),
+               VectorToFloat64Array(it->stats.min));
+      Nan::Set(result, Nan::New("max").ToLocalChecked(),
+               VectorToFloat64Array(it->stats.max));
+      Nan::Set(result, Nan::New("mean").ToLocalChecked(),
+               VectorToFloat64Array(it->stats.mean));
+      Nan::Set(result, Nan::New("stddev").ToLocalChecked(),
+               VectorToFloat64Array(it->stats.stddev));
+    }
+
+    Nan::Set(obj, Nan::New(it->name).ToLocalChecked(), result);
+  }
+
+  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), obj);
+}
+
+void SendControlsAsyncWorker::Execute() {
+  Error result;
+
+  std::lock_guard<std::timed_mutex> fsuipc_guard(*this->fsuipc->fsuipc_mutex);
+
+  std::vector<Control>::iterator it = this->controls.begin();
+
+  for (; it != this->controls.end(); ++it) {
+    if (this->fsuipc->ipc->Write(CONTROL_OFFSET, sizeof(Control), &*it,
+                                 &result)) {
+      continue;
+    }
+
+    // Only split into another round-trip when the request area is full
+    if (result != Error::SIZE || !this->fsuipc->ipc->Process(&result) ||
+        !this->fsuipc->ipc->Write(CONTROL_OFFSET, sizeof(Control), &*it,
+                                  &result)) {
+      this->fsuipc->ipc->Discard();
+      this->SetErrorMessage(ErrorToString(result));
+      this->errorCode = static_cast<int>(result);
+      return;
+    }
+  }
+
+  if (!this->controls.empty() && !this->fsuipc->ipc->Process(&result)) {
+    this->SetErrorMessage(ErrorToString(result));
+    this->errorCode = static_cast<int>(result);
+    return;
+  }
+}
+
+void SendControlsAsyncWorker::HandleOKCallback() {
+  Nan::HandleScope scope;
+
+  Nan::New(resolver)->Resolve(Nan::GetCurrentContext(), this->fsuipc->handle());
+}
+
+void SendControlsAsyncWorker::HandleErrorCallback() {
+  Nan::HandleScope scope;
+
+  v8::Local<v8::Value> argv[] = {Nan::New(ErrorMessage()).ToLocalChecked(),
+                                 Nan::New(this->errorCode)};
+  v8::Local<v8::Value> error =
+      Nan::CallAsConstructor(Nan::New(AddonData::Get()->error), 2, argv)
+          .ToLocalChecked();
+
+  Nan::New(resolver)->Reject(Nan::GetCurrentContext(), error);
+}
+
 NAN_MODULE_INIT(InitType) {
   v8::Local<v8::Object> obj = Nan::New<v8::Object>();
   Nan::DefineOwnProperty(obj, Nan::New("Byte").ToLocalChecked(),
@@ -675,7 +4338,7 @@ NAN_MODULE_INIT(InitError) {
                                         ->ToObject(Nan::GetCurrentContext())
                                         .ToLocalChecked();
 
-  FSUIPCError.Reset(errorFunc);
+  AddonData::Get()->error.Reset(errorFunc);
 
   target->Set(Nan::GetCurrentContext(),
               Nan::New("FSUIPCError").ToLocalChecked(), errorFunc);
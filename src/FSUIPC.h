@@ -3,12 +3,24 @@
 
 #include <nan.h>
 
+#include <atomic>
 #include <map>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
 
+#include "AdaptiveRate.h"
+#include "Aggregate.h"
+#include "Connection.h"
+#include "Estimator.h"
+#include "History.h"
 #include "IPCUser.h"
+#include "Mirror.h"
+#include "Multiplexer.h"
+#include "Scheduler.h"
+#include "Serializer.h"
+#include "Stats.h"
 #include "helpers.h"
 
 namespace FSUIPC {
@@ -34,12 +46,55 @@ NAN_MODULE_INIT(InitSimulator);
 
 DWORD get_size_of_type(Type type);
 
+v8::Local<v8::Value> GetOffsetValue(Type type, void* data, size_t length);
+
+// Whether values of type can be converted to a double by GetOffsetNumber
+bool IsNumericType(Type type);
+double GetOffsetNumber(Type type, void* data);
+
+// State that exists once per isolate, so the addon can be loaded from
+// several worker_threads at the same time
+struct AddonData {
+  Nan::Persistent<v8::FunctionTemplate> constructor;
+  Nan::Persistent<v8::FunctionTemplate> snapshot_reader;
+  Nan::Persistent<v8::Object> error;
+
+  ~AddonData() {
+    constructor.Reset();
+    snapshot_reader.Reset();
+    error.Reset();
+  }
+
+  static AddonData* Get(v8::Isolate* isolate = v8::Isolate::GetCurrent());
+};
+
+class Snapshot;
+class Recorder;
+class Publisher;
+class StateFile;
+class ProcessAsyncWorker;
+class SerializeAsyncWorker;
+
 struct Offset {
   std::string name;
   Type type;
   DWORD offset;
   DWORD size;
   void* dest;
+  // Only set while history is enabled for this offset
+  std::shared_ptr<History> history;
+  // Nanoseconds a value from the mirror may be old, 0 to always fetch it
+  uint64_t max_age = 0;
+  // Only set while adaptive polling is enabled
+  std::shared_ptr<AdaptiveRate> adaptive;
+  // Set once FSUIPC rejected reading this offset, after which it is left out
+  // of requests and keeps its last value
+  bool quarantined = false;
+  // uv_hrtime() when the value in dest was fetched from the sim, which is
+  // older than the cycle for values skipped as not due or kept by the mirror
+  uint64_t read_at = 0;
+  // read_at of the last value handed to history and estimation
+  uint64_t recorded_at = 0;
 };
 
 struct OffsetWrite {
@@ -49,46 +104,393 @@ struct OffsetWrite {
   void* src;  // Will be freed on Process()
 };
 
+// Acknowledgement of a priority write, shared between the worker that queued
+// it and whichever worker ends up sending it.
+struct WriteAck {
+  uint64_t queued;  // uv_hrtime() when write was called from JS
+  uint64_t acked;   // uv_hrtime() when FSUIPC acknowledged the request
+  Error result;
+  bool done;
+  // Set for write(..., {verify: true}), which reads the range back right
+  // after the write in the same request
+  bool verify = false;
+  Type type = Type::Byte;
+  std::vector<BYTE> readback;
+  bool mismatch = false;
+};
+
+// Layout of the FS control area at 0x3110: control number followed by its
+// parameter at 0x3114, so a single 8 byte write sends one control
+struct Control {
+  DWORD control;
+  DWORD param;
+};
+
+// Event for the listeners registered with on(), queued on any thread and
+// delivered on the main thread
+struct PendingEvent {
+  std::string name;
+  Error error;
+  Simulator simulator;
+  // Names of the offsets quarantined, for 'error'
+  std::vector<std::string> offsets;
+};
+
+// Where a cycle started, for measuring it once it is done
+struct CycleStart {
+  uint64_t time;
+  LinkCounters counters;
+};
+
+struct PriorityWrite {
+  OffsetWrite write;
+  std::shared_ptr<WriteAck> ack;
+};
+
+// Offset watched by pause-aware polling. The sim is idle while a paused
+// sentinel is non-zero, or while none of the other sentinels change.
+struct Sentinel {
+  DWORD offset;
+  DWORD size;
+  bool paused;
+  // Set once FSUIPC rejected reading it, after which it is left out of
+  // requests and doesn't count towards idleness
+  bool quarantined = false;
+};
+
+// Read of a request FSUIPC rejected, while looking for the bad ones. Reads
+// through the mirror are split back into the offsets that wanted them.
+struct RejectedRead {
+  DWORD offset;
+  DWORD size;
+  void* dest;
+  Offset* value;       // Offset read directly or through the mirror
+  Sentinel* sentinel;  // Or the sentinel read
+};
+
 // https://medium.com/netscape/tutorial-building-native-c-modules-for-node-js-using-nan-part-1-755b07389c7c
 class FSUIPC : public Nan::ObjectWrap {
+  friend class CycleWorker;
   friend class ProcessAsyncWorker;
+  friend class SerializeAsyncWorker;
   friend class OpenAsyncWorker;
   friend class CloseAsyncWorker;
+  friend class WriteNowAsyncWorker;
+  friend class FlushAsyncWorker;
+  friend class SendControlsAsyncWorker;
+  friend class AggregateAsyncWorker;
+  friend class SampleAsyncWorker;
+  friend class Multiplexer;
+  friend class DeltaStream;
 
  public:
   static NAN_MODULE_INIT(Init);
 
   static NAN_METHOD(New);
   static NAN_METHOD(Open);
+  static NAN_METHOD(Connect);
   static NAN_METHOD(Close);
+  static NAN_METHOD(On);
+  static NAN_METHOD(Off);
+  static NAN_METHOD(Seek);
 
   static NAN_METHOD(Process);
+  static NAN_METHOD(ProcessSync);
+  static NAN_METHOD(ProcessSerialized);
+  static NAN_METHOD(Sample);
+  static NAN_METHOD(StartPolling);
+  static NAN_METHOD(StopPolling);
+  static NAN_METHOD(GetPollingStats);
   static NAN_METHOD(Add);
   static NAN_METHOD(Remove);
   static NAN_METHOD(Write);
-
-  static Nan::Persistent<v8::FunctionTemplate> constructor;
-
-  ~FSUIPC() {
-    if (this->ipc) {
-      delete this->ipc;
-    }
-  }
+  static NAN_METHOD(WriteNow);
+  static NAN_METHOD(Flush);
+  static NAN_METHOD(SendControls);
+  static NAN_METHOD(ShareSnapshot);
+  static NAN_METHOD(ShareState);
+  static NAN_METHOD(GetStats);
+  static NAN_METHOD(ResetStats);
+  static NAN_METHOD(StartTrace);
+  static NAN_METHOD(StopTrace);
+  static NAN_METHOD(EnableHistory);
+  static NAN_METHOD(DisableHistory);
+  static NAN_METHOD(GetHistory);
+  static NAN_METHOD(EnableEstimate);
+  static NAN_METHOD(DisableEstimate);
+  static NAN_METHOD(Estimate);
+  static NAN_METHOD(AggregateHistory);
+  static NAN_METHOD(DownsampleHistory);
+  static NAN_METHOD(StartRecording);
+  static NAN_METHOD(StopRecording);
+  static NAN_METHOD(StartPublishing);
+  static NAN_METHOD(StopPublishing);
+  static NAN_METHOD(GetPublishingStats);
+  static NAN_METHOD(EnableAdaptive);
+  static NAN_METHOD(DisableAdaptive);
+  static NAN_METHOD(GetAdaptiveIntervals);
+  static NAN_METHOD(GetQuarantined);
+  static NAN_METHOD(ClearQuarantine);
+
+  ~FSUIPC();
 
  protected:
   std::map<std::string, Offset> offsets;
   std::vector<OffsetWrite> offset_writes;
-  std::mutex offsets_mutex;
-  std::mutex fsuipc_mutex;
+  // Writes of the request being sent, only used during a cycle
+  std::vector<OffsetWrite> sent_writes;
+  std::vector<PriorityWrite> priority_writes;
+  std::timed_mutex offsets_mutex;
+  std::mutex priority_mutex;
+
+  // Owned by this instance, or by the Multiplexer if the link is shared
+  std::timed_mutex* fsuipc_mutex;
   IPCUser* ipc;
+  bool shared;
+
+  // Incremented whenever offsets are added or removed
+  uint64_t layout_version = 0;
+  std::shared_ptr<Snapshot> snapshot;
+  std::shared_ptr<StateFile> state_file;
+  std::shared_ptr<Recorder> recorder;
+  std::shared_ptr<Publisher> publisher;
+
+  // Bounds of the read intervals of adaptive polling in nanoseconds, only
+  // used while adaptive is set. Only accessed with offsets_mutex held.
+  bool adaptive = false;
+  uint64_t adaptive_min_interval = 0;
+  uint64_t adaptive_max_interval = 0;
+
+  // Created by the first add() with maxAgeMs, never for shared instances.
+  // Its contents are only accessed with fsuipc_mutex held.
+  std::atomic<Mirror*> mirror{nullptr};
+
+  Stats stats;
+
+  // process() calls made before this worker starts join its cycle. Only
+  // accessed from the main thread.
+  ProcessAsyncWorker* pending_process = nullptr;
+  // Finished workers, reused by the next process() calls. Only accessed from
+  // the main thread.
+  std::vector<ProcessAsyncWorker*> process_pool;
+  // Only accessed with offsets_mutex held
+  Serializer json_serializer{SerializeFormat::Json};
+  Serializer msgpack_serializer{SerializeFormat::MsgPack};
+  // Output buffer of the last processSerialized(), reused by the next one.
+  // Only accessed from the main thread.
+  std::vector<BYTE> serialize_buffer;
+
+  // uv_hrtime() when the last successful cycle finished
+  std::atomic<uint64_t> last_cycle{0};
+
+  // Native fixed-rate polling started by startPolling(). The scheduler runs
+  // cycles on its own thread and wakes the main thread to deliver results.
+  Scheduler* scheduler = nullptr;
+  Notifier* poll_notifier = nullptr;
+  Nan::Callback poll_callback;
+  Nan::AsyncResource* poll_resource = nullptr;
+  std::atomic<int> poll_error{0};
+
+  // Values of a polling cycle, copied on the scheduler thread so that the
+  // main thread never reads offsets while a cycle may be writing them
+  struct PollBuffer {
+    struct Field {
+      std::string name;
+      Type type;
+      DWORD size;
+      size_t position;  // Position of the value in data
+    };
+
+    bool has_layout = false;
+    uint64_t layout_version = 0;
+    std::vector<Field> fields;
+    std::vector<BYTE> data;
+  };
+
+  // Filled by the scheduler thread, handed over in poll_ready, and read by
+  // the main thread. Only poll_ready and poll_fresh need poll_mutex.
+  PollBuffer poll_write;
+  PollBuffer poll_ready;
+  PollBuffer poll_read;
+  bool poll_fresh = false;
+  std::mutex poll_mutex;
+
+  // Estimators of the offsets with estimation enabled, by name. They have
+  // their own mutex, so that estimate() never waits for a cycle.
+  std::mutex estimators_mutex;
+  std::map<std::string, std::unique_ptr<Estimator>> estimators;
+
+  // Read along with every cycle of an own link while polling with sentinels.
+  // Only accessed with offsets_mutex held.
+  std::vector<Sentinel> sentinels;
+  std::vector<BYTE> sentinel_values;   // As of the last cycle
+  std::vector<BYTE> sentinel_staging;  // Of the request in flight
+  // Whether sentinel_values holds values read by a cycle yet
+  bool sentinels_seeded = false;
+  // Cycles in a row that found the watched sentinels unchanged
+  int sentinels_unchanged = 0;
+  // Set by cycles that found the sim idle, after which polling only probes
+  // the sentinels until it advances
+  std::atomic<bool> sim_idle{false};
+
+  // Polling that outruns the sim reads the same frame twice, so the sim is
+  // only idle once the sentinels stay unchanged for this many cycles
+  static const int kIdleCycles = 2;
+  // Milliseconds a probe of the sentinels may take, like processSync()
+  static const DWORD kProbeTimeout = 1000;
+
+  // Offsets read directly by the request in flight, for finding the ones
+  // FSUIPC rejects. Only accessed with offsets_mutex held.
+  std::vector<Offset*> queued_offsets;
+
+  // Keeps the link open in the background after connect(), created by the
+  // first call and kept until the instance is destroyed
+  std::atomic<ConnectionManager*> connection{nullptr};
+
+  // Listeners registered with on(). Only accessed from the main thread.
+  std::vector<std::pair<std::string, std::shared_ptr<Nan::Callback>>>
+      listeners;
+  // Created by the first on() or connect(), only keeps the event loop alive
+  // while connect() is managing the link
+  Notifier* event_notifier = nullptr;
+  std::mutex events_mutex;
+  std::vector<PendingEvent> pending_events;
+
+  // Workers of a shared instance whose cycle another thread finished, to be
+  // completed on the main thread. The notifier only keeps the event loop
+  // alive while deferred_count workers are waiting for their cycle.
+  Notifier* deferred_notifier = nullptr;
+  std::mutex deferred_mutex;
+  std::vector<PromiseWorker*> deferred_workers;
+  int deferred_count = 0;  // Only accessed from the main thread
+
+  // Hands a worker to the main thread to be completed, from any thread
+  void FinishDeferred(PromiseWorker* worker);
+  void DeliverDeferred();
+
+  // Queues an event for the listeners, from any thread
+  void Emit(PendingEvent event);
+  void DeliverEvents();
+  void CreateEventNotifier();
+  void StopConnection();
+
+  // Copies the values of the last polling cycle for DeliverPoll()
+  void CopyPoll();
+  // Calls the polling callback with the result of the last cycle
+  void DeliverPoll();
+  void StopScheduler();
+
+  // Queues reads of all sentinels into sentinel_staging, and sets queued if
+  // any of them isn't quarantined. Must be called with offsets_mutex and
+  // fsuipc_mutex held.
+  bool QueueSentinels(Error* result, bool* queued);
+  // Whether sentinel_staging shows the sim idle, compared with the values of
+  // the last cycle. Must be called with offsets_mutex held.
+  bool SentinelsIdle();
+  // Reads only the sentinels, and sets advanced if they show the sim moving
+  // again or writes are waiting to go out
+  bool ProbeSentinels(Error* result, DWORD timeout, bool* advanced);
+
+  // Finds the offsets and sentinels that FSUIPC rejects among the reads of
+  // the request in flight, direct, through the mirror ranges or of
+  // sentinels, by reading halves of them in separate requests, and
+  // quarantines them. All other reads are current afterwards. Returns false
+  // if none were found or the link failed, with result set. Must be called
+  // with offsets_mutex and fsuipc_mutex held.
+  bool QuarantineRejected(Error* result,
+                          const std::vector<Mirror::Range>* ranges,
+                          uint64_t start,
+                          DWORD timeout);
+  // Appends the rejected reads among count reads from first to rejected.
+  // failed is set if a request of exactly these reads already failed.
+  bool BisectRejected(const RejectedRead* first,
+                      size_t count,
+                      bool failed,
+                      int* budget,
+                      std::vector<const RejectedRead*>* rejected,
+                      Error* result,
+                      uint64_t start,
+                      DWORD timeout);
+
+  // Creates the result object of process() from the current values
+  v8::Local<v8::Object> BuildResult();
+  // Same as BuildResult(), with offsets_mutex already held
+  v8::Local<v8::Object> BuildResultLocked();
+
+  // Queues a write to be sent in its own request by a WriteNowAsyncWorker
+  // and returns the promise of the worker
+  v8::Local<v8::Promise> QueuePriorityWrite(const OffsetWrite& write,
+                                            uint64_t queued,
+                                            bool verify);
+
+  // Sends all queued priority writes in their own request. Must be called
+  // with fsuipc_mutex held.
+  bool FlushPriorityWrites(Error* result, DWORD timeout = 0);
+
+  // Updates the mirror with a write the sim acknowledged. Must be called
+  // with fsuipc_mutex held.
+  void WriteThrough(const OffsetWrite& write, uint64_t timestamp);
+
+  // Hands the values of a successful cycle to the snapshot, state file,
+  // history, recorder and publisher. Must be called with offsets_mutex held.
+  void PublishCycle();
+
+  // Appends the values of offsets with history or estimation enabled that
+  // were fetched since they were last recorded, at the time they were
+  // fetched. Must be called with offsets_mutex held.
+  void RecordSamples();
+
+  // Reads all offsets and sends queued writes in one cycle, shared by
+  // process() and processSync(). If timeout is non-zero, gives up with
+  // Error::TIMEOUT after that many milliseconds. The cycle is recorded in
+  // stats, with the queue wait taken from timing.
+  bool RunCycle(Error* result, DWORD timeout, CycleTiming* timing);
+  // The parts of RunCycle() around the request, for cycles of shared
+  // instances that another thread finishes
+  void StartCycle(CycleStart* start, CycleTiming* timing);
+  void FinishCycle(bool ok,
+                   Error result,
+                   const CycleStart& start,
+                   CycleTiming* timing);
+  bool RunOwnCycle(Error* result,
+                   DWORD timeout,
+                   uint64_t start,
+                   CycleTiming* timing);
 };
 
-class ProcessAsyncWorker : public PromiseWorker {
+// Base of the workers that run a single cycle. The cycle of a shared
+// instance that is handed to the thread already sending requests is finished
+// by that thread, so members waiting for the link don't take up threadpool
+// threads.
+class CycleWorker : public PromiseWorker {
  public:
   FSUIPC* fsuipc;
 
-  ProcessAsyncWorker(FSUIPC* fsuipc) : PromiseWorker() {
+  explicit CycleWorker(FSUIPC* fsuipc) : PromiseWorker() {
     this->fsuipc = fsuipc;
+    this->timing = CycleTiming{uv_hrtime()};
+  }
+
+  void Execute();
+  void Deferring();
+
+ protected:
+  // Called with the outcome of the cycle, on the thread that finished it
+  virtual void CycleDone(bool ok, Error result) = 0;
+
+  CycleTiming timing;
+
+ private:
+  static void TicketDone(void* context, Error result);
+
+  CycleStart start;
+  Multiplexer::Ticket ticket;
+};
+
+class ProcessAsyncWorker : public CycleWorker {
+ public:
+  ProcessAsyncWorker(FSUIPC* fsuipc) : CycleWorker(fsuipc) {
+    this->owner.Reset(fsuipc->handle());
   }
 
   void Execute();
@@ -96,9 +498,53 @@ class ProcessAsyncWorker : public PromiseWorker {
   void HandleOKCallback();
   void HandleErrorCallback();
 
-  v8::Local<v8::Value> GetValue(Type type, void* data, size_t length);
+  bool Started() const { return this->started.load(); }
+
+  // Prepares a pooled worker for another cycle
+  void Reset();
+
+  // Returns the worker to its instance's pool instead of deleting it
+  void Destroy();
+
+  // Returns a promise for the result of this worker's cycle
+  v8::Local<v8::Promise> Join();
+
+ protected:
+  void CycleDone(bool ok, Error result);
 
  private:
+  std::atomic<bool> started{false};
+  std::vector<Nan::Global<v8::Promise::Resolver>> joined;
+
+  // Keeps the instance alive while the worker is queued, and is released
+  // in the pool so that pooled workers don't keep it alive forever
+  Nan::Persistent<v8::Object> owner;
+
+  int errorCode;
+};
+
+class SerializeAsyncWorker : public CycleWorker {
+ public:
+  SerializeAsyncWorker(FSUIPC* fsuipc, SerializeFormat format)
+      : CycleWorker(fsuipc) {
+    this->format = format;
+    // Starts out with the capacity of the previous output
+    this->buffer.swap(fsuipc->serialize_buffer);
+  }
+
+  void HandleOKCallback();
+  void HandleErrorCallback();
+
+ protected:
+  void CycleDone(bool ok, Error result);
+
+ private:
+  // Hands the buffer back for the next call
+  void Release();
+
+  SerializeFormat format;
+  std::vector<BYTE> buffer;
+
   int errorCode;
 };
 
@@ -111,6 +557,13 @@ class OpenAsyncWorker : public PromiseWorker {
     this->requestedSim = requestedSim;
   }
 
+  // Opens a recorded capture instead of the sim
+  void Replay(std::string path, double speed) {
+    this->replay = true;
+    this->path = std::move(path);
+    this->speed = speed;
+  }
+
   void Execute();
 
   void HandleOKCallback();
@@ -118,9 +571,167 @@ class OpenAsyncWorker : public PromiseWorker {
 
  private:
   Simulator requestedSim;
+  bool replay = false;
+  std::string path;
+  double speed = 1;
   int errorCode;
 };
 
+class WriteNowAsyncWorker : public PromiseWorker {
+ public:
+  FSUIPC* fsuipc;
+
+  WriteNowAsyncWorker(FSUIPC* fsuipc, std::shared_ptr<WriteAck> ack)
+      : PromiseWorker() {
+    this->fsuipc = fsuipc;
+    this->ack = ack;
+  }
+
+  void Execute();
+
+  void HandleOKCallback();
+  void HandleErrorCallback();
+
+ private:
+  std::shared_ptr<WriteAck> ack;
+  int errorCode;
+};
+
+class FlushAsyncWorker : public PromiseWorker {
+ public:
+  FSUIPC* fsuipc;
+
+  FlushAsyncWorker(FSUIPC* fsuipc, DWORD timeout) : PromiseWorker() {
+    this->fsuipc = fsuipc;
+    this->timeout = timeout;
+  }
+
+  void Execute();
+
+  void HandleOKCallback();
+  void HandleErrorCallback();
+
+ private:
+  DWORD timeout;
+  int errorCode;
+};
+
+class SendControlsAsyncWorker : public PromiseWorker {
+ public:
+  FSUIPC* fsuipc;
+
+  SendControlsAsyncWorker(FSUIPC* fsuipc, std::vector<Control> controls)
+      : PromiseWorker() {
+    this->fsuipc = fsuipc;
+    this->controls = std::move(controls);
+  }
+
+  void Execute();
+
+  void HandleOKCallback();
+  void HandleErrorCallback();
+
+ private:
+  std::vector<Control> controls;
+  int errorCode;
+};
+
+// Runs a number of cycles on the threadpool without returning to JS in
+// between, collecting the values of every offset into one column per offset
+class SampleAsyncWorker : public PromiseWorker {
+ public:
+  // Limits of a single sample(), which preallocates all of its columns
+  static const uint32_t kMaxCycles = 1 << 20;
+  static const uint64_t kMaxBytes = 256ULL << 20;
+  static constexpr double kMinHz = 0.001;
+
+  FSUIPC* fsuipc;
+
+  SampleAsyncWorker(FSUIPC* fsuipc, uint32_t cycles, double hz)
+      : PromiseWorker() {
+    this->fsuipc = fsuipc;
+    this->cycles = cycles;
+    this->hz = hz;
+    this->timing = CycleTiming{uv_hrtime()};
+  }
+
+  void Execute();
+
+  void HandleOKCallback();
+  void HandleErrorCallback();
+
+ private:
+  // Raw values of an offset, one row of size bytes per cycle
+  struct Column {
+    std::string name;
+    Type type;
+    DWORD size;
+    std::vector<BYTE> data;
+  };
+
+  uint32_t cycles;
+  double hz;  // 0 to run cycles back to back
+  CycleTiming timing;
+
+  std::vector<double> timestamps;
+  std::vector<Column> columns;
+  int errorCode;
+};
+
+// Aggregates or downsamples the history of several offsets on the threadpool.
+// The windows are copied out of the history buffers first, so cycles are only
+// blocked for the copy.
+class AggregateAsyncWorker : public PromiseWorker {
+ public:
+  struct Job {
+    std::string name;
+    std::shared_ptr<History> history;
+    Series series;
+    WindowStats stats;  // If aggregating
+    Series result;      // If downsampling
+  };
+
+  FSUIPC* fsuipc;
+
+  AggregateAsyncWorker(FSUIPC* fsuipc,
+                       std::vector<Job> jobs,
+                       uint64_t from,
+                       uint64_t to)
+      : PromiseWorker() {
+    this->fsuipc = fsuipc;
+    this->jobs = std::move(jobs);
+    this->from = from;
+    this->to = to;
+  }
+
+  void Aggregate(double window_ms) {
+    this->downsample = false;
+    this->window_ms = window_ms;
+  }
+
+  void Downsample(DownsampleMethod method, size_t points) {
+    this->downsample = true;
+    this->method = method;
+    this->points = points;
+  }
+
+  void Execute();
+
+  void HandleOKCallback();
+
+ private:
+  void Run(Job* job);
+
+  std::vector<Job> jobs;
+  uint64_t from;
+  uint64_t to;
+
+  bool downsample = false;
+  double window_ms = 0;
+  DownsampleMethod method = DownsampleMethod::LTTB;
+  size_t points = 0;
+};
+
 class CloseAsyncWorker : public PromiseWorker {
  public:
   FSUIPC* fsuipc;
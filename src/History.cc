@@ -0,0 +1,85 @@
+#include "History.h"
+
+namespace FSUIPC {
+
+History::History(size_t max_samples, uint64_t max_age)
+    : max_samples(max_samples), max_age(max_age) {
+  this->samples.resize(max_samples ? max_samples : 64);
+}
+
+void History::Record(uint64_t timestamp, double value) {
+  if (this->max_age) {
+    while (this->size &&
+           timestamp - this->samples[this->head].timestamp > this->max_age) {
+      this->head = (this->head + 1) % this->samples.size();
+      this->size--;
+    }
+  }
+
+  if (this->size == this->samples.size()) {
+    if (!this->max_samples) {
+      this->Grow();
+    } else {
+      // Full, overwrite the oldest sample
+      this->head = (this->head + 1) % this->samples.size();
+      this->size--;
+    }
+  }
+
+  size_t tail = (this->head + this->size) % this->samples.size();
+  this->samples[tail] = HistorySample{timestamp, value};
+  this->size++;
+}
+
+void History::Grow() {
+  std::vector<HistorySample> grown(this->samples.size() * 2);
+
+  for (size_t i = 0; i < this->size; i++) {
+    grown[i] = this->At(i);
+  }
+
+  this->samples.swap(grown);
+  this->head = 0;
+}
+
+size_t History::Find(uint64_t from, uint64_t to, size_t* first) const {
+  // Samples are ordered by timestamp, so both ends can be binary searched
+  size_t lo = 0;
+  size_t hi = this->size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (this->At(mid).timestamp < from) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  size_t begin = lo;
+
+  hi = this->size;
+  while (lo < hi) {
+    size_t mid = lo + (hi - lo) / 2;
+    if (this->At(mid).timestamp <= to) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  *first = begin;
+  return lo - begin;
+}
+
+void History::CopyTo(size_t first,
+                     size_t count,
+                     double* timestamps,
+                     double* values) const {
+  for (size_t i = 0; i < count; i++) {
+    const HistorySample& sample = this->At(first + i);
+    timestamps[i] = sample.timestamp / 1e6;
+    values[i] = sample.value;
+  }
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,51 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace FSUIPC {
+
+struct HistorySample {
+  uint64_t timestamp;  // uv_hrtime() of the cycle that read the value
+  double value;
+};
+
+// Ring buffer of the values of a single offset, ordered by timestamp. Holds
+// at most max_samples samples, and if max_age is non-zero drops samples
+// older than max_age nanoseconds. A buffer limited only by age grows until
+// it covers the window, after which recording no longer allocates.
+class History {
+ public:
+  History(size_t max_samples, uint64_t max_age);
+
+  void Record(uint64_t timestamp, double value);
+
+  // Number of samples with from <= timestamp <= to, starting at *first
+  size_t Find(uint64_t from, uint64_t to, size_t* first) const;
+
+  // Copies count samples starting at first, with timestamps converted to
+  // milliseconds
+  void CopyTo(size_t first, size_t count, double* timestamps, double* values)
+      const;
+
+  size_t Size() const { return this->size; }
+  const HistorySample& At(size_t index) const {
+    return this->samples[(this->head + index) % this->samples.size()];
+  }
+
+ private:
+  void Grow();
+
+  size_t max_samples;  // 0 if only limited by age
+  uint64_t max_age;    // 0 if only limited by samples
+
+  std::vector<HistorySample> samples;
+  size_t head = 0;  // Index of the oldest sample
+  size_t size = 0;
+};
+
+}  // namespace FSUIPC
+
+#endif
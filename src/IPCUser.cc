@@ -1,5 +1,10 @@
 #include "IPCUser.h"
 
+#include <algorithm>
+#include <chrono>
+
+#include "Replay.h"
+
 #define MSGNAME "FsasmLib:IPC"
 
 #define MAX_SIZE \
@@ -34,12 +39,13 @@ typedef struct tagFS6IPC_WRITESTATEDATA_HDR {
 namespace FSUIPC {
 bool IPCUser::Open(Simulator requestedVersion, Error* result) {
   char szName[MAX_PATH];
-  static int nTry = 0;
+  // Links may be opened on several threads at once
+  static std::atomic<int> nTry{0};
   bool isWideFS = false;
   int i = 0;
 
   // abort if already started
-  if (this->viewPointer) {
+  if (this->viewPointer || this->replay) {
     *result = Error::OPEN;
     return false;
   }
@@ -69,8 +75,9 @@ bool IPCUser::Open(Simulator requestedVersion, Error* result) {
   }
 
   // Create the name of our file-mapping object
-  nTry++;  // Ensures a unique string is used in case user closes and reopens
-  wsprintf(szName, MSGNAME, ":%X:%X", GetCurrentProcessId(), nTry);
+  // Ensures a unique string is used in case user closes and reopens
+  int attempt = ++nTry;
+  wsprintf(szName, MSGNAME, ":%X:%X", GetCurrentProcessId(), attempt);
 
   // Stuff the name into a global atom
   this->atom = GlobalAddAtom(szName);
@@ -111,7 +118,7 @@ bool IPCUser::Open(Simulator requestedVersion, Error* result) {
   // Try up to 5 times with a 100ms rest between each
   // Note that WideClient returns zeroes initially, whilst waiting
   // for the server to get the data
-  while (i++ < 5 && (this->Version == 0) || (this->FSVersion == 0)) {
+  while (i++ < 5) {
     // Read FSUIPC Version
     if (!this->Read(0x3304, 4, &this->Version, result)) {
       this->Close();
@@ -138,6 +145,11 @@ bool IPCUser::Open(Simulator requestedVersion, Error* result) {
       return false;
     }
 
+    // FSUIPC itself answers right away
+    if (this->Version != 0 && this->FSVersion != 0) {
+      break;
+    }
+
     // Maybe running on WideClient and need another try
     Sleep(100);
   }
@@ -163,7 +175,68 @@ bool IPCUser::Open(Simulator requestedVersion, Error* result) {
   return true;
 }
 
+bool IPCUser::Probe() {
+  return FindWindowEx(nullptr, nullptr, "UIPCMAIN", nullptr) ||
+         FindWindowEx(nullptr, nullptr, "FS98MAIN", nullptr);
+}
+
+bool IPCUser::Alive() const {
+  if (this->replay) {
+    return true;
+  }
+
+  return this->viewPointer && IsWindow(this->windowHandle);
+}
+
+bool IPCUser::OpenReplay(const std::string& path,
+                         double speed,
+                         Error* result) {
+  if (this->viewPointer || this->replay) {
+    *result = Error::OPEN;
+    return false;
+  }
+
+  Replay* replay = new Replay();
+  if (!replay->Open(path, speed, result)) {
+    delete replay;
+    return false;
+  }
+
+  this->replay = replay;
+  return true;
+}
+
+bool IPCUser::Seek(uint64_t offset, Error* result) {
+  if (!this->replay) {
+    *result = Error::NOTOPEN;
+    return false;
+  }
+
+  this->replay->Seek(offset);
+
+  *result = Error::OK;
+  return true;
+}
+
+void IPCUser::Swap(IPCUser* other) {
+  std::swap(this->Version, other->Version);
+  std::swap(this->FSVersion, other->FSVersion);
+  std::swap(this->windowHandle, other->windowHandle);
+  std::swap(this->msgId, other->msgId);
+  std::swap(this->atom, other->atom);
+  std::swap(this->mapHandle, other->mapHandle);
+  std::swap(this->viewPointer, other->viewPointer);
+  std::swap(this->nextPointer, other->nextPointer);
+  std::swap(this->destinations, other->destinations);
+  std::swap(this->replay, other->replay);
+}
+
 void IPCUser::Close() {
+  if (this->replay) {
+    delete this->replay;
+    this->replay = nullptr;
+  }
+
   this->windowHandle = 0;
   this->msgId = 0;
 
@@ -185,7 +258,7 @@ void IPCUser::Close() {
   this->destinations = std::vector<void*>();
 }
 
-bool IPCUser::Process(Error* result) {
+bool IPCUser::Process(Error* result, DWORD timeout) {
   DWORD_PTR error;
   DWORD* pdw;
 
@@ -193,8 +266,15 @@ bool IPCUser::Process(Error* result) {
   FS6IPC_WRITESTATEDATA_HDR* writeHeader;
   int i = 0;
 
+  if (this->replay) {
+    this->StopEncode(std::chrono::steady_clock::now());
+    this->requests.fetch_add(1, std::memory_order_relaxed);
+    return this->replay->Process(result);
+  }
+
   if (!this->viewPointer) {
     *result = Error::NOTOPEN;
+    this->encoding = false;
     this->destinations.clear();
     return false;
   }
@@ -206,25 +286,69 @@ bool IPCUser::Process(Error* result) {
   }
 
   ZeroMemory(this->nextPointer, 4);  // Terminator
+  this->requests.fetch_add(1, std::memory_order_relaxed);
+  this->bytes.fetch_add(this->nextPointer - this->viewPointer + 4,
+                        std::memory_order_relaxed);
   this->nextPointer = this->viewPointer;
 
-  // Send the request with 9 retries
-
-  while (++i < 10 &&
-         !SendMessageTimeout(
-             this->windowHandle,  // FS6 window handle
-             this->msgId,         // Our registered message id
-             this->atom,          // wParam: name of file-mapping object
-             0,           // lParam: offset of request into file-mapping object
-             SMTO_BLOCK,  // Halt this thread until we get a response
-             2000,        // Time-out interval
-             &error       // Return value
-             )) {
-    Sleep(100);
+  auto sent = std::chrono::steady_clock::now();
+  this->StopEncode(sent);
+
+  // Send the request with 9 retries, giving up early once the timeout (if
+  // any) has passed
+  auto deadline = sent + std::chrono::milliseconds(timeout);
+  auto remaining = [&]() -> DWORD {
+    if (!timeout) {
+      return 2000;
+    }
+    auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    deadline - std::chrono::steady_clock::now())
+                    .count();
+    return left > 0 ? (DWORD)std::min<long long>(left, 2000) : 0;
+  };
+
+  bool sent_ok = false;
+  bool expired = false;
+  int attempts = 0;
+
+  while (++i < 10) {
+    DWORD wait = remaining();
+    if (wait == 0) {
+      expired = true;
+      break;
+    }
+
+    attempts++;
+    if (SendMessageTimeout(
+            this->windowHandle,  // FS6 window handle
+            this->msgId,         // Our registered message id
+            this->atom,          // wParam: name of file-mapping object
+            0,           // lParam: offset of request into file-mapping object
+            SMTO_BLOCK,  // Halt this thread until we get a response
+            wait,        // Time-out interval
+            &error       // Return value
+            )) {
+      sent_ok = true;
+      break;
+    }
+
+    Sleep(std::min<DWORD>(100, remaining()));
+  }
+
+  auto received = std::chrono::steady_clock::now();
+  this->round_trip.fetch_add(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(received - sent)
+          .count(),
+      std::memory_order_relaxed);
+  if (attempts > 1) {
+    this->retries.fetch_add(attempts - 1, std::memory_order_relaxed);
   }
 
-  if (i >= 10) {  // Failed all tries?
-    *result = GetLastError() == 0 ? Error::TIMEOUT : Error::SENDMSG;
+  if (!sent_ok) {  // Failed all tries?
+    *result = expired || GetLastError() == 0 ? Error::TIMEOUT : Error::SENDMSG;
+    if (*result == Error::TIMEOUT) {
+      this->timeouts.fetch_add(1, std::memory_order_relaxed);
+    }
     this->destinations.clear();
     return false;
   }
@@ -269,11 +393,37 @@ bool IPCUser::Process(Error* result) {
 
   this->destinations.clear();
 
+  this->decode.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                             std::chrono::steady_clock::now() - received)
+                             .count(),
+                         std::memory_order_relaxed);
+
   this->nextPointer = this->viewPointer;
   *result = Error::OK;
   return true;
 }
 
+void IPCUser::StopEncode(std::chrono::steady_clock::time_point now) {
+  if (this->encoding) {
+    this->encoding = false;
+    this->encode.fetch_add(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - this->encode_start)
+            .count(),
+        std::memory_order_relaxed);
+  }
+}
+
+void IPCUser::Discard() {
+  if (this->replay) {
+    this->replay->Discard();
+  }
+
+  this->encoding = false;
+  this->nextPointer = this->viewPointer;
+  this->destinations.clear();
+}
+
 bool IPCUser::ReadCommon(bool special,
                          DWORD offset,
                          DWORD size,
@@ -282,6 +432,13 @@ bool IPCUser::ReadCommon(bool special,
   F64IPC_READSTATEDATA_HDR* header =
       (F64IPC_READSTATEDATA_HDR*)this->nextPointer;
 
+  if (this->replay) {
+    this->StartEncode();
+    this->replay->Read(offset, size, dest);
+    *result = Error::OK;
+    return true;
+  }
+
   if (!this->viewPointer) {
     *result = Error::NOTOPEN;
     return false;
@@ -294,6 +451,8 @@ bool IPCUser::ReadCommon(bool special,
     return false;
   }
 
+  this->StartEncode();
+
   header->dwId = F64IPC_READSTATEDATA_ID;
   header->dwOffset = offset;
   header->nBytes = size;
@@ -317,10 +476,28 @@ bool IPCUser::ReadCommon(bool special,
   return true;
 }
 
+bool IPCUser::Fits(DWORD written, DWORD read) const {
+  // Failing requests report why themselves
+  if (this->replay || !this->viewPointer) {
+    return true;
+  }
+
+  // Including the terminator, with the margin Write() keeps
+  return this->nextPointer - this->viewPointer + 4 +
+             sizeof(FS6IPC_WRITESTATEDATA_HDR) + written +
+             sizeof(F64IPC_READSTATEDATA_HDR) + read <=
+         MAX_SIZE;
+}
+
 bool IPCUser::Write(DWORD offset, DWORD size, void* src, Error* result) {
   FS6IPC_WRITESTATEDATA_HDR* header =
       (FS6IPC_WRITESTATEDATA_HDR*)this->nextPointer;
 
+  if (this->replay) {
+    *result = Error::OK;
+    return true;
+  }
+
   // Check link is open
   if (!this->viewPointer) {
     *result = Error::NOTOPEN;
@@ -335,6 +512,8 @@ bool IPCUser::Write(DWORD offset, DWORD size, void* src, Error* result) {
     return false;
   }
 
+  this->StartEncode();
+
   // Initialize header for write request
   header->dwId = FS6IPC_WRITESTATEDATA_ID;
   header->dwOffset = offset;
@@ -3,9 +3,14 @@
 
 #include <windows.h>
 
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <string>
 #include <vector>
 
+#include "Stats.h"
+
 namespace FSUIPC {
 
 enum class Error : int {
@@ -85,14 +90,57 @@ enum class Simulator : int {
   MSFS = 13
 };
 
+class Replay;
+
 class IPCUser {
  public:
   ~IPCUser() { this->Close(); }
 
   bool Open(Simulator requestedVersion, Error* result);
+  // Opens a capture written by the flight recorder instead of the sim. All
+  // writes are accepted and ignored.
+  bool OpenReplay(const std::string& path, double speed, Error* result);
   void Close();
   bool Write(DWORD offset, DWORD size, void* src, Error* result);
-  bool Process(Error* result);
+  // Whether a write of written bytes and a read of read bytes after it both
+  // still fit in the request being built
+  bool Fits(DWORD written, DWORD read) const;
+  // Sends accumulated requests. If timeout is non-zero, gives up with
+  // Error::TIMEOUT once that many milliseconds have passed.
+  bool Process(Error* result, DWORD timeout = 0);
+
+  // Drops any requests accumulated since the last Process()
+  void Discard();
+
+  // Counters are only updated under the link's mutex, but may be read from
+  // any thread
+  LinkCounters GetCounters() const {
+    return LinkCounters{this->requests.load(std::memory_order_relaxed),
+                        this->bytes.load(std::memory_order_relaxed),
+                        this->retries.load(std::memory_order_relaxed),
+                        this->timeouts.load(std::memory_order_relaxed),
+                        this->round_trip.load(std::memory_order_relaxed),
+                        this->decode.load(std::memory_order_relaxed),
+                        this->encode.load(std::memory_order_relaxed)};
+  }
+
+  // Whether the window of FSUIPC or WideClient exists, so Open() may succeed
+  static bool Probe();
+
+  // Whether the link is open and the window it talks to still exists
+  bool Alive() const;
+
+  Simulator GetSimulator() const {
+    return static_cast<Simulator>(this->FSVersion);
+  }
+
+  // Moves replay to offset nanoseconds after the start of the capture
+  bool Seek(uint64_t offset, Error* result);
+
+  // Exchanges the open links of both, so a link can be opened without
+  // holding the mutex of the one in use. Counters stay with each. Neither
+  // may have requests pending.
+  void Swap(IPCUser* other);
 
   bool Read(DWORD offset, DWORD size, void* dest, Error* result) {
     return this->ReadCommon(false, offset, size, dest, result);
@@ -102,20 +150,44 @@ class IPCUser {
   }
 
  protected:
-  DWORD Version;
-  DWORD FSVersion;
+  DWORD Version = 0;
+  DWORD FSVersion = 0;
   DWORD LibVersion = 2002;
 
-  HWND windowHandle;  // FS6 window handle
-  UINT msgId;         // Id of registered window message
-  ATOM atom;          // Atom containing name of file-mapping object
-  HANDLE mapHandle;   // Handle of file-mapping object
-  BYTE* viewPointer;  // Pointer to view of file-mapping object
-  BYTE* nextPointer;
+  HWND windowHandle = 0;        // FS6 window handle
+  UINT msgId = 0;               // Id of registered window message
+  ATOM atom = 0;                // Atom containing name of file-mapping object
+  HANDLE mapHandle = 0;         // Handle of file-mapping object
+  BYTE* viewPointer = nullptr;  // Pointer to view of file-mapping object
+  BYTE* nextPointer = nullptr;
 
   std::vector<void*> destinations;
 
+  // Only set while replaying a capture
+  Replay* replay = nullptr;
+
+  std::atomic<uint64_t> requests{0};
+  std::atomic<uint64_t> bytes{0};
+  std::atomic<uint64_t> retries{0};
+  std::atomic<uint64_t> timeouts{0};
+  std::atomic<uint64_t> round_trip{0};
+  std::atomic<uint64_t> decode{0};
+  std::atomic<uint64_t> encode{0};
+
  private:
+  // Starts timing the request being built, on its first read or write
+  void StartEncode() {
+    if (!this->encoding) {
+      this->encoding = true;
+      this->encode_start = std::chrono::steady_clock::now();
+    }
+  }
+  // Accounts the time spent building the request, up to now
+  void StopEncode(std::chrono::steady_clock::time_point now);
+
+  bool encoding = false;
+  std::chrono::steady_clock::time_point encode_start;
+
   bool ReadCommon(bool special,
                   DWORD offset,
                   DWORD size,
@@ -0,0 +1,79 @@
+#include "Mirror.h"
+
+#include <algorithm>
+
+namespace FSUIPC {
+
+Mirror::Mirror() : data(kSize), fetched(kSize) {}
+
+bool Mirror::Fresh(DWORD offset, DWORD size, uint64_t since) const {
+  const uint64_t* it = this->fetched.data() + offset;
+  const uint64_t* end = it + size;
+
+  for (; it != end; ++it) {
+    if (*it == 0 || *it < since) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+uint64_t Mirror::FetchedAt(DWORD offset, DWORD size) const {
+  const uint64_t* begin = this->fetched.data() + offset;
+  const uint64_t* end = begin + size;
+
+  return begin == end ? 0 : *std::min_element(begin, end);
+}
+
+void Mirror::MarkFetched(DWORD offset, DWORD size, uint64_t timestamp) {
+  std::fill_n(this->fetched.begin() + offset, size, timestamp);
+}
+
+void Mirror::Store(DWORD offset,
+                   DWORD size,
+                   const void* src,
+                   uint64_t timestamp) {
+  CopyMemory(this->At(offset), src, size);
+  this->MarkFetched(offset, size, timestamp);
+}
+
+void Mirror::Invalidate() {
+  std::fill(this->fetched.begin(), this->fetched.end(), 0);
+}
+
+const std::vector<Mirror::Range>& Mirror::Coalesce() {
+  this->merged.clear();
+
+  std::sort(this->wanted.begin(), this->wanted.end(),
+            [](const Range& a, const Range& b) { return a.offset < b.offset; });
+
+  std::vector<Range>::iterator it = this->wanted.begin();
+  for (; it != this->wanted.end(); ++it) {
+    if (!this->merged.empty()) {
+      Range& last = this->merged.back();
+      DWORD last_end = last.offset + last.size;
+
+      if (it->offset <= last_end) {
+        last.size = std::max<DWORD>(last_end, it->offset + it->size) -
+                    last.offset;
+        continue;
+      }
+    }
+
+    this->merged.push_back(*it);
+  }
+
+  this->wanted.clear();
+
+  return this->merged;
+}
+
+void Mirror::MarkCoalesced(uint64_t timestamp) {
+  std::vector<Range>::iterator it = this->merged.begin();
+  for (; it != this->merged.end(); ++it) {
+    this->MarkFetched(it->offset, it->size, timestamp);
+  }
+}
+
+}  // namespace FSUIPC
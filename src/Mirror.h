@@ -0,0 +1,67 @@
+#ifndef MIRROR_H
+#define MIRROR_H
+
+#include <windows.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace FSUIPC {
+
+// Copy of the 64 KB FSUIPC offset space with the time each byte was last
+// fetched, so reads that tolerate some staleness don't have to go to the sim
+// every cycle. Ranges that do have to be fetched are collected with Want()
+// and merged with Coalesce(), so overlapping reads go out only once.
+class Mirror {
+ public:
+  static const DWORD kSize = 0x10000;
+
+  struct Range {
+    DWORD offset;
+    DWORD size;
+  };
+
+  Mirror();
+
+  static bool Covers(DWORD offset, DWORD size) {
+    return (uint64_t)offset + size <= kSize;
+  }
+
+  // Whether every byte of the range was fetched at or after since
+  bool Fresh(DWORD offset, DWORD size, uint64_t since) const;
+
+  // When the oldest byte of the range was fetched, 0 if any never was
+  uint64_t FetchedAt(DWORD offset, DWORD size) const;
+
+  BYTE* At(DWORD offset) { return this->data.data() + offset; }
+
+  void MarkFetched(DWORD offset, DWORD size, uint64_t timestamp);
+
+  // Write-through of a value written to the sim
+  void Store(DWORD offset, DWORD size, const void* src, uint64_t timestamp);
+
+  // Forgets all timestamps, so everything is fetched again
+  void Invalidate();
+
+  void Want(DWORD offset, DWORD size) {
+    this->wanted.push_back(Range{offset, size});
+  }
+
+  // Merges overlapping and adjacent wanted ranges. The result stays valid
+  // until the next call.
+  const std::vector<Range>& Coalesce();
+
+  // Marks the ranges returned by the last Coalesce() as fetched
+  void MarkCoalesced(uint64_t timestamp);
+
+ private:
+  std::vector<BYTE> data;
+  std::vector<uint64_t> fetched;  // uv_hrtime() per byte, 0 if never fetched
+
+  std::vector<Range> wanted;
+  std::vector<Range> merged;
+};
+
+}  // namespace FSUIPC
+
+#endif
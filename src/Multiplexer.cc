@@ -0,0 +1,317 @@
+#include "Multiplexer.h"
+
+#include <algorithm>
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+Multiplexer& Multiplexer::Instance() {
+  static Multiplexer instance;
+  return instance;
+}
+
+bool Multiplexer::Open(FSUIPC* member,
+                       Simulator requestedVersion,
+                       Error* result) {
+  std::lock_guard<std::timed_mutex> guard(this->link_mutex);
+
+  if (this->members.count(member)) {
+    *result = Error::OPEN;
+    return false;
+  }
+
+  if (this->members.empty()) {
+    if (!this->link.Open(requestedVersion, result)) {
+      return false;
+    }
+  } else if (requestedVersion != Simulator::ANY &&
+             requestedVersion != this->link.GetSimulator()) {
+    *result = Error::WRONGFS;
+    return false;
+  }
+
+  this->members.insert(member);
+
+  *result = Error::OK;
+  return true;
+}
+
+void Multiplexer::Close(FSUIPC* member) {
+  std::lock_guard<std::timed_mutex> guard(this->link_mutex);
+
+  if (this->members.erase(member) && this->members.empty()) {
+    this->link.Close();
+  }
+}
+
+bool Multiplexer::Process(FSUIPC* member, Error* result, DWORD timeout) {
+  Ticket ticket{member, timeout ? uv_hrtime() + timeout * 1000000ULL : 0,
+                nullptr, nullptr, Error::OK, false};
+
+  if (!this->Submit(&ticket)) {
+    std::unique_lock<std::mutex> guard(this->pending_mutex);
+
+    while (!ticket.done) {
+      uint64_t now = uv_hrtime();
+
+      if (ticket.deadline && now < ticket.deadline) {
+        this->done_cv.wait_for(guard,
+                               std::chrono::nanoseconds(ticket.deadline - now));
+        continue;
+      }
+
+      if (ticket.deadline) {
+        auto it =
+            std::find(this->pending.begin(), this->pending.end(), &ticket);
+        if (it != this->pending.end()) {
+          this->pending.erase(it);
+
+          *result = Error::TIMEOUT;
+          return false;
+        }
+      }
+
+      // The leader has taken our ticket, and gives up by our deadline
+      this->done_cv.wait(guard);
+    }
+  }
+
+  *result = ticket.result;
+  return ticket.result == Error::OK;
+}
+
+bool Multiplexer::Submit(Ticket* ticket) {
+  {
+    std::lock_guard<std::mutex> guard(this->pending_mutex);
+
+    this->pending.push_back(ticket);
+
+    if (this->leading) {
+      return false;
+    }
+    this->leading = true;
+  }
+
+  this->Lead();
+  return true;
+}
+
+void Multiplexer::Lead() {
+  std::unique_lock<std::mutex> pending_guard(this->pending_mutex);
+
+  while (!this->pending.empty()) {
+    this->batch.swap(this->pending);
+
+    uint64_t deadline = 0;
+    std::vector<Ticket*>::iterator it = this->batch.begin();
+    for (; it != this->batch.end(); ++it) {
+      if ((*it)->deadline && (!deadline || (*it)->deadline < deadline)) {
+        deadline = (*it)->deadline;
+      }
+    }
+
+    pending_guard.unlock();
+
+    std::unique_lock<std::timed_mutex> guard(this->link_mutex,
+                                             std::defer_lock);
+    uint64_t now = uv_hrtime();
+
+    if (!deadline) {
+      guard.lock();
+    } else if (now >= deadline ||
+               !guard.try_lock_for(std::chrono::nanoseconds(deadline - now))) {
+      // Tickets past their deadline give up, the others wait for the next
+      // request
+      now = uv_hrtime();
+      std::vector<Ticket*> waiting;
+
+      for (it = this->batch.begin(); it != this->batch.end(); ++it) {
+        if ((*it)->deadline && (*it)->deadline <= now) {
+          this->Complete(*it, Error::TIMEOUT);
+        } else {
+          waiting.push_back(*it);
+        }
+      }
+
+      this->batch.clear();
+
+      pending_guard.lock();
+      this->pending.insert(this->pending.begin(), waiting.begin(),
+                           waiting.end());
+      continue;
+    }
+
+    Error result = this->RunTick(this->batch, deadline);
+    guard.unlock();
+
+    // The staged results are only touched by the leader, so they can be
+    // copied out without holding up the link
+    if (result == Error::OK) {
+      this->FanOut();
+    }
+
+    for (it = this->batch.begin(); it != this->batch.end(); ++it) {
+      this->Complete(*it, result);
+    }
+
+    this->batch.clear();
+
+    pending_guard.lock();
+  }
+
+  this->leading = false;
+}
+
+void Multiplexer::Complete(Ticket* ticket, Error result) {
+  // A ticket may be gone as soon as it is done, so it is not touched after
+  if (ticket->callback) {
+    ticket->result = result;
+    ticket->callback(ticket->context, result);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(this->pending_mutex);
+    ticket->result = result;
+    ticket->done = true;
+  }
+
+  this->done_cv.notify_all();
+}
+
+// Milliseconds left until deadline, for the timeouts of a tick's requests
+static DWORD RemainingMs(uint64_t deadline) {
+  if (!deadline) {
+    return 0;
+  }
+
+  uint64_t now = uv_hrtime();
+  return now < deadline ? (DWORD)((deadline - now) / 1000000) + 1 : 1;
+}
+
+Error Multiplexer::RunTick(std::vector<Ticket*>& tickets, uint64_t deadline) {
+  Error result;
+
+  std::vector<OffsetWrite> writes;
+
+  this->batch_members.clear();
+  this->read_index.clear();
+  this->reads.clear();
+
+  size_t total = 0;
+
+  std::vector<Ticket*>::iterator ticket_it = tickets.begin();
+  for (; ticket_it != tickets.end(); ++ticket_it) {
+    FSUIPC* member = (*ticket_it)->member;
+
+    if (std::find(this->batch_members.begin(), this->batch_members.end(),
+                  member) == this->batch_members.end()) {
+      this->batch_members.push_back(member);
+    }
+  }
+
+  // Priority writes still go out ahead of the merged request. They are all
+  // flushed before any queued write is taken from its member, so a failure
+  // leaves the queued writes where they were.
+  std::vector<FSUIPC*>::iterator member_it = this->batch_members.begin();
+  for (; member_it != this->batch_members.end(); ++member_it) {
+    if (!(*member_it)->FlushPriorityWrites(&result, RemainingMs(deadline))) {
+      return result;
+    }
+  }
+
+  for (member_it = this->batch_members.begin();
+       member_it != this->batch_members.end(); ++member_it) {
+    FSUIPC* member = *member_it;
+
+    std::lock_guard<std::timed_mutex> guard(member->offsets_mutex);
+
+    std::map<std::string, Offset>::iterator it = member->offsets.begin();
+    for (; it != member->offsets.end(); ++it) {
+      auto key = std::make_pair(it->second.offset, it->second.size);
+
+      if (!this->read_index.count(key)) {
+        this->read_index[key] = this->reads.size();
+        this->reads.push_back(
+            Read{it->second.offset, it->second.size, total});
+        total += it->second.size;
+      }
+    }
+
+    writes.insert(writes.end(), member->offset_writes.begin(),
+                  member->offset_writes.end());
+    member->offset_writes.clear();
+  }
+
+  this->staging.resize(total);
+
+  bool ok = true;
+
+  std::vector<Read>::iterator read_it = this->reads.begin();
+  for (; ok && read_it != this->reads.end(); ++read_it) {
+    BYTE* dest = this->staging.data() + read_it->position;
+
+    if (!this->link.Read(read_it->offset, read_it->size, dest, &result)) {
+      // Only split into another round-trip when the request area is full
+      ok = result == Error::SIZE &&
+           this->link.Process(&result, RemainingMs(deadline)) &&
+           this->link.Read(read_it->offset, read_it->size, dest, &result);
+    }
+  }
+
+  std::vector<OffsetWrite>::iterator write_it = writes.begin();
+  for (; write_it != writes.end(); ++write_it) {
+    if (ok && !this->link.Write(write_it->offset, write_it->size,
+                                write_it->src, &result)) {
+      ok = result == Error::SIZE &&
+           this->link.Process(&result, RemainingMs(deadline)) &&
+           this->link.Write(write_it->offset, write_it->size, write_it->src,
+                            &result);
+    }
+
+    free(write_it->src);
+  }
+
+  if (!ok) {
+    this->link.Discard();
+    return result;
+  }
+
+  if (!this->link.Process(&result, RemainingMs(deadline))) {
+    return result;
+  }
+
+  return Error::OK;
+}
+
+void Multiplexer::FanOut() {
+  uint64_t fetched = uv_hrtime();
+
+  std::vector<FSUIPC*>::iterator member_it = this->batch_members.begin();
+
+  for (; member_it != this->batch_members.end(); ++member_it) {
+    FSUIPC* member = *member_it;
+
+    // Offsets may have been added or removed since the request was built,
+    // so they are matched by range rather than by destination
+    std::lock_guard<std::timed_mutex> guard(member->offsets_mutex);
+
+    std::map<std::string, Offset>::iterator it = member->offsets.begin();
+    for (; it != member->offsets.end(); ++it) {
+      auto index = this->read_index.find(
+          std::make_pair(it->second.offset, it->second.size));
+
+      if (index != this->read_index.end()) {
+        CopyMemory(it->second.dest,
+                   this->staging.data() + this->reads[index->second].position,
+                   it->second.size);
+        it->second.read_at = fetched;
+      }
+    }
+
+    member->PublishCycle();
+  }
+}
+
+}  // namespace FSUIPC
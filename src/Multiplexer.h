@@ -0,0 +1,102 @@
+#ifndef MULTIPLEXER_H
+#define MULTIPLEXER_H
+
+#include <windows.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "IPCUser.h"
+
+namespace FSUIPC {
+
+class FSUIPC;
+
+// Shares a single IPC link between all FSUIPC instances created with
+// {shared: true}. Reads requested by instances while a request is in flight
+// are deduplicated and merged into the next request, and the results are
+// copied back to every instance that asked for them.
+//
+// Requests are sent by whichever thread found the link idle, the leader,
+// which keeps sending merged requests until no member is waiting. Members
+// that arrive while it is busy hand their ticket to it rather than waiting
+// for the link themselves.
+class Multiplexer {
+ public:
+  // Called on the leader once the request of a ticket is done
+  typedef void (*Callback)(void* context, Error result);
+
+  struct Ticket {
+    FSUIPC* member;
+    // uv_hrtime() at which to give up waiting for the link, 0 for never
+    uint64_t deadline;
+    // Only set for tickets passed to Submit()
+    Callback callback;
+    void* context;
+    Error result;
+    bool done;
+  };
+
+  static Multiplexer& Instance();
+
+  bool Open(FSUIPC* member, Simulator requestedVersion, Error* result);
+  void Close(FSUIPC* member);
+  // If timeout is non-zero, gives up with Error::TIMEOUT when the link can't
+  // be acquired in time, unless the request was already merged into another
+  // member's request
+  bool Process(FSUIPC* member, Error* result, DWORD timeout = 0);
+  // Queues the request of a ticket without waiting for the link. Returns
+  // true if the calling thread became the leader and the request is done.
+  // Otherwise the current leader sends it and calls ticket->callback.
+  bool Submit(Ticket* ticket);
+
+  IPCUser* ipc() { return &this->link; }
+  std::timed_mutex* mutex() { return &this->link_mutex; }
+
+ private:
+  // A single merged read, copied to every member that reads this range
+  // after Process()
+  struct Read {
+    DWORD offset;
+    DWORD size;
+    size_t position;  // Position of the data in the staging buffer
+  };
+
+  Multiplexer() {}
+
+  // Sends requests until no ticket is pending. Only called by the leader.
+  void Lead();
+  // Sends one tick for tickets, giving up at deadline (uv_hrtime(), 0 for
+  // never) across all of its requests
+  Error RunTick(std::vector<Ticket*>& tickets, uint64_t deadline);
+  // Copies the staged results to the members of the last tick and publishes
+  // their cycle
+  void FanOut();
+  void Complete(Ticket* ticket, Error result);
+
+  IPCUser link;
+  std::timed_mutex link_mutex;
+  std::set<FSUIPC*> members;  // Members that have opened the link
+
+  std::mutex pending_mutex;
+  std::condition_variable done_cv;  // Notified when tickets are done
+  std::vector<Ticket*> pending;
+  bool leading = false;
+
+  // Only accessed by the leader, and reused between ticks to avoid
+  // reallocating for every request
+  std::vector<Ticket*> batch;
+  std::vector<FSUIPC*> batch_members;
+  std::map<std::pair<DWORD, DWORD>, size_t> read_index;
+  std::vector<Read> reads;
+  std::vector<BYTE> staging;
+};
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,313 @@
+#include "Publisher.h"
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+// Size of the pipe's outbound buffer, which a subscriber that isn't reading
+// fills before writes to it start to wait
+static const DWORD kPipeBufferSize = 65536;
+
+Publisher::~Publisher() {
+  this->Stop();
+}
+
+bool Publisher::Start(const std::string& name,
+                      size_t queue_size,
+                      std::string* error) {
+  this->path = "\\\\.\\pipe\\" + name;
+  this->queue_size = queue_size;
+
+  // Fails if another publisher already uses the name
+  HANDLE pipe = this->CreatePipe(FILE_FLAG_FIRST_PIPE_INSTANCE);
+  if (pipe == INVALID_HANDLE_VALUE) {
+    *error = "Could not create pipe " + this->path;
+    return false;
+  }
+
+  this->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+  if (!this->stop_event) {
+    CloseHandle(pipe);
+    *error = "Could not create event";
+    return false;
+  }
+
+  this->running = true;
+  this->accept_thread = std::thread(&Publisher::Accept, this, pipe);
+
+  return true;
+}
+
+void Publisher::Stop() {
+  if (!this->running.exchange(false)) {
+    return;
+  }
+
+  SetEvent(this->stop_event);
+  this->accept_thread.join();
+
+  std::lock_guard<std::mutex> guard(this->connections_mutex);
+
+  for (auto it = this->connections.begin(); it != this->connections.end();
+       ++it) {
+    Connection* connection = it->get();
+
+    {
+      // Taken so the wakeup can't be missed between the check of running
+      // and the wait
+      std::lock_guard<std::mutex> connection_guard(connection->mutex);
+    }
+    connection->wake.notify_one();
+    connection->thread.join();
+
+    DisconnectNamedPipe(connection->pipe);
+    CloseHandle(connection->pipe);
+  }
+
+  this->connections.clear();
+
+  CloseHandle(this->stop_event);
+  this->stop_event = NULL;
+}
+
+HANDLE Publisher::CreatePipe(DWORD flags) {
+  return CreateNamedPipe(this->path.c_str(),
+                         PIPE_ACCESS_OUTBOUND | FILE_FLAG_OVERLAPPED | flags,
+                         PIPE_TYPE_MESSAGE | PIPE_WAIT,
+                         PIPE_UNLIMITED_INSTANCES, kPipeBufferSize, 0, 0,
+                         NULL);
+}
+
+void Publisher::Accept(HANDLE pipe) {
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+  if (!overlapped.hEvent) {
+    this->Fail("Could not create event");
+  }
+
+  // Every pipe instance serves one subscriber, so a new instance is created
+  // for the next one as soon as one connects
+  while (overlapped.hEvent && pipe != INVALID_HANDLE_VALUE) {
+    ResetEvent(overlapped.hEvent);
+
+    bool connected = ConnectNamedPipe(pipe, &overlapped) != FALSE;
+    DWORD error = connected ? 0 : GetLastError();
+
+    if (error == ERROR_PIPE_CONNECTED) {
+      // Connected between creating the pipe and ConnectNamedPipe
+      connected = true;
+    } else if (error == ERROR_IO_PENDING) {
+      HANDLE handles[] = {overlapped.hEvent, this->stop_event};
+      DWORD transferred;
+
+      if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) ==
+          WAIT_OBJECT_0) {
+        connected =
+            GetOverlappedResult(pipe, &overlapped, &transferred, FALSE) !=
+            FALSE;
+      } else {
+        CancelIo(pipe);
+        GetOverlappedResult(pipe, &overlapped, &transferred, TRUE);
+        break;
+      }
+    } else if (!connected) {
+      this->Fail("Could not accept subscribers on " + this->path +
+                 " (error " + std::to_string(error) + ")");
+      break;
+    }
+
+    if (connected) {
+      std::unique_ptr<Connection> connection(new Connection());
+      connection->pipe = pipe;
+
+      std::lock_guard<std::mutex> guard(this->connections_mutex);
+      connection->thread =
+          std::thread(&Publisher::Send, this, connection.get());
+      this->connections.push_back(std::move(connection));
+    } else {
+      // Subscriber went away before the connection completed
+      CloseHandle(pipe);
+    }
+
+    pipe = this->CreatePipe();
+
+    if (pipe == INVALID_HANDLE_VALUE) {
+      this->Fail("Could not create another instance of " + this->path +
+                 " (error " + std::to_string(GetLastError()) + ")");
+    }
+  }
+
+  if (pipe != INVALID_HANDLE_VALUE) {
+    CloseHandle(pipe);
+  }
+
+  if (overlapped.hEvent) {
+    CloseHandle(overlapped.hEvent);
+  }
+}
+
+void Publisher::Send(Connection* connection) {
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+  std::vector<BYTE> header;
+  CaptureEncoder::EncodeHeader(&header);
+
+  bool ok = overlapped.hEvent &&
+            this->Write(connection->pipe, header, &overlapped);
+
+  std::shared_ptr<const std::vector<BYTE>> sent_layout;
+
+  while (ok) {
+    std::shared_ptr<const Message> message;
+
+    {
+      std::unique_lock<std::mutex> guard(connection->mutex);
+      connection->wake.wait(guard, [&]() {
+        return !connection->queue.empty() || !this->running;
+      });
+
+      if (!this->running) {
+        break;
+      }
+
+      message = std::move(connection->queue.front());
+      connection->queue.pop_front();
+    }
+
+    // Every message refers to its layout, so a layout is never lost with a
+    // dropped frame
+    if (message->layout != sent_layout) {
+      ok = this->Write(connection->pipe, *message->layout, &overlapped);
+      sent_layout = message->layout;
+    }
+
+    ok = ok && this->Write(connection->pipe, message->frame, &overlapped);
+  }
+
+  if (overlapped.hEvent) {
+    CloseHandle(overlapped.hEvent);
+  }
+
+  connection->done = true;
+}
+
+bool Publisher::Write(HANDLE pipe,
+                      const std::vector<BYTE>& data,
+                      OVERLAPPED* overlapped) {
+  DWORD written;
+
+  if (!WriteFile(pipe, data.data(), (DWORD)data.size(), NULL, overlapped)) {
+    if (GetLastError() != ERROR_IO_PENDING) {
+      return false;
+    }
+
+    HANDLE handles[] = {overlapped->hEvent, this->stop_event};
+    if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) !=
+        WAIT_OBJECT_0) {
+      CancelIo(pipe);
+      GetOverlappedResult(pipe, overlapped, &written, TRUE);
+      return false;
+    }
+  }
+
+  return GetOverlappedResult(pipe, overlapped, &written, FALSE) &&
+         written == data.size();
+}
+
+void Publisher::Publish(uint64_t timestamp,
+                        const std::map<std::string, Offset>& offsets,
+                        uint64_t layout_version) {
+  {
+    std::lock_guard<std::mutex> guard(this->connections_mutex);
+
+    // Subscribers that disconnected have already stopped their thread
+    auto it = this->connections.begin();
+    while (it != this->connections.end()) {
+      if ((*it)->done) {
+        (*it)->thread.join();
+        DisconnectNamedPipe((*it)->pipe);
+        CloseHandle((*it)->pipe);
+        it = this->connections.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    // Nothing is serialized while nobody listens
+    if (this->connections.empty()) {
+      return;
+    }
+  }
+
+  std::map<std::string, Offset>::const_iterator it;
+
+  if (!this->has_layout || this->layout_version != layout_version) {
+    std::vector<CaptureField> fields;
+    for (it = offsets.begin(); it != offsets.end(); ++it) {
+      fields.push_back(CaptureField{it->second.name, it->second.type,
+                                    it->second.offset, it->second.size});
+    }
+
+    std::shared_ptr<std::vector<BYTE>> layout =
+        std::make_shared<std::vector<BYTE>>();
+    CaptureEncoder::EncodeLayout(layout_version, fields, layout.get());
+
+    this->layout = layout;
+    this->layout_version = layout_version;
+    this->has_layout = true;
+  }
+
+  this->values.clear();
+  for (it = offsets.begin(); it != offsets.end(); ++it) {
+    const BYTE* dest = (const BYTE*)it->second.dest;
+    this->values.insert(this->values.end(), dest, dest + it->second.size);
+  }
+
+  // Serialized once, and shared by every subscriber's queue
+  std::shared_ptr<Message> message = std::make_shared<Message>();
+  message->layout = this->layout;
+  CaptureEncoder::EncodeKeyFrame(this->sequence++, timestamp, this->values,
+                                 &message->frame);
+
+  std::lock_guard<std::mutex> guard(this->connections_mutex);
+
+  for (auto connection = this->connections.begin();
+       connection != this->connections.end(); ++connection) {
+    {
+      std::lock_guard<std::mutex> connection_guard((*connection)->mutex);
+
+      if ((*connection)->queue.size() >= this->queue_size) {
+        (*connection)->queue.pop_front();
+        this->dropped++;
+      }
+
+      (*connection)->queue.push_back(message);
+    }
+
+    (*connection)->wake.notify_one();
+  }
+
+  this->frames++;
+}
+
+void Publisher::Fail(const std::string& message) {
+  std::lock_guard<std::mutex> guard(this->connections_mutex);
+  this->error = message;
+}
+
+PublisherStats Publisher::GetStats() {
+  std::lock_guard<std::mutex> guard(this->connections_mutex);
+
+  uint64_t subscribers = 0;
+  for (auto it = this->connections.begin(); it != this->connections.end();
+       ++it) {
+    subscribers += (*it)->done ? 0 : 1;
+  }
+
+  return PublisherStats{subscribers, this->frames, this->dropped,
+                        this->error};
+}
+
+}  // namespace FSUIPC
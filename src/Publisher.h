@@ -0,0 +1,104 @@
+#ifndef PUBLISHER_H
+#define PUBLISHER_H
+
+#include <windows.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Capture.h"
+
+namespace FSUIPC {
+
+struct Offset;
+
+struct PublisherStats {
+  uint64_t subscribers;  // Currently connected
+  uint64_t frames;       // Cycles published
+  uint64_t dropped;      // Frames dropped for slow subscribers
+  std::string error;     // Why new subscribers are no longer accepted
+};
+
+// Broadcasts every cycle to the Subscribers connected to a named pipe, so
+// several processes can share the values of a single link.
+//
+// Subscribers receive a capture stream of layout and key frame records, one
+// pipe message per record. Each cycle is serialized once and the buffers are
+// shared by all subscribers. Every subscriber has its own writer thread and a
+// bounded queue: when a subscriber falls behind, its oldest frames are
+// dropped, so it always catches up to the latest values.
+class Publisher {
+ public:
+  ~Publisher();
+
+  bool Start(const std::string& name, size_t queue_size, std::string* error);
+  void Stop();
+
+  // Queues the current values of offsets for every subscriber. Must be called
+  // with offsets_mutex held. Never waits for a subscriber.
+  void Publish(uint64_t timestamp,
+               const std::map<std::string, Offset>& offsets,
+               uint64_t layout_version);
+
+  PublisherStats GetStats();
+
+ private:
+  struct Message {
+    // Shared by every message until the layout changes
+    std::shared_ptr<const std::vector<BYTE>> layout;
+    std::vector<BYTE> frame;
+  };
+
+  struct Connection {
+    HANDLE pipe;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<const Message>> queue;
+
+    // Set by the writer thread once the subscriber is gone
+    std::atomic<bool> done{false};
+  };
+
+  HANDLE CreatePipe(DWORD flags = 0);
+  void Accept(HANDLE pipe);
+  // Records why the accept thread stopped before Stop()
+  void Fail(const std::string& message);
+  void Send(Connection* connection);
+  bool Write(HANDLE pipe,
+             const std::vector<BYTE>& data,
+             OVERLAPPED* overlapped);
+
+  std::string path;
+  size_t queue_size = 0;
+
+  HANDLE stop_event = NULL;  // Interrupts waits for connections and writes
+  std::atomic<bool> running{false};
+  std::thread accept_thread;
+
+  std::mutex connections_mutex;
+  std::vector<std::unique_ptr<Connection>> connections;
+  std::string error;
+
+  // Publisher-only state
+  bool has_layout = false;
+  uint64_t layout_version = 0;
+  std::shared_ptr<const std::vector<BYTE>> layout;
+  uint64_t sequence = 0;
+  std::vector<BYTE> values;  // Reused between cycles
+
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> dropped{0};
+};
+
+}  // namespace FSUIPC
+
+#endif
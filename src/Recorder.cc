@@ -0,0 +1,213 @@
+#include "Recorder.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+Recorder::~Recorder() {
+  this->Stop();
+}
+
+bool Recorder::Start(const std::string& path, std::string* error) {
+  this->file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                          FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+                          FILE_ATTRIBUTE_NORMAL, NULL);
+
+  if (this->file == INVALID_HANDLE_VALUE) {
+    *error = "Could not create " + path;
+    return false;
+  }
+
+  if (!this->MapChunk(0)) {
+    CloseHandle(this->file);
+    this->file = INVALID_HANDLE_VALUE;
+    *error = "Could not map " + path;
+    return false;
+  }
+
+  CaptureEncoder::EncodeHeader(&this->scratch);
+  this->Append(this->scratch.data(), this->scratch.size());
+
+  this->running = true;
+  this->thread = std::thread(&Recorder::Run, this);
+
+  return true;
+}
+
+void Recorder::Stop() {
+  if (!this->running.exchange(false)) {
+    return;
+  }
+
+  this->wake.notify_one();
+  this->thread.join();
+
+  if (this->view) {
+    UnmapViewOfFile(this->view);
+    this->view = nullptr;
+  }
+
+  // The last chunk is mapped in full, so cut the file back to what was
+  // actually written
+  LARGE_INTEGER size;
+  size.QuadPart = this->written;
+  SetFilePointerEx(this->file, size, NULL, FILE_BEGIN);
+  SetEndOfFile(this->file);
+
+  CloseHandle(this->file);
+  this->file = INVALID_HANDLE_VALUE;
+}
+
+void Recorder::Capture(uint64_t timestamp,
+                       const std::map<std::string, Offset>& offsets,
+                       uint64_t layout_version) {
+  uint64_t sequence = this->sequence++;
+
+  size_t head = this->head.load(std::memory_order_relaxed);
+  if (head - this->tail.load(std::memory_order_acquire) >= kSlots) {
+    this->dropped++;
+    return;
+  }
+
+  CaptureFrame& frame = this->slots[head % kSlots];
+
+  frame.sequence = sequence;
+  frame.timestamp = timestamp;
+  frame.has_layout =
+      !this->layout_queued || this->layout_version != layout_version;
+  frame.layout_version = layout_version;
+
+  size_t total = 0;
+  std::map<std::string, Offset>::const_iterator it = offsets.begin();
+
+  if (frame.has_layout) {
+    frame.layout.clear();
+    for (; it != offsets.end(); ++it) {
+      frame.layout.push_back(CaptureField{it->second.name, it->second.type,
+                                          it->second.offset,
+                                          it->second.size});
+    }
+  }
+
+  for (it = offsets.begin(); it != offsets.end(); ++it) {
+    total += it->second.size;
+  }
+
+  frame.data.resize(total);
+
+  BYTE* dest = frame.data.data();
+  for (it = offsets.begin(); it != offsets.end(); ++it) {
+    CopyMemory(dest, it->second.dest, it->second.size);
+    dest += it->second.size;
+  }
+
+  this->head.store(head + 1, std::memory_order_release);
+
+  // Only once the layout is queued, so a dropped frame doesn't lose it
+  this->layout_queued = true;
+  this->layout_version = layout_version;
+
+  this->wake.notify_one();
+}
+
+void Recorder::Run() {
+  while (true) {
+    size_t tail = this->tail.load(std::memory_order_relaxed);
+
+    if (tail == this->head.load(std::memory_order_acquire)) {
+      if (!this->running) {
+        break;
+      }
+
+      // Capture() doesn't take the mutex, so a wakeup can be missed and the
+      // frame is only picked up after the timeout
+      std::unique_lock<std::mutex> guard(this->wake_mutex);
+      this->wake.wait_for(guard, std::chrono::milliseconds(10));
+      continue;
+    }
+
+    CaptureFrame& frame = this->slots[tail % kSlots];
+
+    this->scratch.clear();
+    this->encoder.Encode(frame, &this->scratch);
+
+    if (this->Append(this->scratch.data(), this->scratch.size())) {
+      this->frames++;
+    }
+
+    this->tail.store(tail + 1, std::memory_order_release);
+  }
+}
+
+bool Recorder::Append(const BYTE* data, size_t size) {
+  while (size) {
+    if (!this->view) {
+      return false;
+    }
+
+    size_t position = (size_t)(this->written - this->chunk * kChunkSize);
+
+    if (position == kChunkSize) {
+      if (!this->MapChunk(this->chunk + 1)) {
+        this->Fail("Could not extend capture file");
+        return false;
+      }
+      position = 0;
+    }
+
+    size_t count = std::min<size_t>(size, kChunkSize - position);
+    CopyMemory(this->view + position, data, count);
+
+    data += count;
+    size -= count;
+    this->written += count;
+  }
+
+  this->bytes = this->written;
+  return true;
+}
+
+bool Recorder::MapChunk(uint64_t index) {
+  if (this->view) {
+    UnmapViewOfFile(this->view);
+    this->view = nullptr;
+  }
+
+  // Mapping past the end of the file extends it
+  uint64_t end = (index + 1) * kChunkSize;
+  HANDLE mapping = CreateFileMapping(this->file, NULL, PAGE_READWRITE,
+                                     (DWORD)(end >> 32), (DWORD)end, NULL);
+  if (!mapping) {
+    return false;
+  }
+
+  uint64_t start = index * kChunkSize;
+  this->view = (BYTE*)MapViewOfFile(mapping, FILE_MAP_WRITE,
+                                    (DWORD)(start >> 32), (DWORD)start,
+                                    kChunkSize);
+
+  // The view keeps the mapping alive
+  CloseHandle(mapping);
+
+  if (!this->view) {
+    return false;
+  }
+
+  this->chunk = index;
+  return true;
+}
+
+void Recorder::Fail(const char* message) {
+  std::lock_guard<std::mutex> guard(this->error_mutex);
+  this->error = message;
+}
+
+RecorderStats Recorder::GetStats() {
+  std::lock_guard<std::mutex> guard(this->error_mutex);
+  return RecorderStats{this->frames, this->dropped, this->bytes, this->error};
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,90 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <windows.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Capture.h"
+
+namespace FSUIPC {
+
+struct Offset;
+
+struct RecorderStats {
+  uint64_t frames;   // Frames written to the file
+  uint64_t dropped;  // Frames dropped because the writer fell behind
+  uint64_t bytes;    // Size of the capture
+  std::string error;
+};
+
+// Flight recorder appending every cycle to a capture file. The polling
+// thread only copies the values into a preallocated queue slot; encoding and
+// writing happen on a background thread that appends to the file through
+// memory-mapped chunks.
+class Recorder {
+ public:
+  ~Recorder();
+
+  bool Start(const std::string& path, std::string* error);
+  void Stop();
+
+  // Queues the current values of offsets. Must be called with offsets_mutex
+  // held. Never waits for the writer: if the queue is full, the frame is
+  // dropped.
+  void Capture(uint64_t timestamp,
+               const std::map<std::string, Offset>& offsets,
+               uint64_t layout_version);
+
+  RecorderStats GetStats();
+
+ private:
+  static const size_t kSlots = 64;
+  // Multiple of the 64 KB allocation granularity of file mappings
+  static const size_t kChunkSize = 4 << 20;
+
+  void Run();
+  bool Append(const BYTE* data, size_t size);
+  bool MapChunk(uint64_t index);
+  void Fail(const char* message);
+
+  // Single-producer, single-consumer queue of frames. Slots keep their
+  // buffers, so capturing doesn't allocate unless the layout grows.
+  CaptureFrame slots[kSlots];
+  std::atomic<size_t> head{0};  // Next slot written by Capture()
+  std::atomic<size_t> tail{0};  // Next slot read by the writer
+
+  // Producer state
+  uint64_t sequence = 0;
+  bool layout_queued = false;
+  uint64_t layout_version = 0;
+
+  std::atomic<bool> running{false};
+  std::mutex wake_mutex;
+  std::condition_variable wake;
+  std::thread thread;
+
+  // Writer state
+  HANDLE file = INVALID_HANDLE_VALUE;
+  BYTE* view = nullptr;
+  uint64_t chunk = 0;
+  uint64_t written = 0;
+  CaptureEncoder encoder;
+  std::vector<BYTE> scratch;
+
+  std::atomic<uint64_t> frames{0};
+  std::atomic<uint64_t> dropped{0};
+  std::atomic<uint64_t> bytes{0};
+  std::mutex error_mutex;
+  std::string error;
+};
+
+}  // namespace FSUIPC
+
+#endif
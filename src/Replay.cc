@@ -0,0 +1,248 @@
+#include "Replay.h"
+
+#include <algorithm>
+
+namespace FSUIPC {
+
+Replay::~Replay() {
+  if (this->data) {
+    UnmapViewOfFile((LPVOID)this->data);
+  }
+
+  if (this->file != INVALID_HANDLE_VALUE) {
+    CloseHandle(this->file);
+  }
+}
+
+bool Replay::Open(const std::string& path, double speed, Error* result) {
+  this->speed = speed;
+
+  this->file = CreateFile(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                          OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if (this->file == INVALID_HANDLE_VALUE) {
+    *result = Error::NOFS;
+    return false;
+  }
+
+  LARGE_INTEGER file_size;
+  if (!GetFileSizeEx(this->file, &file_size) || file_size.QuadPart == 0) {
+    *result = Error::DATA;
+    return false;
+  }
+
+  HANDLE mapping =
+      CreateFileMapping(this->file, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!mapping) {
+    *result = Error::MAP;
+    return false;
+  }
+
+  this->data = (const BYTE*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  this->size = (size_t)file_size.QuadPart;
+
+  // The view keeps the mapping alive
+  CloseHandle(mapping);
+
+  if (!this->data) {
+    *result = Error::VIEW;
+    return false;
+  }
+
+  if (!this->BuildIndex()) {
+    *result = Error::DATA;
+    return false;
+  }
+
+  this->Rewind(this->index.front());
+
+  *result = Error::OK;
+  return true;
+}
+
+bool Replay::BuildIndex() {
+  size_t position;
+  if (!CaptureDecoder::DecodeHeader(this->data, this->size, &position)) {
+    return false;
+  }
+
+  CaptureDecoder decoder;
+  size_t layout_position = 0;
+  bool has_layout = false;
+
+  while (true) {
+    size_t start = position;
+    CaptureDecoder::Record record =
+        decoder.Next(this->data, this->size, &position);
+
+    if (record == CaptureDecoder::Record::Layout) {
+      layout_position = start;
+      has_layout = true;
+    } else if (record == CaptureDecoder::Record::Frame) {
+      if (this->data[start] == 'K' && has_layout) {
+        this->index.push_back(
+            KeyFrame{decoder.Timestamp(), start, layout_position});
+      }
+    } else {
+      // A capture that was not closed cleanly may end in a partial record
+      break;
+    }
+  }
+
+  return !this->index.empty();
+}
+
+void Replay::Rewind(const KeyFrame& key) {
+  this->decoder = CaptureDecoder();
+
+  this->position = key.layout_position;
+  this->decoder.Next(this->data, this->size, &this->position);
+  this->layout_changed = true;
+
+  this->position = key.position;
+  this->has_next = this->Advance();
+}
+
+bool Replay::Advance() {
+  while (true) {
+    switch (this->decoder.Next(this->data, this->size, &this->position)) {
+      case CaptureDecoder::Record::Layout:
+        this->layout_changed = true;
+        break;
+      case CaptureDecoder::Record::Frame:
+        return true;
+      default:
+        return false;
+    }
+  }
+}
+
+void Replay::Adopt() {
+  this->frame = this->decoder.Data();
+  this->frame_timestamp = this->decoder.Timestamp();
+
+  if (this->layout_changed) {
+    this->fields.clear();
+
+    size_t position = 0;
+    const std::vector<CaptureField>& layout = this->decoder.Layout();
+    for (auto it = layout.begin(); it != layout.end(); ++it) {
+      this->fields.push_back(Field{it->offset, it->size, position});
+      position += it->size;
+    }
+
+    std::sort(this->fields.begin(), this->fields.end(),
+              [](const Field& a, const Field& b) {
+                return a.offset < b.offset ||
+                       (a.offset == b.offset && a.size > b.size);
+              });
+
+    this->layout_changed = false;
+  }
+
+  this->has_frame = true;
+}
+
+// Copies the recorded bytes of a range into dest, and zeroes the gaps
+// between recorded fields. Returns false if no recorded field overlaps it.
+bool Replay::Fill(DWORD offset, DWORD size, BYTE* dest) const {
+  uint64_t end = (uint64_t)offset + size;
+  bool found = false;
+
+  ZeroMemory(dest, size);
+
+  // Fields are sorted by offset, but an earlier one may still reach into the
+  // range
+  std::vector<Field>::const_iterator it = this->fields.begin();
+  for (; it != this->fields.end() && it->offset < end; ++it) {
+    uint64_t field_end = (uint64_t)it->offset + it->size;
+    if (field_end <= offset) {
+      continue;
+    }
+
+    DWORD from = std::max(offset, it->offset);
+    DWORD to = (DWORD)std::min(end, field_end);
+
+    CopyMemory(dest + (from - offset),
+               this->frame.data() + it->position + (from - it->offset),
+               to - from);
+    found = true;
+  }
+
+  return found || !size;
+}
+
+bool Replay::Process(Error* result) {
+  if (this->reads.empty()) {
+    *result = Error::NODATA;
+    return false;
+  }
+
+  if (!this->has_frame) {
+    // Playback starts with the first request
+    this->Adopt();
+    this->has_next = this->Advance();
+    this->wall_start = std::chrono::steady_clock::now();
+    this->playback_start = this->frame_timestamp;
+  } else if (this->speed == 0) {
+    if (this->has_next) {
+      this->Adopt();
+      this->has_next = this->Advance();
+    }
+  } else {
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       std::chrono::steady_clock::now() - this->wall_start)
+                       .count();
+    uint64_t target =
+        this->playback_start + (uint64_t)(elapsed * this->speed);
+
+    // Frames that were due since the last request are skipped, and the last
+    // frame is repeated once the capture has ended, like a paused sim
+    while (this->has_next && this->decoder.Timestamp() <= target) {
+      this->Adopt();
+      this->has_next = this->Advance();
+    }
+  }
+
+  std::vector<PendingRead>::iterator it = this->reads.begin();
+  for (; it != this->reads.end(); ++it) {
+    if (!this->Fill(it->offset, it->size, (BYTE*)it->dest)) {
+      // Offset was not recorded
+      *result = Error::DATA;
+      this->reads.clear();
+      return false;
+    }
+  }
+
+  this->reads.clear();
+
+  *result = Error::OK;
+  return true;
+}
+
+void Replay::Seek(uint64_t offset) {
+  uint64_t target = this->index.front().timestamp + offset;
+
+  auto key = std::upper_bound(
+      this->index.begin(), this->index.end(), target,
+      [](uint64_t target, const KeyFrame& key) {
+        return target < key.timestamp;
+      });
+  if (key != this->index.begin()) {
+    --key;
+  }
+
+  this->Rewind(*key);
+
+  // Decode forward from the key frame to the last frame at or before target
+  this->Adopt();
+  this->has_next = this->Advance();
+  while (this->has_next && this->decoder.Timestamp() <= target) {
+    this->Adopt();
+    this->has_next = this->Advance();
+  }
+
+  this->wall_start = std::chrono::steady_clock::now();
+  this->playback_start = this->frame_timestamp;
+}
+
+}  // namespace FSUIPC
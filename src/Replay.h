@@ -0,0 +1,90 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <windows.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Capture.h"
+#include "IPCUser.h"
+
+namespace FSUIPC {
+
+// Serves reads from a capture written by the flight recorder instead of the
+// sim. The capture is memory-mapped and indexed by key frame on open, so
+// seeking only decodes from the nearest key frame.
+//
+// Frames are played back in real time multiplied by speed, or one frame per
+// Process() if speed is 0. Reads are resolved against the recorded layout by
+// offset, so any subset of the recorded offsets can be read, as well as
+// ranges spanning several of them, like the ones coalesced by the mirror.
+class Replay {
+ public:
+  ~Replay();
+
+  bool Open(const std::string& path, double speed, Error* result);
+
+  void Read(DWORD offset, DWORD size, void* dest) {
+    this->reads.push_back(PendingRead{offset, size, dest});
+  }
+  void Discard() { this->reads.clear(); }
+  bool Process(Error* result);
+
+  // Moves playback to offset nanoseconds after the first frame
+  void Seek(uint64_t offset);
+
+ private:
+  struct KeyFrame {
+    uint64_t timestamp;
+    size_t position;         // Position of the key frame record
+    size_t layout_position;  // Position of the layout it uses
+  };
+
+  struct PendingRead {
+    DWORD offset;
+    DWORD size;
+    void* dest;
+  };
+
+  // A recorded field, by offset
+  struct Field {
+    DWORD offset;
+    DWORD size;
+    size_t position;  // Position of the value in the frame
+  };
+
+  bool BuildIndex();
+  void Rewind(const KeyFrame& key);
+  bool Advance();
+  void Adopt();
+  bool Fill(DWORD offset, DWORD size, BYTE* dest) const;
+
+  HANDLE file = INVALID_HANDLE_VALUE;
+  const BYTE* data = nullptr;
+  size_t size = 0;
+
+  std::vector<KeyFrame> index;
+
+  // The decoder is one frame ahead of the frame being served
+  CaptureDecoder decoder;
+  size_t position = 0;
+  bool has_next = false;
+  bool layout_changed = false;
+
+  bool has_frame = false;
+  std::vector<BYTE> frame;
+  std::vector<Field> fields;
+  uint64_t frame_timestamp = 0;
+
+  double speed = 1;
+  std::chrono::steady_clock::time_point wall_start;
+  uint64_t playback_start = 0;
+
+  std::vector<PendingRead> reads;
+};
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,45 @@
+#include "Schedule.h"
+
+#include <algorithm>
+
+namespace FSUIPC {
+
+Schedule::Schedule(uint64_t start,
+                   uint64_t period,
+                   OverrunPolicy policy,
+                   uint64_t max_backoff) {
+  this->period = period;
+  this->policy = policy;
+  this->max_backoff = std::max(period, max_backoff);
+  this->next = start + period;
+  this->interval = period;
+}
+
+uint64_t Schedule::Finish(uint64_t done, bool active) {
+  // Back off while idle, resuming the schedule from here once active
+  this->interval =
+      active ? this->period : std::min(this->interval * 2, this->max_backoff);
+
+  this->next += this->interval;
+
+  // First deadline that has not been counted yet
+  uint64_t first = this->next;
+  if (this->counted >= first) {
+    first += ((this->counted - first) / this->interval + 1) * this->interval;
+  }
+
+  if (done <= first) {
+    return 0;
+  }
+
+  uint64_t missed = (done - first) / this->interval + 1;
+  this->counted = first + (missed - 1) * this->interval;
+
+  if (this->policy == OverrunPolicy::Skip) {
+    this->next = this->counted + this->interval;
+  }
+
+  return missed;
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,44 @@
+#ifndef SCHEDULE_H
+#define SCHEDULE_H
+
+#include <cstdint>
+
+namespace FSUIPC {
+
+enum class OverrunPolicy {
+  Skip,     // Drop deadlines that passed during an overrun
+  CatchUp,  // Run cycles back to back until the schedule is met again
+};
+
+// Deadline bookkeeping of a Scheduler, in nanoseconds on any monotonic clock.
+// Kept apart from the thread and timer so that it can be tested on its own.
+class Schedule {
+ public:
+  Schedule(uint64_t start,
+           uint64_t period,
+           OverrunPolicy policy,
+           uint64_t max_backoff);
+
+  // Deadline of the next tick
+  uint64_t Next() const { return this->next; }
+  // Interval the next tick was planned with
+  uint64_t Interval() const { return this->interval; }
+
+  // Plans the next tick after one that ended at done, and returns the number
+  // of deadlines it missed. A deadline is only counted once, even when
+  // catching up runs several ticks past it.
+  uint64_t Finish(uint64_t done, bool active);
+
+ private:
+  uint64_t period;
+  OverrunPolicy policy;
+  uint64_t max_backoff;
+
+  uint64_t next;
+  uint64_t interval;
+  uint64_t counted = 0;  // Last deadline counted as missed
+};
+
+}  // namespace FSUIPC
+
+#endif
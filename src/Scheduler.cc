@@ -0,0 +1,160 @@
+#include "Scheduler.h"
+
+namespace FSUIPC {
+
+// Nanoseconds on the steady clock, the clock of the Schedule
+static uint64_t Now() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+Scheduler::~Scheduler() {
+  this->Stop();
+}
+
+bool Scheduler::Start(uint64_t period,
+                      OverrunPolicy policy,
+                      uint64_t max_backoff,
+                      std::function<bool()> tick) {
+  this->period = period;
+  this->policy = policy;
+  this->max_backoff = max_backoff;
+  this->tick = std::move(tick);
+
+  // High resolution timers are only available since Windows 10 1803
+  this->timer = CreateWaitableTimerExW(
+      NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+  if (!this->timer) {
+    this->timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+  }
+
+  this->stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+  if (!this->timer || !this->stop_event) {
+    if (this->timer) {
+      CloseHandle(this->timer);
+      this->timer = NULL;
+    }
+    if (this->stop_event) {
+      CloseHandle(this->stop_event);
+      this->stop_event = NULL;
+    }
+    return false;
+  }
+
+  this->since = std::chrono::steady_clock::now();
+  this->running = true;
+  this->thread = std::thread(&Scheduler::Run, this);
+
+  return true;
+}
+
+void Scheduler::Stop() {
+  if (!this->running.exchange(false)) {
+    return;
+  }
+
+  SetEvent(this->stop_event);
+  this->thread.join();
+
+  CloseHandle(this->timer);
+  CloseHandle(this->stop_event);
+  this->timer = NULL;
+  this->stop_event = NULL;
+}
+
+void Scheduler::WaitUntil(uint64_t deadline) {
+  uint64_t now = Now();
+  if (now >= deadline) {
+    return;
+  }
+
+  // Due times are in 100 ns units, negative for a relative time. The
+  // deadline itself stays absolute, so rounding here doesn't accumulate.
+  LARGE_INTEGER due;
+  due.QuadPart = -(LONGLONG)((deadline - now) / 100);
+
+  if (due.QuadPart >= 0) {
+    return;
+  }
+
+  SetWaitableTimer(this->timer, &due, 0, NULL, NULL, FALSE);
+
+  HANDLE handles[] = {this->timer, this->stop_event};
+  WaitForMultipleObjects(2, handles, FALSE, INFINITE);
+}
+
+void Scheduler::Run() {
+  uint64_t previous = Now();
+  Schedule schedule(previous, this->period, this->policy, this->max_backoff);
+
+  while (true) {
+    uint64_t next = schedule.Next();
+    uint64_t interval = schedule.Interval();
+
+    this->WaitUntil(next);
+
+    if (!this->running) {
+      break;
+    }
+
+    uint64_t woke = Now();
+    uint64_t lateness = woke > next ? woke - next : 0;
+
+    // Deviation of the interval since the last wakeup from the one planned
+    uint64_t actual = woke - previous;
+    uint64_t jitter =
+        actual > interval ? actual - interval : interval - actual;
+    previous = woke;
+
+    bool active = this->tick();
+
+    uint64_t missed = schedule.Finish(Now(), active);
+
+    std::lock_guard<std::mutex> guard(this->mutex);
+    if (active) {
+      this->cycles++;
+    } else {
+      this->idle++;
+    }
+    this->overruns += missed ? 1 : 0;
+    this->missed += missed;
+    this->lateness.Record(lateness);
+    this->jitter.Record(jitter);
+  }
+}
+
+SchedulerStats Scheduler::GetStats() {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  SchedulerStats stats;
+  stats.cycles = this->cycles;
+  stats.idle = this->idle;
+  stats.overruns = this->overruns;
+  stats.missed = this->missed;
+  Stats::Summarize(this->lateness, &stats.lateness);
+  Stats::Summarize(this->jitter, &stats.jitter);
+
+  double elapsed = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - this->since)
+                       .count();
+  stats.requested_hz = 1e9 / this->period;
+  stats.effective_hz = elapsed > 0 ? this->cycles / elapsed : 0;
+
+  return stats;
+}
+
+void Scheduler::ResetStats() {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->cycles = 0;
+  this->idle = 0;
+  this->overruns = 0;
+  this->missed = 0;
+  this->lateness.Reset();
+  this->jitter.Reset();
+  this->since = std::chrono::steady_clock::now();
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,75 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <windows.h>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "Schedule.h"
+#include "Stats.h"
+
+namespace FSUIPC {
+
+struct SchedulerStats {
+  uint64_t cycles;
+  uint64_t idle;  // Ticks that found nothing to do
+  uint64_t overruns;  // Cycles that ended after the next deadline
+  uint64_t missed;    // Deadlines that passed while a cycle was running
+  HistogramSummary lateness;  // ns between deadline and wakeup
+  HistogramSummary jitter;    // ns between wakeup interval and period
+  double requested_hz;
+  double effective_hz;  // Cycles per second since start or reset
+};
+
+// Calls tick on its own thread at a fixed rate. Deadlines are absolute, so
+// the time taken by tick and late wakeups don't accumulate into drift. Waits
+// on a high resolution waitable timer where available.
+//
+// A tick returns false if it found nothing to do, such as while the sim is
+// paused. The interval to the next tick then doubles with every idle tick, up
+// to max_backoff nanoseconds, and is back to the period after the next tick
+// that did something.
+class Scheduler {
+ public:
+  ~Scheduler();
+
+  bool Start(uint64_t period,
+             OverrunPolicy policy,
+             uint64_t max_backoff,
+             std::function<bool()> tick);
+  void Stop();
+
+  SchedulerStats GetStats();
+  void ResetStats();
+
+ private:
+  void Run();
+  void WaitUntil(uint64_t deadline);
+
+  uint64_t period;
+  OverrunPolicy policy;
+  uint64_t max_backoff;
+  std::function<bool()> tick;
+
+  HANDLE timer = NULL;
+  HANDLE stop_event = NULL;  // Interrupts a wait on the timer
+  std::atomic<bool> running{false};
+  std::thread thread;
+
+  std::mutex mutex;
+  uint64_t cycles = 0;
+  uint64_t idle = 0;
+  uint64_t overruns = 0;
+  uint64_t missed = 0;
+  Histogram lateness;
+  Histogram jitter;
+  std::chrono::steady_clock::time_point since;
+};
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,50 @@
+#ifndef SEQLOCK_H
+#define SEQLOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+namespace FSUIPC {
+
+// Single-writer sequence lock. The writer never blocks; readers copy the
+// protected data and retry if a write was in progress or happened meanwhile.
+// Only contains a lock-free atomic, so it can also live in shared memory.
+class SeqLock {
+ public:
+  void WriteBegin() {
+    this->seq.store(this->seq.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void WriteEnd() {
+    this->seq.store(this->seq.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_release);
+  }
+
+  uint32_t ReadBegin() const {
+    uint32_t s;
+    while ((s = this->seq.load(std::memory_order_acquire)) & 1) {
+      std::this_thread::yield();
+    }
+    return s;
+  }
+
+  bool ReadRetry(uint32_t s) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return this->seq.load(std::memory_order_relaxed) != s;
+  }
+
+  // Number of completed writes
+  uint32_t Count() const {
+    return this->seq.load(std::memory_order_acquire) / 2;
+  }
+
+ private:
+  std::atomic<uint32_t> seq{0};
+};
+
+}  // namespace FSUIPC
+
+#endif
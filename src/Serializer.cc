@@ -0,0 +1,486 @@
+#include "Serializer.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+static void Append(const char* data, size_t size, std::vector<BYTE>* out) {
+  out->insert(out->end(), (const BYTE*)data, (const BYTE*)data + size);
+}
+
+static void AppendBigEndian(uint64_t value, int size, std::vector<BYTE>* out) {
+  for (int i = size - 1; i >= 0; i--) {
+    out->push_back((BYTE)(value >> (i * 8)));
+  }
+}
+
+// U+FFFD REPLACEMENT CHARACTER
+static const char kReplacement[] = "\xEF\xBF\xBD";
+
+// Scans the non-ASCII code point at the start of str. Returns whether it is
+// well-formed UTF-8 and sets size to its length. Otherwise size is the length
+// of its maximal subpart, which V8 replaces by a single U+FFFD when it creates
+// the JS string of process(). Strings in FSUIPC are mostly ANSI, so this is
+// how their high-bit bytes end up.
+static bool ScanUtf8(const BYTE* str, size_t length, size_t* size) {
+  BYTE c = str[0];
+  BYTE lower = 0x80;
+  BYTE upper = 0xBF;
+
+  if (c >= 0xC2 && c <= 0xDF) {
+    *size = 2;
+  } else if (c >= 0xE0 && c <= 0xEF) {
+    *size = 3;
+    lower = c == 0xE0 ? 0xA0 : 0x80;  // Overlong
+    upper = c == 0xED ? 0x9F : 0xBF;  // Surrogates
+  } else if (c >= 0xF0 && c <= 0xF4) {
+    *size = 4;
+    lower = c == 0xF0 ? 0x90 : 0x80;  // Overlong
+    upper = c == 0xF4 ? 0x8F : 0xBF;  // Beyond U+10FFFF
+  } else {
+    *size = 1;
+    return false;
+  }
+
+  for (size_t i = 1; i < *size; i++) {
+    if (i >= length || str[i] < lower || str[i] > upper) {
+      *size = i;
+      return false;
+    }
+
+    lower = 0x80;
+    upper = 0xBF;
+  }
+
+  return true;
+}
+
+// Length of str once ill-formed UTF-8 is replaced
+static size_t Utf8Length(const BYTE* str, size_t length) {
+  size_t total = 0;
+
+  for (size_t i = 0; i < length;) {
+    size_t size = 1;
+    if (str[i] < 0x80 || ScanUtf8(str + i, length - i, &size)) {
+      total += size;
+    } else {
+      total += sizeof(kReplacement) - 1;
+    }
+    i += size;
+  }
+
+  return total;
+}
+
+// Appends the non-ASCII code point at str, or U+FFFD if it is ill-formed, and
+// returns the number of bytes of str it used
+static size_t AppendUtf8(const BYTE* str,
+                         size_t length,
+                         std::vector<BYTE>* out) {
+  size_t size;
+
+  if (ScanUtf8(str, length, &size)) {
+    out->insert(out->end(), str, str + size);
+  } else {
+    Append(kReplacement, sizeof(kReplacement) - 1, out);
+  }
+
+  return size;
+}
+
+static void WriteJsonString(const char* str,
+                            size_t length,
+                            std::vector<BYTE>* out) {
+  static const char kHex[] = "0123456789abcdef";
+
+  out->push_back('"');
+
+  for (size_t i = 0; i < length; i++) {
+    BYTE c = (BYTE)str[i];
+
+    if (c >= 0x80) {
+      i += AppendUtf8((const BYTE*)str + i, length - i, out) - 1;
+      continue;
+    }
+
+    switch (c) {
+      case '"':
+        Append("\\\"", 2, out);
+        break;
+      case '\\':
+        Append("\\\\", 2, out);
+        break;
+      case '\b':
+        Append("\\b", 2, out);
+        break;
+      case '\f':
+        Append("\\f", 2, out);
+        break;
+      case '\n':
+        Append("\\n", 2, out);
+        break;
+      case '\r':
+        Append("\\r", 2, out);
+        break;
+      case '\t':
+        Append("\\t", 2, out);
+        break;
+      default:
+        if (c < 0x20) {
+          char escape[] = {'\\', 'u', '0', '0', kHex[c >> 4], kHex[c & 0xF]};
+          Append(escape, sizeof(escape), out);
+        } else {
+          out->push_back(c);
+        }
+    }
+  }
+
+  out->push_back('"');
+}
+
+static void WriteJsonInteger(int64_t value, std::vector<BYTE>* out) {
+  char buffer[24];
+  char* end = std::to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+  Append(buffer, end - buffer, out);
+}
+
+// Formats value the way Number.prototype.toString() does, from the shortest
+// digits that round-trip
+static void WriteJsonNumber(double value, std::vector<BYTE>* out) {
+  if (!std::isfinite(value)) {
+    Append("null", 4, out);
+    return;
+  }
+
+  if (value == 0) {
+    out->push_back('0');
+    return;
+  }
+
+  if (value < 0) {
+    out->push_back('-');
+    value = -value;
+  }
+
+  // d.ddde[+-]x
+  char buffer[32];
+  char* end = std::to_chars(buffer, buffer + sizeof(buffer), value,
+                            std::chars_format::scientific)
+                  .ptr;
+  *end = '\0';
+
+  char* exponent = strchr(buffer, 'e');
+  char digits[20];
+  int k = 0;
+  for (char* c = buffer; c < exponent; c++) {
+    if (*c != '.') {
+      digits[k++] = *c;
+    }
+  }
+  // Position of the decimal point relative to the digits
+  int n = atoi(exponent + 1) + 1;
+
+  if (k <= n && n <= 21) {
+    Append(digits, k, out);
+    out->insert(out->end(), n - k, '0');
+  } else if (0 < n && n <= 21) {
+    Append(digits, n, out);
+    out->push_back('.');
+    Append(digits + n, k - n, out);
+  } else if (-6 < n && n <= 0) {
+    Append("0.", 2, out);
+    out->insert(out->end(), -n, '0');
+    Append(digits, k, out);
+  } else {
+    out->push_back(digits[0]);
+    if (k > 1) {
+      out->push_back('.');
+      Append(digits + 1, k - 1, out);
+    }
+    out->push_back('e');
+    out->push_back(n - 1 < 0 ? '-' : '+');
+    WriteJsonInteger(std::abs(n - 1), out);
+  }
+}
+
+static void WriteMsgPackString(const char* str,
+                               size_t size,
+                               std::vector<BYTE>* out) {
+  const BYTE* bytes = (const BYTE*)str;
+  size_t length = Utf8Length(bytes, size);
+
+  if (length <= 31) {
+    out->push_back((BYTE)(0xA0 | length));
+  } else if (length <= 0xFF) {
+    out->push_back(0xD9);
+    AppendBigEndian(length, 1, out);
+  } else if (length <= 0xFFFF) {
+    out->push_back(0xDA);
+    AppendBigEndian(length, 2, out);
+  } else {
+    out->push_back(0xDB);
+    AppendBigEndian(length, 4, out);
+  }
+
+  for (size_t i = 0; i < size;) {
+    if (bytes[i] < 0x80) {
+      out->push_back(bytes[i++]);
+    } else {
+      i += AppendUtf8(bytes + i, size - i, out);
+    }
+  }
+}
+
+static void WriteMsgPackArrayHeader(size_t length, std::vector<BYTE>* out) {
+  if (length <= 15) {
+    out->push_back((BYTE)(0x90 | length));
+  } else if (length <= 0xFFFF) {
+    out->push_back(0xDC);
+    AppendBigEndian(length, 2, out);
+  } else {
+    out->push_back(0xDD);
+    AppendBigEndian(length, 4, out);
+  }
+}
+
+static void WriteMsgPackUnsigned(uint64_t value, std::vector<BYTE>* out) {
+  if (value <= 0x7F) {
+    out->push_back((BYTE)value);
+  } else if (value <= 0xFF) {
+    out->push_back(0xCC);
+    AppendBigEndian(value, 1, out);
+  } else if (value <= 0xFFFF) {
+    out->push_back(0xCD);
+    AppendBigEndian(value, 2, out);
+  } else if (value <= 0xFFFFFFFF) {
+    out->push_back(0xCE);
+    AppendBigEndian(value, 4, out);
+  } else {
+    out->push_back(0xCF);
+    AppendBigEndian(value, 8, out);
+  }
+}
+
+static void WriteMsgPackSigned(int64_t value, std::vector<BYTE>* out) {
+  if (value >= 0) {
+    WriteMsgPackUnsigned(value, out);
+  } else if (value >= -32) {
+    out->push_back((BYTE)value);
+  } else if (value >= INT8_MIN) {
+    out->push_back(0xD0);
+    AppendBigEndian(value, 1, out);
+  } else if (value >= INT16_MIN) {
+    out->push_back(0xD1);
+    AppendBigEndian(value, 2, out);
+  } else if (value >= INT32_MIN) {
+    out->push_back(0xD2);
+    AppendBigEndian(value, 4, out);
+  } else {
+    out->push_back(0xD3);
+    AppendBigEndian(value, 8, out);
+  }
+}
+
+void Serializer::Serialize(const std::map<std::string, Offset>& offsets,
+                           uint64_t layout_version,
+                           std::vector<BYTE>* out) {
+  if (!this->has_keys || this->layout_version != layout_version) {
+    this->BuildKeys(offsets);
+    this->has_keys = true;
+    this->layout_version = layout_version;
+  }
+
+  out->insert(out->end(), this->header.begin(), this->header.end());
+
+  std::vector<std::vector<BYTE>>::const_iterator key = this->keys.begin();
+  std::map<std::string, Offset>::const_iterator it = offsets.begin();
+
+  for (; it != offsets.end(); ++it, ++key) {
+    out->insert(out->end(), key->begin(), key->end());
+
+    if (this->format == SerializeFormat::Json) {
+      this->WriteJsonValue(it->second, out);
+    } else {
+      this->WriteMsgPackValue(it->second, out);
+    }
+  }
+
+  if (this->format == SerializeFormat::Json) {
+    out->push_back('}');
+  }
+}
+
+void Serializer::BuildKeys(const std::map<std::string, Offset>& offsets) {
+  this->header.clear();
+  this->keys.clear();
+
+  if (this->format == SerializeFormat::Json) {
+    this->header.push_back('{');
+  } else if (offsets.size() <= 15) {
+    this->header.push_back((BYTE)(0x80 | offsets.size()));
+  } else if (offsets.size() <= 0xFFFF) {
+    this->header.push_back(0xDE);
+    AppendBigEndian(offsets.size(), 2, &this->header);
+  } else {
+    this->header.push_back(0xDF);
+    AppendBigEndian(offsets.size(), 4, &this->header);
+  }
+
+  std::map<std::string, Offset>::const_iterator it = offsets.begin();
+  for (; it != offsets.end(); ++it) {
+    const std::string& name = it->second.name;
+    std::vector<BYTE> key;
+
+    if (this->format == SerializeFormat::Json) {
+      if (it != offsets.begin()) {
+        key.push_back(',');
+      }
+      WriteJsonString(name.data(), name.size(), &key);
+      key.push_back(':');
+    } else {
+      WriteMsgPackString(name.data(), name.size(), &key);
+    }
+
+    this->keys.push_back(std::move(key));
+  }
+}
+
+void Serializer::WriteJsonValue(const Offset& offset, std::vector<BYTE>* out) {
+  const void* data = offset.dest;
+
+  switch (offset.type) {
+    case Type::Byte:
+      return WriteJsonInteger(*((uint8_t*)data), out);
+    case Type::SByte:
+      return WriteJsonInteger(*((int8_t*)data), out);
+    case Type::Int16:
+      return WriteJsonInteger(*((int16_t*)data), out);
+    case Type::Int32:
+      return WriteJsonInteger(*((int32_t*)data), out);
+    case Type::UInt16:
+      return WriteJsonInteger(*((uint16_t*)data), out);
+    case Type::UInt32:
+      return WriteJsonInteger(*((uint32_t*)data), out);
+    case Type::Int64: {
+      // Strings, as in the result of process()
+      out->push_back('"');
+      WriteJsonInteger(*((int64_t*)data), out);
+      out->push_back('"');
+      return;
+    }
+    case Type::UInt64: {
+      char buffer[24];
+      char* end = std::to_chars(buffer, buffer + sizeof(buffer),
+                                *((uint64_t*)data))
+                      .ptr;
+      out->push_back('"');
+      Append(buffer, end - buffer, out);
+      out->push_back('"');
+      return;
+    }
+    case Type::Double:
+      return WriteJsonNumber(*((double*)data), out);
+    case Type::Single:
+      return WriteJsonNumber(*((float*)data), out);
+    case Type::String: {
+      const char* str = (const char*)data;
+      return WriteJsonString(str, strnlen(str, offset.size), out);
+    }
+    case Type::BitArray: {
+      const uint8_t* bits = (const uint8_t*)data;
+      out->push_back('[');
+      for (DWORD i = 0; i < offset.size * 8; i++) {
+        if (i) {
+          out->push_back(',');
+        }
+        if (bits[i / 8] & (1 << (i % 8))) {
+          Append("true", 4, out);
+        } else {
+          Append("false", 5, out);
+        }
+      }
+      out->push_back(']');
+      return;
+    }
+    case Type::ByteArray: {
+      const uint8_t* bytes = (const uint8_t*)data;
+      out->push_back('[');
+      for (DWORD i = 0; i < offset.size; i++) {
+        if (i) {
+          out->push_back(',');
+        }
+        WriteJsonInteger(bytes[i], out);
+      }
+      out->push_back(']');
+      return;
+    }
+  }
+
+  Append("null", 4, out);
+}
+
+void Serializer::WriteMsgPackValue(const Offset& offset,
+                                   std::vector<BYTE>* out) {
+  const void* data = offset.dest;
+
+  switch (offset.type) {
+    case Type::Byte:
+      return WriteMsgPackUnsigned(*((uint8_t*)data), out);
+    case Type::SByte:
+      return WriteMsgPackSigned(*((int8_t*)data), out);
+    case Type::Int16:
+      return WriteMsgPackSigned(*((int16_t*)data), out);
+    case Type::Int32:
+      return WriteMsgPackSigned(*((int32_t*)data), out);
+    case Type::Int64:
+      return WriteMsgPackSigned(*((int64_t*)data), out);
+    case Type::UInt16:
+      return WriteMsgPackUnsigned(*((uint16_t*)data), out);
+    case Type::UInt32:
+      return WriteMsgPackUnsigned(*((uint32_t*)data), out);
+    case Type::UInt64:
+      return WriteMsgPackUnsigned(*((uint64_t*)data), out);
+    case Type::Double: {
+      uint64_t bits;
+      CopyMemory(&bits, data, sizeof(bits));
+      out->push_back(0xCB);
+      AppendBigEndian(bits, 8, out);
+      return;
+    }
+    case Type::Single: {
+      uint32_t bits;
+      CopyMemory(&bits, data, sizeof(bits));
+      out->push_back(0xCA);
+      AppendBigEndian(bits, 4, out);
+      return;
+    }
+    case Type::String: {
+      const char* str = (const char*)data;
+      return WriteMsgPackString(str, strnlen(str, offset.size), out);
+    }
+    case Type::BitArray: {
+      const uint8_t* bits = (const uint8_t*)data;
+      WriteMsgPackArrayHeader(offset.size * 8, out);
+      for (DWORD i = 0; i < offset.size * 8; i++) {
+        out->push_back((bits[i / 8] & (1 << (i % 8))) ? 0xC3 : 0xC2);
+      }
+      return;
+    }
+    case Type::ByteArray: {
+      const uint8_t* bytes = (const uint8_t*)data;
+      WriteMsgPackArrayHeader(offset.size, out);
+      for (DWORD i = 0; i < offset.size; i++) {
+        WriteMsgPackUnsigned(bytes[i], out);
+      }
+      return;
+    }
+  }
+
+  out->push_back(0xC0);  // nil
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,53 @@
+#ifndef SERIALIZER_H
+#define SERIALIZER_H
+
+#include <windows.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace FSUIPC {
+
+struct Offset;
+
+enum class SerializeFormat { Json, MsgPack };
+
+// Writes the values of all offsets as a single object straight from their
+// dest buffers, without creating JS values. The result has the shape of the
+// result of process(): JSON is the same as JSON.stringify() of it, and
+// MessagePack differs only in sending 64 bit integers as integers rather
+// than strings.
+//
+// The encoded keys of the object are built once per layout, so a cycle only
+// encodes values.
+class Serializer {
+ public:
+  explicit Serializer(SerializeFormat format) : format(format) {}
+
+  // Appends the object to out. Must be called with offsets_mutex held.
+  void Serialize(const std::map<std::string, Offset>& offsets,
+                 uint64_t layout_version,
+                 std::vector<BYTE>* out);
+
+ private:
+  void BuildKeys(const std::map<std::string, Offset>& offsets);
+
+  void WriteJsonValue(const Offset& offset, std::vector<BYTE>* out);
+  void WriteMsgPackValue(const Offset& offset, std::vector<BYTE>* out);
+
+  SerializeFormat format;
+
+  bool has_keys = false;
+  uint64_t layout_version = 0;
+  // Start of the object, for MessagePack including the number of keys
+  std::vector<BYTE> header;
+  // Encoded key of every offset, in layout order, including the separator
+  // from the previous value for JSON
+  std::vector<std::vector<BYTE>> keys;
+};
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,90 @@
+#include "Snapshot.h"
+
+#include <mutex>
+
+namespace FSUIPC {
+
+std::shared_ptr<Snapshot> Snapshot::Get(const std::string& name) {
+  static std::mutex registry_mutex;
+  static std::map<std::string, std::weak_ptr<Snapshot>> registry;
+
+  std::lock_guard<std::mutex> guard(registry_mutex);
+
+  std::shared_ptr<Snapshot> snapshot = registry[name].lock();
+  if (!snapshot) {
+    snapshot = std::make_shared<Snapshot>();
+    registry[name] = snapshot;
+  }
+
+  return snapshot;
+}
+
+bool Snapshot::Claim(const void* owner) {
+  const void* expected = nullptr;
+  return this->owner.compare_exchange_strong(expected, owner) ||
+         expected == owner;
+}
+
+void Snapshot::Release(const void* owner) {
+  const void* expected = owner;
+  this->owner.compare_exchange_strong(expected, nullptr);
+}
+
+void Snapshot::Publish(const std::map<std::string, Offset>& offsets,
+                       uint64_t layout_version) {
+  if (!this->has_layout || this->layout_version != layout_version) {
+    std::unique_lock<std::shared_timed_mutex> guard(this->layout_mutex);
+
+    size_t total = 0;
+
+    this->layout.clear();
+    for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+      this->layout.push_back(SnapshotField{it->second.name, it->second.type,
+                                           it->second.size, total});
+      total += it->second.size;
+    }
+
+    this->data.resize(total);
+
+    this->generation++;
+    this->has_layout = true;
+    this->layout_version = layout_version;
+  }
+
+  this->lock.WriteBegin();
+
+  BYTE* dest = this->data.data();
+  for (auto it = offsets.begin(); it != offsets.end(); ++it) {
+    CopyMemory(dest, it->second.dest, it->second.size);
+    dest += it->second.size;
+  }
+
+  this->lock.WriteEnd();
+}
+
+bool Snapshot::Read(uint64_t* generation,
+                    std::vector<SnapshotField>* layout,
+                    std::vector<BYTE>* data) {
+  std::shared_lock<std::shared_timed_mutex> guard(this->layout_mutex);
+
+  if (this->lock.Count() == 0) {
+    return false;
+  }
+
+  if (*generation != this->generation) {
+    *layout = this->layout;
+    *generation = this->generation;
+  }
+
+  data->resize(this->data.size());
+
+  uint32_t seq;
+  do {
+    seq = this->lock.ReadBegin();
+    CopyMemory(data->data(), this->data.data(), data->size());
+  } while (this->lock.ReadRetry(seq));
+
+  return true;
+}
+
+}  // namespace FSUIPC
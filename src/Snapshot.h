@@ -0,0 +1,70 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <windows.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <vector>
+
+#include "FSUIPC.h"
+#include "SeqLock.h"
+
+namespace FSUIPC {
+
+struct SnapshotField {
+  std::string name;
+  Type type;
+  DWORD size;
+  size_t position;  // Position of the value in the snapshot data
+};
+
+// Named, process-wide buffer holding the latest values read by an FSUIPC
+// instance, so that other threads can read them without their own link.
+// Values are published under a seqlock, so the polling thread never waits
+// for readers.
+class Snapshot {
+ public:
+  static std::shared_ptr<Snapshot> Get(const std::string& name);
+
+  // Makes owner the only publisher of this snapshot. Returns false if
+  // another owner already publishes to it.
+  bool Claim(const void* owner);
+
+  // Gives up publishing, if owner is the current publisher
+  void Release(const void* owner);
+
+  // Publishes the current values of all offsets. Only one thread may publish
+  // to a snapshot at a time.
+  void Publish(const std::map<std::string, Offset>& offsets,
+               uint64_t layout_version);
+
+  // Copies the latest consistent values into data, and the layout into
+  // layout if it changed since generation. Returns false if nothing was
+  // published yet.
+  bool Read(uint64_t* generation,
+            std::vector<SnapshotField>* layout,
+            std::vector<BYTE>* data);
+
+ private:
+  // Only locked exclusively by the publisher when the layout changes
+  std::shared_timed_mutex layout_mutex;
+  std::vector<SnapshotField> layout;
+  uint64_t generation = 0;
+
+  std::atomic<const void*> owner{nullptr};
+
+  // Publisher-only state
+  bool has_layout = false;
+  uint64_t layout_version = 0;
+
+  SeqLock lock;
+  std::vector<BYTE> data;
+};
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,61 @@
+#include "SnapshotReader.h"
+
+#include <string>
+
+namespace FSUIPC {
+
+NAN_MODULE_INIT(SnapshotReader::Init) {
+  v8::Local<v8::FunctionTemplate> ctor =
+      Nan::New<v8::FunctionTemplate>(SnapshotReader::New);
+  AddonData::Get()->snapshot_reader.Reset(ctor);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("SnapshotReader").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "read", Read);
+
+  target->Set(Nan::GetCurrentContext(),
+              Nan::New("SnapshotReader").ToLocalChecked(),
+              ctor->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
+}
+
+NAN_METHOD(SnapshotReader::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError(
+        Nan::New("SnapshotReader.new - called without new keyword")
+            .ToLocalChecked());
+  }
+
+  if (info.Length() != 1 || !info[0]->IsString()) {
+    return Nan::ThrowTypeError(
+        Nan::New("SnapshotReader.new - expected first argument to be string")
+            .ToLocalChecked());
+  }
+
+  SnapshotReader* reader = new SnapshotReader();
+  reader->snapshot = Snapshot::Get(std::string(*Nan::Utf8String(info[0])));
+  reader->Wrap(info.Holder());
+
+  info.GetReturnValue().Set(info.Holder());
+}
+
+NAN_METHOD(SnapshotReader::Read) {
+  SnapshotReader* self = Nan::ObjectWrap::Unwrap<SnapshotReader>(info.This());
+
+  if (!self->snapshot->Read(&self->generation, &self->layout, &self->data)) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+  std::vector<SnapshotField>::iterator it = self->layout.begin();
+
+  for (; it != self->layout.end(); ++it) {
+    Nan::Set(obj, Nan::New(it->name).ToLocalChecked(),
+             GetOffsetValue(it->type, self->data.data() + it->position,
+                            it->size));
+  }
+
+  info.GetReturnValue().Set(obj);
+}
+
+}  // namespace FSUIPC
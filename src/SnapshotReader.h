@@ -0,0 +1,33 @@
+#ifndef SNAPSHOTREADER_H
+#define SNAPSHOTREADER_H
+
+#include <nan.h>
+
+#include <memory>
+#include <vector>
+
+#include "Snapshot.h"
+
+namespace FSUIPC {
+
+// Reads the values published with FSUIPC.shareSnapshot(), typically from
+// another worker thread than the one that owns the link
+class SnapshotReader : public Nan::ObjectWrap {
+ public:
+  static NAN_MODULE_INIT(Init);
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(Read);
+
+ protected:
+  std::shared_ptr<Snapshot> snapshot;
+
+  // Copy of the layout and values of the last read
+  uint64_t generation = 0;
+  std::vector<SnapshotField> layout;
+  std::vector<BYTE> data;
+};
+
+}  // namespace FSUIPC
+
+#endif
@@ -0,0 +1,233 @@
+#include "StateFile.h"
+
+#include <cstring>
+#include <new>
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+static const char kStateMagic[8] = {'F', 'S', 'U', 'I', 'P', 'C', 'S', 'T'};
+
+StateFile::~StateFile() {
+  if (this->claimed) {
+    InterlockedCompareExchange((LONG volatile*)&this->header->writer, 0,
+                               (LONG)GetCurrentProcessId());
+  }
+
+  if (this->view) {
+    UnmapViewOfFile(this->view);
+  }
+
+  if (this->mapping) {
+    CloseHandle(this->mapping);
+  }
+
+  if (this->file != INVALID_HANDLE_VALUE) {
+    CloseHandle(this->file);
+  }
+}
+
+bool StateFile::Open(const std::string& name,
+                     const std::string& path,
+                     uint32_t max_fields,
+                     uint32_t capacity,
+                     std::string* error) {
+  uint32_t fields_offset = sizeof(StateHeader);
+  uint32_t data_offset = fields_offset + max_fields * sizeof(StateField);
+  // Values are 8 byte aligned, as a float64 or int64 may be read in place
+  data_offset = (data_offset + 7) & ~7u;
+  uint32_t size = data_offset + capacity;
+
+  this->name = name;
+
+  if (!path.empty()) {
+    // A file that is still mapped can't be truncated, so an existing file is
+    // opened as it is. Its contents are only reset below, once the mapping
+    // turns out to be new.
+    this->file = CreateFile(path.c_str(), GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (this->file == INVALID_HANDLE_VALUE) {
+      *error = "Could not create " + path;
+      return false;
+    }
+
+    if (GetLastError() != ERROR_ALREADY_EXISTS) {
+      LARGE_INTEGER end;
+      end.QuadPart = size;
+
+      if (!SetFilePointerEx(this->file, end, NULL, FILE_BEGIN) ||
+          !SetEndOfFile(this->file)) {
+        *error = "Could not size " + path;
+        return false;
+      }
+    }
+  }
+
+  // Without a file, the mapping is backed by the paging file
+  this->mapping = CreateFileMapping(this->file, NULL, PAGE_READWRITE, 0, size,
+                                    name.c_str());
+  if (!this->mapping) {
+    *error = "Could not create mapping " + name;
+    return false;
+  }
+
+  // Readers keep the mapping alive, so sharing again under the same name
+  // finds the previous one
+  bool exists = GetLastError() == ERROR_ALREADY_EXISTS;
+
+  this->view = (BYTE*)MapViewOfFile(this->mapping, FILE_MAP_ALL_ACCESS, 0, 0,
+                                    size);
+  if (!this->view) {
+    *error = "Could not map " + name;
+    return false;
+  }
+
+  if (exists) {
+    this->header = (StateHeader*)this->view;
+
+    if (memcmp(this->header->magic, kStateMagic, sizeof(kStateMagic)) ||
+        this->header->mapping_size != size) {
+      *error = "Mapping " + name + " is in use with another layout";
+      return false;
+    }
+
+    // A second writer would write the same seqlock concurrently
+    if (!this->Claim()) {
+      *error = "Mapping " + name + " is already shared by process " +
+               std::to_string(this->header->writer);
+      return false;
+    }
+
+    // Readers see an empty frame until the next cycle
+    this->header->seq.WriteBegin();
+  } else {
+    ZeroMemory(this->view, size);
+    this->header = new (this->view) StateHeader();
+    CopyMemory(this->header->magic, kStateMagic, sizeof(kStateMagic));
+    this->header->writer = GetCurrentProcessId();
+    this->claimed = true;
+  }
+
+  this->header->version = kStateVersion;
+  this->header->header_size = sizeof(StateHeader);
+  this->header->mapping_size = size;
+  this->header->field_count = 0;
+  this->header->max_fields = max_fields;
+  this->header->fields_offset = fields_offset;
+  this->header->field_size = sizeof(StateField);
+  this->header->data_offset = data_offset;
+  this->header->data_size = 0;
+  this->header->capacity = capacity;
+
+  if (exists) {
+    this->header->seq.WriteEnd();
+  }
+
+  return true;
+}
+
+bool StateFile::Claim() {
+  LONG self = (LONG)GetCurrentProcessId();
+  LONG volatile* writer = (LONG volatile*)&this->header->writer;
+
+  while (true) {
+    LONG current = InterlockedCompareExchange(writer, self, 0);
+    if (current == 0) {
+      break;
+    }
+
+    // Another state file of this process, or a process that is still running
+    if (current == self) {
+      return false;
+    }
+
+    HANDLE process =
+        OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)current);
+    if (process) {
+      DWORD code = 0;
+      bool alive = GetExitCodeProcess(process, &code) && code == STILL_ACTIVE;
+      CloseHandle(process);
+
+      if (alive) {
+        return false;
+      }
+    }
+
+    // Taken over from a writer that exited without releasing the mapping
+    if (InterlockedCompareExchange(writer, self, current) == current) {
+      break;
+    }
+  }
+
+  this->claimed = true;
+  return true;
+}
+
+void StateFile::WriteLayout(const std::map<std::string, Offset>& offsets,
+                            uint64_t layout_version) {
+  StateField* fields =
+      (StateField*)(this->view + this->header->fields_offset);
+  uint32_t count = 0;
+  uint32_t position = 0;
+
+  this->positions.clear();
+
+  std::map<std::string, Offset>::const_iterator it = offsets.begin();
+  for (; it != offsets.end(); ++it) {
+    const Offset& offset = it->second;
+
+    if (count == this->header->max_fields ||
+        offset.size > this->header->capacity - position) {
+      this->positions.push_back(-1);
+      continue;
+    }
+
+    StateField& field = fields[count++];
+    ZeroMemory(field.name, sizeof(field.name));
+    strncpy(field.name, offset.name.c_str(), sizeof(field.name) - 1);
+    field.type = static_cast<uint32_t>(offset.type);
+    field.offset = offset.offset;
+    field.size = offset.size;
+    field.position = position;
+
+    this->positions.push_back(position);
+    position += offset.size;
+  }
+
+  this->header->field_count = count;
+  this->header->data_size = position;
+  this->header->layout_version = layout_version;
+
+  this->has_layout = true;
+  this->layout_version = layout_version;
+}
+
+void StateFile::Publish(uint64_t timestamp,
+                        const std::map<std::string, Offset>& offsets,
+                        uint64_t layout_version) {
+  this->header->seq.WriteBegin();
+
+  if (!this->has_layout || this->layout_version != layout_version) {
+    this->WriteLayout(offsets, layout_version);
+  }
+
+  BYTE* data = this->view + this->header->data_offset;
+  std::vector<int64_t>::const_iterator position = this->positions.begin();
+
+  std::map<std::string, Offset>::const_iterator it = offsets.begin();
+  for (; it != offsets.end(); ++it, ++position) {
+    if (*position >= 0) {
+      CopyMemory(data + *position, it->second.dest, it->second.size);
+    }
+  }
+
+  this->header->sequence++;
+  this->header->timestamp = timestamp;
+
+  this->header->seq.WriteEnd();
+}
+
+}  // namespace FSUIPC
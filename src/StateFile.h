@@ -0,0 +1,99 @@
+#ifndef STATEFILE_H
+#define STATEFILE_H
+
+#include <windows.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "SeqLock.h"
+
+namespace FSUIPC {
+
+struct Offset;
+
+// Layout of a state file, for readers in other languages. All integers are
+// little-endian, and all offsets are from the start of the mapping.
+//
+// A reader loops until it gets a consistent frame: wait until seq is even,
+// read the header, field table and values, then retry if seq changed.
+struct StateHeader {
+  char magic[8];          // "FSUIPCST"
+  uint32_t version;       // kStateVersion
+  uint32_t header_size;   // sizeof(StateHeader)
+  SeqLock seq;            // Odd while a frame is being written
+  uint32_t mapping_size;  // Size of the whole mapping
+  uint32_t field_count;
+  uint32_t max_fields;
+  uint32_t fields_offset;
+  uint32_t field_size;  // sizeof(StateField)
+  uint32_t data_offset;
+  uint32_t data_size;  // Size of the values of the current frame
+  uint32_t capacity;   // Space available for values
+  uint32_t writer;     // Process id of the writer, 0 if none
+  uint64_t layout_version;
+  uint64_t sequence;   // Number of frames written
+  uint64_t timestamp;  // uv_hrtime() of the cycle, in nanoseconds
+};
+
+struct StateField {
+  char name[32];  // NUL-padded, truncated if longer
+  uint32_t type;  // FSUIPC.Type
+  uint32_t offset;
+  uint32_t size;
+  uint32_t position;  // Of the value, from data_offset
+};
+
+static_assert(sizeof(StateHeader) == 80, "StateHeader layout changed");
+static_assert(sizeof(StateField) == 48, "StateField layout changed");
+
+static const uint32_t kStateVersion = 1;
+
+// Publishes the latest values into a named file mapping, optionally backed by
+// a file, so that tools in any language can read them without syscalls or
+// copies. The mapping has a fixed size: fields that don't fit in the field
+// table or in the space for values are left out.
+class StateFile {
+ public:
+  ~StateFile();
+
+  // path may be empty for a mapping backed by the paging file
+  bool Open(const std::string& name,
+            const std::string& path,
+            uint32_t max_fields,
+            uint32_t capacity,
+            std::string* error);
+
+  const std::string& Name() const { return this->name; }
+
+  // Writes the current values of offsets. Must be called with offsets_mutex
+  // held. Only allocates when the layout changes.
+  void Publish(uint64_t timestamp,
+               const std::map<std::string, Offset>& offsets,
+               uint64_t layout_version);
+
+ private:
+  void WriteLayout(const std::map<std::string, Offset>& offsets,
+                   uint64_t layout_version);
+  // Makes this the only writer of an existing mapping
+  bool Claim();
+
+  std::string name;
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = NULL;
+  BYTE* view = nullptr;
+  StateHeader* header = nullptr;
+  bool claimed = false;
+
+  bool has_layout = false;
+  uint64_t layout_version = 0;
+  // Position of the value of every offset in layout order, or -1 if it
+  // didn't fit
+  std::vector<int64_t> positions;
+};
+
+}  // namespace FSUIPC
+
+#endif
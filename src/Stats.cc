@@ -0,0 +1,248 @@
+#include "Stats.h"
+
+#include <uv.h>
+
+#include <atomic>
+#include <cstdio>
+
+namespace FSUIPC {
+
+const char* PhaseToString(Phase phase) {
+  switch (phase) {
+    case Phase::QueueWait:
+      return "queueWait";
+    case Phase::MutexWait:
+      return "mutexWait";
+    case Phase::Encode:
+      return "encode";
+    case Phase::RoundTrip:
+      return "roundTrip";
+    case Phase::Decode:
+      return "decode";
+    case Phase::Materialize:
+      return "materialize";
+    case Phase::Count:
+      break;
+  }
+
+  return "";
+}
+
+int Histogram::IndexOf(uint64_t value) {
+  if (value < kSubBuckets) {
+    return (int)value;
+  }
+
+  int exponent = 63;
+  while (!(value >> exponent)) {
+    exponent--;
+  }
+
+  int shift = exponent - kSubBucketBits;
+  int sub_bucket = (int)(value >> shift) - kSubBuckets;
+
+  return (shift + 1) * kSubBuckets + sub_bucket;
+}
+
+uint64_t Histogram::ValueOf(int index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+
+  int shift = index / kSubBuckets - 1;
+  uint64_t sub_bucket = index % kSubBuckets + kSubBuckets;
+
+  // Middle of the bucket
+  return (sub_bucket << shift) + ((1ULL << shift) >> 1);
+}
+
+void Histogram::Record(uint64_t value) {
+  this->counts[IndexOf(value)]++;
+  this->count++;
+  this->sum += value;
+
+  if (value < this->min) {
+    this->min = value;
+  }
+  if (value > this->max) {
+    this->max = value;
+  }
+}
+
+void Histogram::Reset() {
+  for (int i = 0; i < kBuckets; i++) {
+    this->counts[i] = 0;
+  }
+
+  this->count = 0;
+  this->sum = 0;
+  this->min = UINT64_MAX;
+  this->max = 0;
+}
+
+uint64_t Histogram::Percentile(double percentile) const {
+  if (this->count == 0) {
+    return 0;
+  }
+
+  uint64_t target = (uint64_t)(percentile / 100.0 * this->count + 0.5);
+  if (target < 1) {
+    target = 1;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < kBuckets; i++) {
+    seen += this->counts[i];
+    if (seen >= target) {
+      uint64_t value = ValueOf(i);
+      return value > this->max ? this->max : value;
+    }
+  }
+
+  return this->max;
+}
+
+Stats::Stats() {
+  static std::atomic<int> instances{0};
+
+  this->trace_tid = ++instances;
+}
+
+void Stats::RecordCycle(const CycleTiming& timing,
+                        const LinkCounters& before,
+                        const LinkCounters& after,
+                        bool ok) {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->cycles++;
+  if (!ok) {
+    this->errors++;
+  }
+
+  this->link.requests += after.requests - before.requests;
+  this->link.bytes += after.bytes - before.bytes;
+  this->link.retries += after.retries - before.retries;
+  this->link.timeouts += after.timeouts - before.timeouts;
+  this->link.round_trip += after.round_trip - before.round_trip;
+  this->link.decode += after.decode - before.decode;
+  this->link.encode += after.encode - before.encode;
+
+  this->bytes.Record(after.bytes - before.bytes);
+  this->requests.Record(after.requests - before.requests);
+
+  uint64_t start = timing.start;
+  for (int i = 0; i < static_cast<int>(Phase::Materialize); i++) {
+    this->phases[i].Record(timing.phases[i]);
+    this->AddTraceEvent(static_cast<Phase>(i), start, timing.phases[i]);
+    start += timing.phases[i];
+  }
+}
+
+void Stats::RecordPhase(Phase phase, uint64_t start, uint64_t duration) {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->phases[static_cast<int>(phase)].Record(duration);
+  this->AddTraceEvent(phase, start, duration);
+}
+
+void Stats::AddTraceEvent(Phase phase, uint64_t start, uint64_t duration) {
+  if (!this->tracing) {
+    return;
+  }
+
+  TraceEvent event{phase, start, duration};
+
+  // Keep the most recent events once the buffer is full
+  if (this->trace.size() < kMaxTraceEvents) {
+    this->trace.push_back(event);
+  } else {
+    this->trace[this->trace_next] = event;
+  }
+  this->trace_next = (this->trace_next + 1) % kMaxTraceEvents;
+}
+
+void Stats::StartTrace() {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->tracing = true;
+  this->trace.clear();
+  this->trace.reserve(kMaxTraceEvents);
+  this->trace_next = 0;
+}
+
+std::string Stats::StopTrace() {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->tracing = false;
+
+  std::string json = "{\"traceEvents\":[";
+  char event[192];
+  int pid = (int)uv_os_getpid();
+
+  snprintf(event, sizeof(event),
+           "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+           "\"args\":{\"name\":\"fsuipc #%d\"}}",
+           pid, this->trace_tid, this->trace_tid);
+  json += event;
+
+  // Oldest event first
+  size_t first = this->trace.size() < kMaxTraceEvents ? 0 : this->trace_next;
+  for (size_t i = 0; i < this->trace.size(); i++) {
+    const TraceEvent& e = this->trace[(first + i) % this->trace.size()];
+
+    snprintf(event, sizeof(event),
+             ",{\"name\":\"%s\",\"cat\":\"fsuipc\",\"ph\":\"X\",\"ts\":%.3f,"
+             "\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+             PhaseToString(e.phase), e.start / 1e3, e.duration / 1e3, pid,
+             e.phase == Phase::Materialize ? 0 : this->trace_tid);
+    json += event;
+  }
+
+  json += "],\"displayTimeUnit\":\"ms\"}";
+
+  this->trace.clear();
+  this->trace.shrink_to_fit();
+
+  return json;
+}
+
+void Stats::Summarize(const Histogram& histogram, HistogramSummary* summary) {
+  summary->count = histogram.Count();
+  summary->min = histogram.Min();
+  summary->max = histogram.Max();
+  summary->mean = histogram.Mean();
+  summary->p50 = histogram.Percentile(50);
+  summary->p90 = histogram.Percentile(90);
+  summary->p99 = histogram.Percentile(99);
+  summary->p999 = histogram.Percentile(99.9);
+}
+
+void Stats::GetSummary(Summary* summary) {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  summary->cycles = this->cycles;
+  summary->errors = this->errors;
+  summary->link = this->link;
+
+  for (int i = 0; i < static_cast<int>(Phase::Count); i++) {
+    Summarize(this->phases[i], &summary->phases[i]);
+  }
+  Summarize(this->bytes, &summary->bytes);
+  Summarize(this->requests, &summary->requests);
+}
+
+void Stats::Reset() {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  this->cycles = 0;
+  this->errors = 0;
+  this->link = LinkCounters{};
+
+  for (int i = 0; i < static_cast<int>(Phase::Count); i++) {
+    this->phases[i].Reset();
+  }
+  this->bytes.Reset();
+  this->requests.Reset();
+}
+
+}  // namespace FSUIPC
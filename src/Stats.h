@@ -0,0 +1,143 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace FSUIPC {
+
+enum class Phase : int {
+  QueueWait = 0,    // Waiting for a threadpool thread
+  MutexWait = 1,    // Waiting for offsets_mutex and fsuipc_mutex
+  Encode = 2,       // Building the request
+  RoundTrip = 3,    // SendMessageTimeout
+  Decode = 4,       // Copying results out of the reception area
+  Materialize = 5,  // Creating the JS result
+  Count = 6
+};
+
+const char* PhaseToString(Phase phase);
+
+// Latency histogram in the style of HdrHistogram: buckets are linear within
+// each power of two, giving ~3% precision over the full range of uint64_t
+// nanoseconds with a fixed amount of memory.
+class Histogram {
+ public:
+  Histogram() { this->Reset(); }
+
+  void Record(uint64_t value);
+  void Reset();
+
+  uint64_t Count() const { return this->count; }
+  uint64_t Min() const { return this->count ? this->min : 0; }
+  uint64_t Max() const { return this->max; }
+  double Mean() const {
+    return this->count ? (double)this->sum / this->count : 0;
+  }
+  uint64_t Percentile(double percentile) const;
+
+ private:
+  static const int kSubBucketBits = 5;
+  static const int kSubBuckets = 1 << kSubBucketBits;
+  static const int kBuckets = (64 - kSubBucketBits + 1) * kSubBuckets;
+
+  static int IndexOf(uint64_t value);
+  static uint64_t ValueOf(int index);
+
+  uint64_t counts[kBuckets];
+  uint64_t count;
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+};
+
+// Counters of the IPC link, accumulated by IPCUser over its lifetime
+struct LinkCounters {
+  uint64_t requests;
+  uint64_t bytes;
+  uint64_t retries;
+  uint64_t timeouts;
+  uint64_t round_trip;  // ns spent in SendMessageTimeout
+  uint64_t decode;      // ns spent copying results
+  uint64_t encode;      // ns from the first queued read or write to sending
+};
+
+struct HistogramSummary {
+  uint64_t count;
+  uint64_t min;
+  uint64_t max;
+  double mean;
+  uint64_t p50;
+  uint64_t p90;
+  uint64_t p99;
+  uint64_t p999;
+};
+
+struct CycleTiming {
+  uint64_t start;  // uv_hrtime() when the cycle was queued
+  uint64_t phases[static_cast<int>(Phase::Count)];
+};
+
+// Per-instance instrumentation of process() cycles. Recording happens on both
+// the threadpool and the main thread, so all methods are thread safe.
+class Stats {
+ public:
+  Stats();
+
+  void RecordCycle(const CycleTiming& timing,
+                   const LinkCounters& before,
+                   const LinkCounters& after,
+                   bool ok);
+  void RecordPhase(Phase phase, uint64_t start, uint64_t duration);
+
+  void StartTrace();
+  // Returns the events recorded since StartTrace() as Chrome trace JSON
+  std::string StopTrace();
+
+  struct Summary {
+    uint64_t cycles;
+    uint64_t errors;
+    LinkCounters link;
+    HistogramSummary phases[static_cast<int>(Phase::Count)];
+    HistogramSummary bytes;     // Request bytes per cycle
+    HistogramSummary requests;  // Round-trips per cycle
+  };
+
+  void GetSummary(Summary* summary);
+  void Reset();
+
+  static void Summarize(const Histogram& histogram, HistogramSummary* summary);
+
+ private:
+  struct TraceEvent {
+    Phase phase;
+    uint64_t start;
+    uint64_t duration;
+  };
+
+  static const size_t kMaxTraceEvents = 1 << 16;
+
+  void AddTraceEvent(Phase phase, uint64_t start, uint64_t duration);
+
+  // Trace thread of this instance's cycles; materialization happens on the
+  // main thread, which is shared by all instances
+  int trace_tid;
+
+  std::mutex mutex;
+  uint64_t cycles = 0;
+  uint64_t errors = 0;
+  LinkCounters link = {};
+  Histogram phases[static_cast<int>(Phase::Count)];
+  Histogram bytes;
+  Histogram requests;
+
+  bool tracing = false;
+  size_t trace_next = 0;
+  std::vector<TraceEvent> trace;
+};
+
+}  // namespace FSUIPC
+
+#endif
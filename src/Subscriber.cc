@@ -0,0 +1,363 @@
+#include "Subscriber.h"
+
+#include "FSUIPC.h"
+
+namespace FSUIPC {
+
+// Initial size of the message buffer, which grows to the largest frame
+static const size_t kMessageSize = 4096;
+
+NAN_MODULE_INIT(Subscriber::Init) {
+  v8::Local<v8::FunctionTemplate> ctor =
+      Nan::New<v8::FunctionTemplate>(Subscriber::New);
+  ctor->InstanceTemplate()->SetInternalFieldCount(1);
+  ctor->SetClassName(Nan::New("Subscriber").ToLocalChecked());
+
+  Nan::SetPrototypeMethod(ctor, "read", Read);
+  Nan::SetPrototypeMethod(ctor, "close", Close);
+
+  target->Set(Nan::GetCurrentContext(),
+              Nan::New("Subscriber").ToLocalChecked(),
+              ctor->GetFunction(Nan::GetCurrentContext()).ToLocalChecked());
+}
+
+NAN_METHOD(Subscriber::New) {
+  if (!info.IsConstructCall()) {
+    return Nan::ThrowError(
+        Nan::New("Subscriber.new - called without new keyword")
+            .ToLocalChecked());
+  }
+
+  if (info.Length() < 1 || !info[0]->IsString() ||
+      (info.Length() > 1 && !info[1]->IsFunction())) {
+    return Nan::ThrowTypeError(
+        Nan::New("Subscriber.new - expected a string and optionally a "
+                 "function")
+            .ToLocalChecked());
+  }
+
+  HANDLE stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+  if (!stop_event) {
+    return Nan::ThrowError(
+        Nan::New("Subscriber.new - could not create event").ToLocalChecked());
+  }
+
+  // The pipe is opened by the reading thread, as waiting for a busy
+  // publisher would block the event loop
+  Subscriber* subscriber = new Subscriber();
+  subscriber->path =
+      "\\\\.\\pipe\\" + std::string(*Nan::Utf8String(info[0]));
+  subscriber->stop_event = stop_event;
+  subscriber->Wrap(info.Holder());
+
+  if (info.Length() > 1) {
+    subscriber->callback.Reset(info[1].As<v8::Function>());
+    subscriber->resource = new Nan::AsyncResource("FSUIPC:subscriber");
+    subscriber->notifier =
+        new Notifier([subscriber]() { subscriber->Deliver(); });
+
+    // The callback keeps the subscriber alive until close()
+    subscriber->Ref();
+  }
+
+  subscriber->running = true;
+  subscriber->thread = std::thread(&Subscriber::Run, subscriber);
+
+  info.GetReturnValue().Set(info.Holder());
+}
+
+Subscriber::~Subscriber() {
+  this->Stop();
+}
+
+NAN_METHOD(Subscriber::Read) {
+  Subscriber* self = Nan::ObjectWrap::Unwrap<Subscriber>(info.This());
+
+  {
+    std::lock_guard<std::mutex> guard(self->mutex);
+    if (!self->error.empty()) {
+      return Nan::ThrowError(Nan::New(self->error).ToLocalChecked());
+    }
+  }
+
+  self->Update();
+
+  if (!self->read_generation) {
+    info.GetReturnValue().Set(Nan::Null());
+    return;
+  }
+
+  info.GetReturnValue().Set(self->BuildResult());
+}
+
+NAN_METHOD(Subscriber::Close) {
+  Subscriber* self = Nan::ObjectWrap::Unwrap<Subscriber>(info.This());
+
+  self->Stop();
+}
+
+bool Subscriber::Connect() {
+  // The publisher creates the next pipe instance right after a subscriber
+  // connects, so all instances can be busy for a moment. Waits are short so
+  // that close() doesn't wait for them.
+  for (int i = 0; i < 20 && this->running; i++) {
+    this->pipe =
+        CreateFile(this->path.c_str(), GENERIC_READ | FILE_WRITE_ATTRIBUTES,
+                   0, NULL, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, NULL);
+
+    if (this->pipe != INVALID_HANDLE_VALUE) {
+      // Every record is sent as its own message
+      DWORD mode = PIPE_READMODE_MESSAGE;
+      if (SetNamedPipeHandleState(this->pipe, &mode, NULL, NULL)) {
+        return true;
+      }
+
+      CloseHandle(this->pipe);
+      this->pipe = INVALID_HANDLE_VALUE;
+
+      std::lock_guard<std::mutex> guard(this->mutex);
+      this->error = "Subscriber: could not set up " + this->path;
+      return false;
+    }
+
+    if (GetLastError() != ERROR_PIPE_BUSY) {
+      break;
+    }
+
+    WaitNamedPipe(this->path.c_str(), 50);
+  }
+
+  // Closed while connecting
+  if (!this->running) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> guard(this->mutex);
+  this->error = "Subscriber: could not connect to " + this->path;
+  return false;
+}
+
+void Subscriber::Run() {
+  if (!this->Connect()) {
+    {
+      std::lock_guard<std::mutex> guard(this->mutex);
+      this->disconnected = true;
+    }
+
+    if (this->notifier) {
+      this->notifier->Notify();
+    }
+    return;
+  }
+
+  OVERLAPPED overlapped = {};
+  overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+  std::vector<BYTE> message(kMessageSize);
+  CaptureDecoder decoder;
+  bool has_header = false;
+  bool has_layout = false;
+  uint64_t layout_version = 0;
+
+  while (overlapped.hEvent) {
+    size_t size;
+    if (!this->ReadMessage(&message, &size, &overlapped)) {
+      break;
+    }
+
+    size_t position = 0;
+
+    if (!has_header) {
+      if (!CaptureDecoder::DecodeHeader(message.data(), size, &position)) {
+        break;
+      }
+      has_header = true;
+      continue;
+    }
+
+    CaptureDecoder::Record record =
+        decoder.Next(message.data(), size, &position);
+
+    if (record == CaptureDecoder::Record::Layout) {
+      continue;
+    } else if (record != CaptureDecoder::Record::Frame) {
+      break;
+    }
+
+    {
+      std::lock_guard<std::mutex> guard(this->mutex);
+
+      if (!has_layout || decoder.LayoutVersion() != layout_version) {
+        this->layout = decoder.Layout();
+        this->layout_generation++;
+        layout_version = decoder.LayoutVersion();
+        has_layout = true;
+      }
+
+      this->data = decoder.Data();
+      this->generation++;
+    }
+
+    if (this->notifier) {
+      this->notifier->Notify();
+    }
+  }
+
+  if (overlapped.hEvent) {
+    CloseHandle(overlapped.hEvent);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    this->disconnected = true;
+  }
+
+  if (this->notifier) {
+    this->notifier->Notify();
+  }
+}
+
+bool Subscriber::ReadMessage(std::vector<BYTE>* message,
+                             size_t* size,
+                             OVERLAPPED* overlapped) {
+  *size = 0;
+
+  while (true) {
+    if (*size == message->size()) {
+      message->resize(message->size() * 2);
+    }
+
+    if (!ReadFile(this->pipe, message->data() + *size,
+                  (DWORD)(message->size() - *size), NULL, overlapped)) {
+      DWORD error = GetLastError();
+
+      if (error == ERROR_IO_PENDING) {
+        HANDLE handles[] = {overlapped->hEvent, this->stop_event};
+        if (WaitForMultipleObjects(2, handles, FALSE, INFINITE) !=
+            WAIT_OBJECT_0) {
+          DWORD read;
+          CancelIo(this->pipe);
+          GetOverlappedResult(this->pipe, overlapped, &read, TRUE);
+          return false;
+        }
+      } else if (error != ERROR_MORE_DATA) {
+        return false;
+      }
+    }
+
+    DWORD read = 0;
+    BOOL ok = GetOverlappedResult(this->pipe, overlapped, &read, FALSE);
+    *size += read;
+
+    if (ok) {
+      return true;
+    }
+
+    // The rest of the message is read into the grown buffer
+    if (GetLastError() != ERROR_MORE_DATA) {
+      return false;
+    }
+  }
+}
+
+void Subscriber::Stop() {
+  if (this->running.exchange(false)) {
+    SetEvent(this->stop_event);
+    this->thread.join();
+  }
+
+  if (this->pipe != INVALID_HANDLE_VALUE) {
+    CloseHandle(this->pipe);
+    this->pipe = INVALID_HANDLE_VALUE;
+  }
+
+  if (this->stop_event) {
+    CloseHandle(this->stop_event);
+    this->stop_event = NULL;
+  }
+
+  if (this->notifier) {
+    this->notifier->Close();
+    this->notifier = nullptr;
+
+    delete this->resource;
+    this->resource = nullptr;
+    this->callback.Reset();
+
+    this->Unref();
+  }
+}
+
+void Subscriber::Deliver() {
+  Nan::HandleScope scope;
+
+  if (!this->notifier) {
+    return;
+  }
+
+  bool disconnected;
+  std::string error;
+  {
+    std::lock_guard<std::mutex> guard(this->mutex);
+    disconnected = this->disconnected;
+    error = this->error;
+  }
+
+  if (this->Update()) {
+    v8::Local<v8::Value> argv[] = {Nan::Null(), this->BuildResult()};
+    this->callback.Call(2, argv, this->resource);
+  }
+
+  if (disconnected && this->notifier) {
+    v8::Local<v8::Value> argv[] = {Nan::Error(
+        error.empty() ? "Subscriber: publisher disconnected" : error.c_str())};
+    this->callback.Call(1, argv, this->resource);
+
+    this->Stop();
+  }
+}
+
+bool Subscriber::Update() {
+  std::lock_guard<std::mutex> guard(this->mutex);
+
+  if (this->generation == this->read_generation) {
+    return false;
+  }
+
+  if (this->layout_generation != this->read_layout_generation) {
+    this->read_layout = this->layout;
+    this->read_layout_generation = this->layout_generation;
+
+    this->read_positions.clear();
+    size_t position = 0;
+    for (auto it = this->read_layout.begin(); it != this->read_layout.end();
+         ++it) {
+      this->read_positions.push_back(position);
+      position += it->size;
+    }
+  }
+
+  this->read_data = this->data;
+  this->read_generation = this->generation;
+
+  return true;
+}
+
+v8::Local<v8::Object> Subscriber::BuildResult() {
+  Nan::EscapableHandleScope scope;
+
+  v8::Local<v8::Object> obj = Nan::New<v8::Object>();
+
+  for (size_t i = 0; i < this->read_layout.size(); i++) {
+    const CaptureField& field = this->read_layout[i];
+    Nan::Set(obj, Nan::New(field.name).ToLocalChecked(),
+             GetOffsetValue(field.type,
+                            this->read_data.data() + this->read_positions[i],
+                            field.size));
+  }
+
+  return scope.Escape(obj);
+}
+
+}  // namespace FSUIPC
@@ -0,0 +1,77 @@
+#ifndef SUBSCRIBER_H
+#define SUBSCRIBER_H
+
+#include <nan.h>
+#include <windows.h>
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Capture.h"
+#include "helpers.h"
+
+namespace FSUIPC {
+
+// Receives the values broadcast with FSUIPC.startPublishing(), typically in
+// another process than the one that owns the link. A background thread reads
+// the pipe and keeps only the latest frame.
+class Subscriber : public Nan::ObjectWrap {
+ public:
+  static NAN_MODULE_INIT(Init);
+
+  static NAN_METHOD(New);
+  static NAN_METHOD(Read);
+  static NAN_METHOD(Close);
+
+  ~Subscriber();
+
+ protected:
+  void Run();
+  // Opens the pipe, waiting for a busy publisher to accept another subscriber
+  bool Connect();
+  // Reads a whole pipe message into message, growing it as needed
+  bool ReadMessage(std::vector<BYTE>* message,
+                   size_t* size,
+                   OVERLAPPED* overlapped);
+  void Stop();
+  void Deliver();
+
+  // Copies the latest frame if it changed since the last call, and returns
+  // whether it did
+  bool Update();
+  v8::Local<v8::Object> BuildResult();
+
+  std::string path;
+  HANDLE pipe = INVALID_HANDLE_VALUE;
+  HANDLE stop_event = NULL;
+  std::atomic<bool> running{false};
+  std::thread thread;
+
+  // Latest frame, written by the reading thread
+  std::mutex mutex;
+  uint64_t generation = 0;
+  uint64_t layout_generation = 0;
+  std::vector<CaptureField> layout;
+  std::vector<BYTE> data;
+  bool disconnected = false;
+  std::string error;  // Set if the publisher could not be reached
+
+  // Copy of the frame read from JS, with the position of every field
+  uint64_t read_generation = 0;
+  uint64_t read_layout_generation = 0;
+  std::vector<CaptureField> read_layout;
+  std::vector<size_t> read_positions;
+  std::vector<BYTE> read_data;
+
+  // Only set when a callback was passed to the constructor
+  Notifier* notifier = nullptr;
+  Nan::Callback callback;
+  Nan::AsyncResource* resource = nullptr;
+};
+
+}  // namespace FSUIPC
+
+#endif
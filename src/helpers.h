@@ -1,6 +1,10 @@
 #ifndef HELPERS_H
 #define HELPERS_H
 
+#include <atomic>
+#include <functional>
+#include <new>
+
 namespace FSUIPC {
 
 // https://github.com/nodejs/nan/blob/v2.8.0/nan.h#L1504
@@ -17,7 +21,13 @@ class PromiseWorker {
     v8::Local<v8::Object> obj = Nan::New<v8::Object>();
     persistentHandle.Reset(obj);
 
-    async_resource = new Nan::AsyncResource("PromiseWorker", obj);
+    async_resource =
+        new (async_storage) Nan::AsyncResource("PromiseWorker", obj);
+
+    // KickNextTick(), which will make sure our promises work even with
+    // setTimeout or setInterval See https://github.com/nodejs/nan/issues/539
+    kick.Reset(Nan::New<v8::Function>(
+        [](const Nan::FunctionCallbackInfo<v8::Value>& info) {}, Nan::Null()));
   }
 
   virtual ~PromiseWorker() {
@@ -29,7 +39,7 @@ class PromiseWorker {
       resolver.Reset();
     delete[] errmsg_;
 
-    delete async_resource;
+    async_resource->~AsyncResource();
   }
 
   virtual void WorkComplete() {
@@ -40,14 +50,38 @@ class PromiseWorker {
     else
       HandleErrorCallback();
 
-    // KickNextTick(), which will make sure our promises work even with
-    // setTimeout or setInterval See https://github.com/nodejs/nan/issues/539
-    Nan::Callback(Nan::New<v8::Function>(
-                      [](const Nan::FunctionCallbackInfo<v8::Value>& info) {},
-                      Nan::Null()))
-        .Call(0, nullptr, async_resource);
+    kick.Call(0, nullptr, async_resource);
   }
 
+  // Prepares a finished worker to be queued again. The promise and async
+  // resource are new, so every use is its own async operation; only the
+  // persistent handle is reused. The async resource is rebuilt in the
+  // worker's own storage, so reuse doesn't allocate.
+  void Reset() {
+    Nan::HandleScope scope;
+
+    resolver.Reset(
+        v8::Promise::Resolver::New(Nan::GetCurrentContext()).ToLocalChecked());
+
+    async_resource->~AsyncResource();
+    async_resource = new (async_storage)
+        Nan::AsyncResource("PromiseWorker", Nan::New(persistentHandle));
+
+    delete[] errmsg_;
+    errmsg_ = NULL;
+
+    deferred = false;
+    arrivals = 0;
+  }
+
+  // Returns true for the second of the after-work callback and the thread
+  // the work was handed to, which completes the worker
+  bool Arrive() { return arrivals.fetch_add(1) == 1; }
+
+  // Called on the main thread when the work is still running on the thread
+  // it was handed to
+  virtual void Deferring() {}
+
   inline void SaveToPersistent(const char* key,
                                const v8::Local<v8::Value>& value) {
     Nan::HandleScope scope;
@@ -94,6 +128,10 @@ class PromiseWorker {
 
   uv_work_t request;
 
+  // Set by Execute() when it handed the work to another thread instead of
+  // finishing it
+  bool deferred = false;
+
   virtual void Destroy() { delete this; }
 
   v8::Local<v8::Promise> GetPromise() {
@@ -105,6 +143,7 @@ class PromiseWorker {
   Nan::Persistent<v8::Object> persistentHandle;
   Nan::Persistent<v8::Promise::Resolver> resolver;
   Nan::AsyncResource* async_resource;
+  Nan::Callback kick;
 
   virtual void HandleOKCallback() {
     Nan::HandleScope scope;
@@ -134,6 +173,43 @@ class PromiseWorker {
  private:
   NAN_DISALLOW_ASSIGN_COPY_MOVE(PromiseWorker)
   char* errmsg_;
+  std::atomic<int> arrivals{0};
+  alignas(Nan::AsyncResource) unsigned char
+      async_storage[sizeof(Nan::AsyncResource)];
+};
+
+// Runs a function on the main thread when notified from any thread.
+// Notifications that arrive before the main thread gets to run coalesce into
+// a single call. Delete with Close(), which frees it once libuv is done.
+class Notifier {
+ public:
+  explicit Notifier(std::function<void()> callback)
+      : callback(std::move(callback)) {
+    this->async.data = this;
+    uv_async_init(Nan::GetCurrentEventLoop(), &this->async,
+                  [](uv_async_t* handle) {
+                    static_cast<Notifier*>(handle->data)->callback();
+                  });
+  }
+
+  void Notify() { uv_async_send(&this->async); }
+
+  // An unreferenced notifier doesn't keep the event loop alive
+  void Ref() { uv_ref(reinterpret_cast<uv_handle_t*>(&this->async)); }
+  void Unref() { uv_unref(reinterpret_cast<uv_handle_t*>(&this->async)); }
+
+  void Close() {
+    uv_close(reinterpret_cast<uv_handle_t*>(&this->async),
+             [](uv_handle_t* handle) {
+               delete static_cast<Notifier*>(handle->data);
+             });
+  }
+
+ private:
+  ~Notifier() {}
+
+  std::function<void()> callback;
+  uv_async_t async;
 };
 
 inline void PromiseExecute(uv_work_t* req) {
@@ -143,12 +219,18 @@ inline void PromiseExecute(uv_work_t* req) {
 
 inline void PromiseExecuteComplete(uv_work_t* req) {
   PromiseWorker* worker = static_cast<PromiseWorker*>(req->data);
+
+  if (worker->deferred && !worker->Arrive()) {
+    worker->Deferring();
+    return;
+  }
+
   worker->WorkComplete();
   worker->Destroy();
 }
 
 inline void PromiseQueueWorker(PromiseWorker* worker) {
-  uv_queue_work(uv_default_loop(), &worker->request, PromiseExecute,
+  uv_queue_work(Nan::GetCurrentEventLoop(), &worker->request, PromiseExecute,
                 reinterpret_cast<uv_after_work_cb>(PromiseExecuteComplete));
 }
 
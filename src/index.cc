@@ -1,15 +1,29 @@
+#include <DeltaStream.h>
 #include <FSUIPC.h>
+#include <SnapshotReader.h>
+#include <Subscriber.h>
 #include <nan.h>
 
 namespace FSUIPC {
 
+#ifdef FSUIPC_ALLOC_COUNTER
+NAN_MODULE_INIT(InitAllocCounter);
+#endif
+
 NAN_MODULE_INIT(InitModule) {
   FSUIPC::Init(target);
+  SnapshotReader::Init(target);
+  Subscriber::Init(target);
+  DeltaStream::Init(target);
+  DeltaReader::Init(target);
   InitType(target);
   InitError(target);
   InitSimulator(target);
+#ifdef FSUIPC_ALLOC_COUNTER
+  InitAllocCounter(target);
+#endif
 }
 
-NODE_MODULE(NODE_GYP_MODULE_NAME, InitModule);
+NAN_MODULE_WORKER_ENABLED(NODE_GYP_MODULE_NAME, InitModule)
 
 }  // namespace FSUIPC
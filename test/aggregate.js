@@ -0,0 +1,63 @@
+// Checks aggregate() and downsample() against values computed in JS from the
+// same history
+const assert = require('assert');
+const {fsuipc, kUserOffset, run} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+const writer = new fsuipc.FSUIPC();
+
+function close(actual, expected) {
+  assert.ok(Math.abs(actual - expected) < 1e-9, `${actual} != ${expected}`);
+}
+
+async function test() {
+  await obj.open();
+  await writer.open();
+
+  obj.add('square', kUserOffset, fsuipc.Type.Double);
+  obj.add('negated', kUserOffset + 8, fsuipc.Type.Double);
+  obj.enableHistory('square', {samples: 1000});
+  obj.enableHistory('negated', {samples: 1000});
+
+  for (let i = 0; i < 100; i++) {
+    writer.write(kUserOffset, fsuipc.Type.Double, (i % 10) ** 2);
+    writer.write(kUserOffset + 8, fsuipc.Type.Double, -i);
+    await writer.process();
+    await obj.process();
+  }
+
+  // A single window over everything
+  const {square, negated} =
+      await obj.aggregate(['square', 'negated'], {windowMs: 1e9});
+  const values = Array.from(obj.history('square').values);
+  const mean = values.reduce((a, b) => a + b) / values.length;
+  const variance =
+      values.reduce((a, b) => a + (b - mean) ** 2, 0) / values.length;
+
+  assert.strictEqual(square.count[0], 100);
+  assert.strictEqual(square.min[0], 0);
+  assert.strictEqual(square.max[0], 81);
+  close(square.mean[0], mean);
+  close(square.stddev[0], Math.sqrt(variance));
+  assert.strictEqual(negated.min[0], -99);
+  assert.strictEqual(negated.max[0], 0);
+
+  // Decimation keeps the first and last samples, and minmax the extremes
+  const {negated: lttb} =
+      await obj.downsample(['negated'], {points: 10, method: 'lttb'});
+  assert.strictEqual(lttb.values.length, 10);
+  assert.strictEqual(lttb.values[0], 0);
+  assert.strictEqual(lttb.values[9], -99);
+
+  const {square: minmax} =
+      await obj.downsample(['square'], {points: 10, method: 'minmax'});
+  assert.ok(minmax.values.length <= 10);
+  assert.strictEqual(Math.min(...minmax.values), 0);
+  assert.strictEqual(Math.max(...minmax.values), 81);
+
+  assert.throws(() => obj.aggregate(['missing'], {windowMs: 1000}));
+
+  console.log('aggregate() and downsample() match JS');
+}
+
+run(test, obj, writer);
@@ -0,0 +1,36 @@
+// Checks that steady-state process() cycles don't allocate natively.
+// Requires a build with the allocation counter: yarn build:alloc-counter
+const assert = require('assert');
+const {fsuipc, run} = require('./common');
+
+if (!fsuipc.allocations) {
+  console.error('Build with yarn build:alloc-counter to run this test');
+  process.exit(1);
+}
+
+const obj = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+  obj.add('aircraftType', 0x3D00, fsuipc.Type.String, 256);
+  obj.add('lights', 0x0D0C, fsuipc.Type.BitArray, 2);
+
+  // Warm up worker pool and request buffers
+  for (let i = 0; i < 10; i++) {
+    await obj.process();
+  }
+
+  const before = fsuipc.allocations();
+
+  for (let i = 0; i < 1000; i++) {
+    await obj.process();
+  }
+
+  const allocations = fsuipc.allocations() - before;
+  console.log(`${allocations} allocations in 1000 cycles`);
+  assert.strictEqual(allocations, 0);
+}
+
+run(test, obj);
@@ -0,0 +1,44 @@
+// Checks that overlapping process() calls share cycles instead of queueing a
+// round-trip each, and that maxAgeMs serves the last cycle without one
+const assert = require('assert');
+const {fsuipc, run} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+  obj.add('altitude', 0x570, fsuipc.Type.Int64);
+
+  // Calls join the cycle waiting for a thread, or the one after the cycle
+  // already running
+  obj.resetStats();
+  const calls = [];
+  for (let i = 0; i < 20; i++) {
+    calls.push(obj.process());
+  }
+
+  const results = await Promise.all(calls);
+  assert.ok(new Set(results).size <= 2);
+  assert.ok(obj.stats().cycles <= 2, `${obj.stats().cycles} cycles`);
+
+  // Fresh enough, so no cycle at all
+  const last = await obj.process();
+  obj.resetStats();
+
+  const cached = await obj.process({maxAgeMs: 10000});
+  assert.deepStrictEqual(cached, last);
+  assert.strictEqual(obj.stats().cycles, 0);
+
+  // Too old, so a new cycle
+  await new Promise((resolve) => setTimeout(resolve, 20));
+  await obj.process({maxAgeMs: 10});
+  assert.strictEqual(obj.stats().cycles, 1);
+
+  assert.throws(() => obj.process({maxAgeMs: '10'}), TypeError);
+
+  console.log('overlapping process() calls share cycles');
+}
+
+run(test, obj);
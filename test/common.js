@@ -0,0 +1,29 @@
+// Helpers shared by the tests that run against the sim
+const fsuipc = require('..');
+
+// Free for general use, see the FSUIPC offset list
+const kUserOffset = 0x66C0;
+
+// Runs the async test, reporting a failure through the exit code, and then
+// closes the given instances or calls the given cleanup functions
+function run(test, ...cleanup) {
+  return test()
+      .catch((err) => {
+        console.error(err);
+        process.exitCode = 1;
+      })
+      .then(() => Promise.all(cleanup.map((item) => {
+        return typeof item === 'function' ? item() : item.close();
+      })));
+}
+
+function sleep(ms) {
+  return new Promise((resolve) => setTimeout(resolve, ms));
+}
+
+// Milliseconds on the process.hrtime() clock, like history timestamps
+function now() {
+  return Number(process.hrtime.bigint()) / 1e6;
+}
+
+module.exports = {fsuipc, kUserOffset, run, sleep, now};
@@ -0,0 +1,33 @@
+// Checks that connect() opens the link in the background without holding up
+// cycles during the handshake, and reports it once the link is usable
+const assert = require('assert');
+const {fsuipc, run} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+async function test() {
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+
+  const connected = new Promise((resolve) => obj.on('connected', resolve));
+  obj.connect({minBackoffMs: 50, maxBackoffMs: 500});
+
+  // Cycles before the link is swapped in fail right away
+  while (true) {
+    try {
+      obj.processSync({timeout: 100});
+      break;
+    } catch (err) {
+      assert.strictEqual(err.code, fsuipc.ErrorCode.NOTOPEN);
+    }
+  }
+
+  const simulator = await connected;
+  assert.notStrictEqual(simulator, fsuipc.Simulator.ANY);
+
+  const result = await obj.process();
+  assert.ok(result.clockHour >= 0 && result.clockHour < 24);
+
+  console.log(`connected to ${fsuipc.Simulator[simulator]}`);
+}
+
+run(test, obj);
@@ -0,0 +1,37 @@
+// Checks that sendControls() validates its arguments and sends sequences
+// that don't fit in one request. Toggles the parking brake an even number of
+// times, so the sim ends up as it was.
+const assert = require('assert');
+const {fsuipc, run, sleep} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+const kParkingBrakes = 65752;
+
+assert.throws(() => obj.sendControls({control: 1}), TypeError);
+assert.throws(() => obj.sendControls([1]), TypeError);
+assert.throws(() => obj.sendControls([{control: -1}]), TypeError);
+assert.throws(() => obj.sendControls([{control: 1, param: 1.5}]), TypeError);
+
+async function test() {
+  await obj.open();
+
+  obj.add('parkingBrake', 0x0BC8, fsuipc.Type.UInt16);
+  const before = (await obj.process()).parkingBrake;
+
+  // 20 bytes each, so about twice what fits in one request
+  const controls = [];
+  for (let i = 0; i < 3000; i++) {
+    controls.push({control: kParkingBrakes, param: 0});
+  }
+
+  assert.strictEqual(await obj.sendControls(controls), obj);
+  await obj.sendControls([]);
+
+  await sleep(500);
+  assert.strictEqual((await obj.process()).parkingBrake, before);
+
+  console.log('sendControls() sends long sequences in order');
+}
+
+run(test, obj);
@@ -0,0 +1,56 @@
+// Measures the delta wire format against JSON.stringify of the result of
+// process(): bytes per frame, and encode time per field. Runs against the sim,
+// or against a capture if one is given: node test/delta_benchmark.js x.fsrec
+const {fsuipc, run} = require('./common');
+const {DeltaReader} = require('../delta');
+
+const CYCLES = 1000;
+
+const obj = new fsuipc.FSUIPC();
+const capture = process.argv[2];
+
+async function test() {
+  await obj.open(capture ? {replay: capture, speed: 0} : undefined);
+
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+  obj.add('aircraftType', 0x3D00, fsuipc.Type.String, 256);
+  obj.add('lights', 0x0D0C, fsuipc.Type.BitArray, 2);
+  obj.add('altitude', 0x570, fsuipc.Type.Int64);
+  obj.add('latitude', 0x6010, fsuipc.Type.Double);
+  obj.add('longitude', 0x6018, fsuipc.Type.Double);
+  obj.add('heading', 0x580, fsuipc.Type.UInt32);
+  obj.add('groundSpeed', 0x2B4, fsuipc.Type.Int32);
+
+  const fields = 8;
+  const stream = new fsuipc.DeltaStream(obj, {keyFrameInterval: 100});
+  const reader = new DeltaReader();
+
+  let jsonBytes = 0;
+  let deltaBytes = 0;
+  let jsonNs = 0n;
+  let deltaNs = 0n;
+
+  for (let i = 0; i < CYCLES; i++) {
+    const result = obj.processSync();
+
+    let start = process.hrtime.bigint();
+    const json = JSON.stringify(result);
+    jsonNs += process.hrtime.bigint() - start;
+
+    start = process.hrtime.bigint();
+    const frame = stream.next();
+    deltaNs += process.hrtime.bigint() - start;
+
+    jsonBytes += Buffer.byteLength(json);
+    deltaBytes += frame.length;
+
+    reader.decode(frame);
+  }
+
+  console.log(`JSON:  ${(jsonBytes / CYCLES).toFixed(1)} bytes/frame, ` +
+              `${Number(jsonNs) / CYCLES / fields} ns/field`);
+  console.log(`Delta: ${(deltaBytes / CYCLES).toFixed(1)} bytes/frame, ` +
+              `${Number(deltaNs) / CYCLES / fields} ns/field`);
+}
+
+run(test, obj);
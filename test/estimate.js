@@ -0,0 +1,55 @@
+// Checks that estimate() interpolates between the values of two cycles and
+// takes the shorter way around values that wrap
+const assert = require('assert');
+const {fsuipc, kUserOffset, run, now} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+const writer = new fsuipc.FSUIPC();
+
+async function set(a, b) {
+  writer.write(kUserOffset, fsuipc.Type.Double, a);
+  writer.write(kUserOffset + 8, fsuipc.Type.Double, b);
+  await writer.process();
+}
+
+async function test() {
+  await obj.open();
+  await writer.open();
+
+  obj.add('linear', kUserOffset, fsuipc.Type.Double);
+  obj.add('heading', kUserOffset + 8, fsuipc.Type.Double);
+
+  obj.enableEstimate('linear');
+  obj.enableEstimate('heading', {wrap: 360});
+  assert.strictEqual(obj.estimate('linear'), undefined);
+
+  await set(100, 350);
+  await obj.process();
+  const after = now();
+
+  await set(200, 10);
+  const before = now();
+  await obj.process();
+
+  // Both times lie between the two cycles, so they are interpolated
+  const first = obj.estimate('linear', after);
+  const second = obj.estimate('linear', before);
+  assert.ok(first >= 100 && first <= 200, `${first}`);
+  assert.ok(second >= first && second <= 200, `${second}`);
+
+  const heading = obj.estimate('heading', (after + before) / 2);
+  assert.ok(heading >= 350 || heading <= 10, `${heading}`);
+
+  // Only estimating offsets throw
+  obj.disableEstimate('linear');
+  assert.throws(() => obj.estimate('linear'));
+  assert.throws(() => obj.enableEstimate('missing'));
+
+  // An offset added again starts without estimation
+  obj.add('heading', kUserOffset + 8, fsuipc.Type.Double);
+  assert.throws(() => obj.estimate('heading'));
+
+  console.log('estimate() interpolates between cycles');
+}
+
+run(test, obj, writer);
@@ -0,0 +1,34 @@
+// Checks that history only records values fetched from the sim, at the time
+// they were fetched, and not the copies the mirror serves in between
+const assert = require('assert');
+const {fsuipc, run, now} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+
+  obj.add('cached', 0x238, fsuipc.Type.Byte, {maxAgeMs: 60000});
+  obj.add('fetched', 0x239, fsuipc.Type.Byte);
+  obj.enableHistory('cached', {samples: 100});
+  obj.enableHistory('fetched', {samples: 100});
+
+  const before = now();
+  await obj.process();
+  const after = now();
+
+  for (let i = 0; i < 4; i++) {
+    await obj.process();
+  }
+
+  const cached = obj.history('cached');
+  assert.strictEqual(cached.timestamps.length, 1);
+  assert.ok(cached.timestamps[0] >= before && cached.timestamps[0] <= after);
+
+  const fetched = obj.history('fetched');
+  assert.strictEqual(fetched.timestamps.length, 5);
+
+  console.log('history records fetched values only');
+}
+
+run(test, obj);
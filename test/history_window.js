@@ -0,0 +1,53 @@
+// Checks the limits of history ring buffers and the windows history()
+// returns
+const assert = require('assert');
+const {fsuipc, kUserOffset, run, now} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+const writer = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+  await writer.open();
+
+  obj.add('counter', kUserOffset, fsuipc.Type.UInt32);
+  obj.add('name', 0x3D00, fsuipc.Type.String, 256);
+
+  assert.throws(() => obj.enableHistory('name', {samples: 10}), TypeError);
+  assert.throws(() => obj.enableHistory('missing', {samples: 10}));
+  assert.throws(() => obj.enableHistory('counter', {}), TypeError);
+  assert.throws(() => obj.history('counter'));
+
+  obj.enableHistory('counter', {samples: 8});
+
+  // Each cycle reads the value written before it
+  const times = [];
+  for (let i = 0; i < 12; i++) {
+    writer.write(kUserOffset, fsuipc.Type.UInt32, i);
+    await writer.process();
+    await obj.process();
+    times.push(now());
+  }
+
+  // Only the last 8 samples are kept, oldest first
+  const all = obj.history('counter');
+  assert.ok(all.timestamps instanceof Float64Array);
+  assert.ok(all.values instanceof Float64Array);
+  assert.deepStrictEqual(Array.from(all.values), [4, 5, 6, 7, 8, 9, 10, 11]);
+
+  for (let i = 1; i < all.timestamps.length; i++) {
+    assert.ok(all.timestamps[i] > all.timestamps[i - 1]);
+  }
+
+  // Bounds are inclusive
+  const window = obj.history('counter', all.timestamps[2], all.timestamps[5]);
+  assert.deepStrictEqual(Array.from(window.values), [6, 7, 8, 9]);
+  assert.strictEqual(obj.history('counter', times[11] + 1).values.length, 0);
+
+  obj.disableHistory('counter');
+  assert.throws(() => obj.history('counter'));
+
+  console.log('history() returns the requested windows');
+}
+
+run(test, obj, writer);
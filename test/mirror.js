@@ -0,0 +1,42 @@
+// Checks that offsets with a maxAgeMs are served from the mirror while fresh,
+// that writes go through to it, and that stale ones are fetched again
+const assert = require('assert');
+const {fsuipc, kUserOffset, run, sleep} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+const writer = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+  await writer.open();
+
+  writer.write(kUserOffset, fsuipc.Type.UInt32, 1);
+  writer.write(kUserOffset + 4, fsuipc.Type.UInt32, 1);
+  await writer.process();
+
+  obj.add('slow', kUserOffset, fsuipc.Type.UInt32, {maxAgeMs: 60000});
+  obj.add('fast', kUserOffset + 4, fsuipc.Type.UInt32, {maxAgeMs: 50});
+  assert.deepStrictEqual(await obj.process(), {fast: 1, slow: 1});
+
+  // Everything is fresh, so there is no request at all
+  obj.resetStats();
+  writer.write(kUserOffset, fsuipc.Type.UInt32, 2);
+  writer.write(kUserOffset + 4, fsuipc.Type.UInt32, 2);
+  await writer.process();
+
+  assert.deepStrictEqual(await obj.process(), {fast: 1, slow: 1});
+  assert.strictEqual(obj.stats().requests, 0);
+
+  // Only the stale offset is fetched
+  await sleep(100);
+  assert.deepStrictEqual(await obj.process(), {fast: 2, slow: 1});
+
+  // Own writes update the mirror once acknowledged
+  obj.write(kUserOffset, fsuipc.Type.UInt32, 3);
+  await obj.process();
+  assert.strictEqual((await obj.process()).slow, 3);
+
+  console.log('the mirror serves fresh offsets');
+}
+
+run(test, obj, writer);
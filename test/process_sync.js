@@ -0,0 +1,37 @@
+// Checks that processSync() returns the same result object as process(),
+// sends queued writes, and throws FSUIPCErrors
+const assert = require('assert');
+const {fsuipc, kUserOffset, run} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+
+assert.throws(() => obj.processSync(), (err) => {
+  return err instanceof fsuipc.FSUIPCError &&
+      err.code === fsuipc.ErrorCode.NOTOPEN;
+});
+assert.throws(() => obj.processSync(50), TypeError);
+assert.throws(() => obj.processSync({timeout: 0}), TypeError);
+assert.throws(() => obj.processSync({timeout: 1.5}), TypeError);
+
+async function test() {
+  await obj.open();
+
+  obj.add('user', kUserOffset, fsuipc.Type.UInt32);
+  obj.add('aircraftType', 0x3D00, fsuipc.Type.String, 256);
+
+  obj.write(kUserOffset, fsuipc.Type.UInt32, 0xCAFE);
+  obj.processSync({timeout: 1000});
+
+  const result = obj.processSync();
+  assert.strictEqual(result.user, 0xCAFE);
+
+  const async = await obj.process();
+  assert.deepStrictEqual(Object.keys(result), Object.keys(async));
+  assert.strictEqual(result.aircraftType, async.aircraftType);
+
+  console.log('processSync() matches process()');
+}
+
+run(test, obj);
@@ -0,0 +1,43 @@
+const {fork} = require('child_process');
+const fsuipc = require('..');
+
+if (process.argv[2] !== 'subscriber') {
+  const obj = new fsuipc.FSUIPC();
+
+  obj.open()
+      .then((obj) => {
+        obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+        obj.add('aircraftType', 0x3D00, fsuipc.Type.String, 256);
+        obj.startPublishing('telemetry');
+
+        const child = fork(__filename, ['subscriber']);
+        const timer = setInterval(() => obj.process(), 100);
+
+        child.on('exit', () => {
+          clearInterval(timer);
+          console.log(obj.stopPublishing());
+
+          return obj.close();
+        });
+      })
+      .catch((err) => {
+        console.error(err);
+
+        return obj.close();
+      });
+} else {
+  let frames = 0;
+
+  const subscriber = new fsuipc.Subscriber('telemetry', (err, result) => {
+    if (err) {
+      console.error(err);
+      return;
+    }
+
+    console.log(JSON.stringify(result));
+
+    if (++frames === 10) {
+      subscriber.close();
+    }
+  });
+}
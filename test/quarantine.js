@@ -0,0 +1,56 @@
+// Checks that an offset FSUIPC rejects is quarantined when it is read through
+// the mirror, and the rest of the cycle completes. Replays a short capture,
+// which rejects offsets that weren't recorded.
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const {fsuipc, run} = require('./common');
+
+const capture = path.join(os.tmpdir(), `quarantine-${process.pid}.fsrec`);
+const recorder = new fsuipc.FSUIPC();
+const obj = new fsuipc.FSUIPC();
+
+async function record() {
+  await recorder.open();
+
+  recorder.add('clockHour', 0x238, fsuipc.Type.Byte);
+  recorder.add('latitude', 0x6010, fsuipc.Type.Double);
+
+  recorder.startRecording(capture);
+  for (let i = 0; i < 3; i++) {
+    await recorder.process();
+  }
+  recorder.stopRecording();
+
+  await recorder.close();
+}
+
+async function test() {
+  await record();
+  await obj.open({replay: capture, speed: 0});
+
+  const errors = [];
+  obj.on('error', (error) => errors.push(error.offsets));
+
+  // Any offset with a maxAgeMs reads all others through the mirror too
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte, {maxAgeMs: 1000});
+  obj.add('latitude', 0x6010, fsuipc.Type.Double);
+  obj.add('missing', 0x66C0, fsuipc.Type.UInt32);
+
+  const result = await obj.process();
+  assert.ok(result.clockHour >= 0 && result.clockHour < 24);
+  assert.strictEqual(typeof result.latitude, 'number');
+  assert.deepStrictEqual(obj.quarantined(), ['missing']);
+
+  // The next cycle doesn't ask for it anymore
+  await obj.process();
+
+  // Events are delivered on the main thread
+  await new Promise((resolve) => setImmediate(resolve));
+  assert.deepStrictEqual(errors, [['missing']]);
+
+  console.log('offsets rejected through the mirror are quarantined');
+}
+
+run(test, obj).then(() => fs.rmSync(capture, {force: true}));
@@ -0,0 +1,40 @@
+// Checks that the flight recorder writes every cycle and that unchanged
+// values cost next to nothing on disk
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const {fsuipc, run} = require('./common');
+
+const capture = path.join(os.tmpdir(), `recorder-${process.pid}.fsrec`);
+const obj = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+  obj.add('aircraftType', 0x3D00, fsuipc.Type.ByteArray, 256);
+
+  assert.throws(() => obj.startRecording(), TypeError);
+  assert.strictEqual(obj.stopRecording(), undefined);
+
+  obj.startRecording(capture);
+
+  const cycles = 200;
+  for (let i = 0; i < cycles; i++) {
+    await obj.process();
+  }
+
+  const {frames, dropped, bytes, error} = obj.stopRecording();
+  assert.strictEqual(error, undefined);
+  assert.strictEqual(frames + dropped, cycles);
+  assert.ok(frames > 0);
+
+  // The aircraft type doesn't change, so most frames only store a header
+  assert.ok(bytes < cycles * 256 / 4, `${bytes} bytes`);
+  assert.ok(fs.statSync(capture).size > 0);
+
+  console.log(`recorded ${frames} frames in ${bytes} bytes`);
+}
+
+run(test, obj).then(() => fs.rmSync(capture, {force: true}));
@@ -0,0 +1,64 @@
+// Checks that a replayed capture serves the recorded frames in order through
+// process(), for any subset of the recorded offsets
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const {fsuipc, kUserOffset, run} = require('./common');
+
+const capture = path.join(os.tmpdir(), `replay-${process.pid}.fsrec`);
+const recorder = new fsuipc.FSUIPC();
+const obj = new fsuipc.FSUIPC();
+const kFrames = 20;
+
+async function record() {
+  await recorder.open();
+
+  recorder.add('counter', kUserOffset, fsuipc.Type.UInt32);
+  recorder.add('clockHour', 0x238, fsuipc.Type.Byte);
+
+  recorder.write(kUserOffset, fsuipc.Type.UInt32, 0);
+  await recorder.process();
+
+  // Each cycle reads the counter written by the one before
+  recorder.startRecording(capture);
+  for (let i = 0; i < kFrames; i++) {
+    recorder.write(kUserOffset, fsuipc.Type.UInt32, i + 1);
+    await recorder.process();
+  }
+  recorder.stopRecording();
+
+  await recorder.close();
+}
+
+async function test() {
+  await record();
+
+  await assert.rejects(obj.open({replay: capture + '.missing'}));
+  await obj.open({replay: capture, speed: 0});
+
+  // A subset of the recorded offsets
+  obj.add('counter', kUserOffset, fsuipc.Type.UInt32);
+
+  const first = (await obj.process()).counter;
+  let previous = first;
+  for (let i = 1; i < kFrames; i++) {
+    const {counter} = await obj.process();
+    assert.strictEqual(counter, previous + 1);
+    previous = counter;
+  }
+
+  // The last frame repeats once the capture has ended
+  assert.strictEqual((await obj.process()).counter, previous);
+
+  // Writes are ignored
+  obj.write(kUserOffset, fsuipc.Type.UInt32, 0);
+  assert.strictEqual((await obj.process()).counter, previous);
+
+  obj.seek(0);
+  assert.ok((await obj.process()).counter <= first + 1);
+
+  console.log('replay serves the recorded frames');
+}
+
+run(test, obj).then(() => fs.rmSync(capture, {force: true}));
@@ -0,0 +1,29 @@
+// Checks that sample() rejects options it can't preallocate or pace. Runs
+// without a sim, as the arguments are checked before anything is queued.
+const assert = require('assert');
+const {fsuipc, run} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+assert.throws(() => obj.sample({cycles: 0}), RangeError);
+assert.throws(() => obj.sample({cycles: 2 ** 20 + 1}), RangeError);
+assert.throws(() => obj.sample({cycles: 1.5}), RangeError);
+
+// 1e9 / hz would overflow the period in nanoseconds
+assert.throws(() => obj.sample({cycles: 10, hz: 1e-12}), RangeError);
+assert.throws(() => obj.sample({cycles: 10, hz: -1}), RangeError);
+assert.throws(() => obj.sample({cycles: 10, hz: NaN}), RangeError);
+assert.throws(() => obj.sample({cycles: 10, hz: '50'}), TypeError);
+
+async function test() {
+  // 4 KB per cycle, for 2 ** 20 cycles, is more than a sample may hold
+  obj.add('big', 0x3D00, fsuipc.Type.ByteArray, 4096);
+
+  await assert.rejects(obj.sample({cycles: 2 ** 20}), (err) => {
+    return err.code === fsuipc.ErrorCode.SIZE;
+  });
+
+  console.log('sample() limits are enforced');
+}
+
+run(test);
@@ -0,0 +1,103 @@
+// Checks the deadline accounting of polling without a sim or a timer:
+//
+//   g++ -std=c++17 -Isrc test/schedule_test.cc src/Schedule.cc -o schedule_test
+//   ./schedule_test
+#include <cstdio>
+#include <cstdlib>
+
+#include "Schedule.h"
+
+using FSUIPC::OverrunPolicy;
+using FSUIPC::Schedule;
+
+static int failures = 0;
+
+static void Expect(const char* what, uint64_t actual, uint64_t expected) {
+  if (actual != expected) {
+    printf("FAIL %s: got %llu, expected %llu\n", what,
+           (unsigned long long)actual, (unsigned long long)expected);
+    failures++;
+  }
+}
+
+// Runs ticks that each take the given durations, back to back where the
+// schedule is behind, and counts missed deadlines and overruns
+static void Run(OverrunPolicy policy,
+                const uint64_t* durations,
+                int count,
+                uint64_t* missed,
+                uint64_t* overruns) {
+  Schedule schedule(0, 10, policy, 10);
+  uint64_t now = 0;
+
+  *missed = 0;
+  *overruns = 0;
+
+  for (int i = 0; i < count; i++) {
+    if (now < schedule.Next()) {
+      now = schedule.Next();
+    }
+
+    now += durations[i];
+
+    uint64_t tick_missed = schedule.Finish(now, true);
+    *missed += tick_missed;
+    *overruns += tick_missed ? 1 : 0;
+  }
+}
+
+int main() {
+  uint64_t missed;
+  uint64_t overruns;
+
+  // One tick overruns 3 periods, the ones catching up are quick
+  const uint64_t overrun[] = {35, 1, 1, 1, 1, 1};
+
+  Run(OverrunPolicy::CatchUp, overrun, 6, &missed, &overruns);
+  Expect("catch up missed", missed, 3);
+  Expect("catch up overruns", overruns, 1);
+
+  Run(OverrunPolicy::Skip, overrun, 6, &missed, &overruns);
+  Expect("skip missed", missed, 3);
+  Expect("skip overruns", overruns, 1);
+
+  // Catching up falls behind again, only the new deadlines count
+  const uint64_t again[] = {35, 1, 20, 1, 1, 1, 1};
+
+  Run(OverrunPolicy::CatchUp, again, 7, &missed, &overruns);
+  Expect("catch up again missed", missed, 5);
+  Expect("catch up again overruns", overruns, 2);
+
+  // Ticks that end right on the next deadline don't miss it
+  const uint64_t exact[] = {10, 10, 10};
+
+  Run(OverrunPolicy::CatchUp, exact, 3, &missed, &overruns);
+  Expect("exact missed", missed, 0);
+
+  // Skipping resumes on the first deadline after the overrun
+  Schedule skip(0, 10, OverrunPolicy::Skip, 10);
+  skip.Finish(45, true);
+  Expect("skip next", skip.Next(), 50);
+
+  // Catching up resumes on the first deadline that was missed
+  Schedule catch_up(0, 10, OverrunPolicy::CatchUp, 10);
+  catch_up.Finish(45, true);
+  Expect("catch up next", catch_up.Next(), 20);
+
+  // Idle ticks double the interval up to the backoff
+  Schedule idle(0, 10, OverrunPolicy::Skip, 40);
+  idle.Finish(11, false);
+  Expect("idle interval", idle.Interval(), 20);
+  idle.Finish(31, false);
+  idle.Finish(71, false);
+  Expect("idle backoff", idle.Interval(), 40);
+  idle.Finish(111, true);
+  Expect("active interval", idle.Interval(), 10);
+
+  if (failures) {
+    return EXIT_FAILURE;
+  }
+
+  printf("schedule: all checks passed\n");
+  return EXIT_SUCCESS;
+}
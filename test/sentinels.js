@@ -0,0 +1,41 @@
+// Checks that polling with sentinels seeds them with the first cycle, only
+// goes idle after they stay unchanged twice, and wakes up once they change
+const assert = require('assert');
+const {fsuipc, kUserOffset, run, sleep} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+const writer = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+  await writer.open();
+
+  // Zero, like the values the sentinels started with before seeding
+  writer.write(kUserOffset, fsuipc.Type.UInt32, 0);
+  await writer.process();
+
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+  obj.startPolling({
+    hz: 50,
+    sentinels: [{offset: kUserOffset, size: 4}],
+    maxBackoffMs: 100,
+  }, (err) => assert.ifError(err));
+
+  // Seeding, a cycle that is still in sync, then one that finds it idle
+  await sleep(500);
+  let stats = obj.pollingStats();
+  assert.strictEqual(stats.cycles, 3);
+  assert.ok(stats.idle > 0);
+
+  writer.write(kUserOffset, fsuipc.Type.UInt32, 1);
+  await writer.process();
+
+  // The change, then the same two cycles before it is idle again
+  await sleep(500);
+  stats = obj.stopPolling();
+  assert.strictEqual(stats.cycles, 6);
+
+  console.log('sentinels detect an idle sim');
+}
+
+run(test, () => obj.stopPolling(), obj, writer);
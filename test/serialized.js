@@ -0,0 +1,41 @@
+// Checks that processSerialized() matches JSON.stringify() of process(),
+// including strings with bytes that aren't valid UTF-8
+const assert = require('assert');
+const {fsuipc, kUserOffset, run} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+
+  // 'A', 'é' in Windows-1252, 'B', a truncated sequence, a valid 'é'
+  const ansi = Uint8Array.from([0x41, 0xE9, 0x42, 0xF1, 0x80, 0xC3, 0xA9, 0]);
+  obj.write(kUserOffset, fsuipc.Type.ByteArray, ansi.length, ansi);
+  await obj.process();
+
+  obj.add('ansi', kUserOffset, fsuipc.Type.String, ansi.length);
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+  obj.add('altitude', 0x570, fsuipc.Type.Int64);
+  obj.add('latitude', 0x6010, fsuipc.Type.Double);
+  obj.add('aircraftType', 0x3D00, fsuipc.Type.String, 256);
+  obj.add('lights', 0x0D0C, fsuipc.Type.BitArray, 2);
+
+  const json = (await obj.processSerialized()).toString();
+  const result = await obj.process();
+
+  // Values may change between the two cycles, but not their formatting
+  assert.strictEqual(JSON.stringify(JSON.parse(json)), json);
+  assert.deepStrictEqual(Object.keys(JSON.parse(json)), Object.keys(result));
+  assert.strictEqual(JSON.parse(json).ansi, result.ansi);
+  assert.strictEqual(result.ansi, 'A\uFFFDB\uFFFD\u00E9');
+
+  // str of MessagePack must be valid UTF-8 as well
+  const packed = await obj.processSerialized({format: 'msgpack'});
+  const value = Buffer.from('A\uFFFDB\uFFFD\u00E9');
+  const header = Buffer.from([0xA0 | value.length]);
+  assert.ok(packed.includes(Buffer.concat([header, value])));
+
+  console.log('processSerialized() matches JSON.stringify()');
+}
+
+run(test, obj);
@@ -0,0 +1,52 @@
+// Checks that shared instances get the values of their own offsets back from
+// the merged requests, including overlapping reads of different sizes, and
+// that the link stays open until the last of them closes
+const assert = require('assert');
+const {fsuipc, kUserOffset, run} = require('./common');
+
+const instances = [];
+for (let i = 0; i < 8; i++) {
+  instances.push(new fsuipc.FSUIPC({shared: true}));
+}
+
+async function test() {
+  await Promise.all(instances.map((obj) => obj.open()));
+
+  const [writer] = instances;
+  writer.write(kUserOffset, fsuipc.Type.UInt32, 0x12345678);
+  await writer.process();
+
+  instances.forEach((obj, i) => {
+    obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+    if (i % 2) {
+      obj.add('low', kUserOffset, fsuipc.Type.Byte);
+    } else {
+      obj.add('word', kUserOffset, fsuipc.Type.UInt32);
+    }
+  });
+
+  // Overlapping calls from all instances end up in a few merged requests
+  for (let round = 0; round < 10; round++) {
+    const results = await Promise.all(instances.map((obj) => obj.process()));
+
+    results.forEach((result, i) => {
+      assert.ok(result.clockHour >= 0 && result.clockHour < 24);
+      if (i % 2) {
+        assert.deepStrictEqual(Object.keys(result), ['clockHour', 'low']);
+        assert.strictEqual(result.low, 0x78);
+      } else {
+        assert.deepStrictEqual(Object.keys(result), ['clockHour', 'word']);
+        assert.strictEqual(result.word, 0x12345678);
+      }
+    });
+  }
+
+  // The last one keeps the link
+  const others = instances.splice(0, instances.length - 1);
+  await Promise.all(others.map((obj) => obj.close()));
+  assert.strictEqual((await instances[0].process()).low, 0x78);
+
+  console.log('shared instances get their own values');
+}
+
+run(test, () => Promise.all(instances.map((obj) => obj.close())));
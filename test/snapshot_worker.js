@@ -0,0 +1,28 @@
+const {Worker, isMainThread} = require('worker_threads');
+const fsuipc = require('..');
+
+if (isMainThread) {
+  const obj = new fsuipc.FSUIPC();
+
+  obj.open()
+      .then((obj) => {
+        obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+        obj.add('aircraftType', 0x3D00, fsuipc.Type.String, 256);
+        obj.shareSnapshot('telemetry');
+
+        return obj.process();
+      })
+      .then(() => {
+        const worker = new Worker(__filename);
+        worker.on('exit', () => obj.close());
+      })
+      .catch((err) => {
+        console.error(err);
+
+        return obj.close();
+      });
+} else {
+  const reader = new fsuipc.SnapshotReader('telemetry');
+
+  console.log(JSON.stringify(reader.read()));
+}
@@ -0,0 +1,70 @@
+// Checks the layout of a state file backed by a file, by reading it the way
+// a tool in another language would, and that it has a single writer
+const assert = require('assert');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+const {fsuipc, kUserOffset, run} = require('./common');
+
+const name = `fsuipc-test-${process.pid}`;
+const file = path.join(os.tmpdir(), `${name}.bin`);
+const obj = new fsuipc.FSUIPC();
+const other = new fsuipc.FSUIPC();
+
+function readFields(state) {
+  const count = state.readUInt32LE(24);
+  const table = state.readUInt32LE(32);
+  const entrySize = state.readUInt32LE(36);
+  const values = state.readUInt32LE(40);
+  const fields = {};
+
+  for (let i = 0; i < count; i++) {
+    const entry = table + i * entrySize;
+    const field = state.toString('latin1', entry, entry + 32).replace(/\0+$/,
+                                                                      '');
+    fields[field] = {
+      type: state.readUInt32LE(entry + 32),
+      offset: state.readUInt32LE(entry + 36),
+      size: state.readUInt32LE(entry + 40),
+      position: values + state.readUInt32LE(entry + 44),
+    };
+  }
+
+  return fields;
+}
+
+async function test() {
+  await obj.open();
+
+  obj.add('counter', kUserOffset, fsuipc.Type.UInt32);
+  obj.add('clockHour', 0x238, fsuipc.Type.Byte);
+  const options = {path: file, maxFields: 16, capacity: 1024};
+  obj.shareState(name, options);
+
+  assert.throws(() => other.shareState(name, options), /already shared/);
+
+  obj.write(kUserOffset, fsuipc.Type.UInt32, 0xBEEF);
+  await obj.process();
+  await obj.process();
+
+  const state = fs.readFileSync(file);
+  assert.strictEqual(state.toString('latin1', 0, 8), 'FSUIPCST');
+  assert.strictEqual(state.readUInt32LE(8), 1);
+  assert.strictEqual(state.readUInt32LE(16) % 2, 0);
+  assert.strictEqual(state.readUInt32LE(52), process.pid);
+  assert.ok(state.readBigUInt64LE(64) >= 2n);
+
+  const fields = readFields(state);
+  assert.deepStrictEqual(Object.keys(fields).sort(), ['clockHour', 'counter']);
+  assert.strictEqual(fields.counter.type, fsuipc.Type.UInt32);
+  assert.strictEqual(fields.counter.offset, kUserOffset);
+  assert.strictEqual(state.readUInt32LE(fields.counter.position), 0xBEEF);
+
+  // Giving the mapping up lets another writer take it
+  obj.shareState(null);
+  assert.strictEqual(fs.readFileSync(file).readUInt32LE(52), 0);
+
+  console.log('the state file can be read in place');
+}
+
+run(test, obj).then(() => fs.rmSync(file, {force: true}));
@@ -0,0 +1,47 @@
+// Checks that verified writes read back what the sim made of them, also when
+// so many go out at once that the request has to be split
+const assert = require('assert');
+const {fsuipc, kUserOffset, run} = require('./common');
+
+const obj = new fsuipc.FSUIPC();
+
+async function test() {
+  await obj.open();
+
+  let result = await obj.write(kUserOffset, fsuipc.Type.UInt32, 0x12345678,
+                               {verify: true});
+  assert.strictEqual(result.value, 0x12345678);
+  assert.strictEqual(result.mismatch, false);
+
+  // The sim ignores writes to the FSUIPC version
+  result = await obj.writeNow(0x3304, fsuipc.Type.UInt32, 0, {verify: true});
+  assert.notStrictEqual(result.value, 0);
+  assert.strictEqual(result.mismatch, true);
+
+  // Bytes after the terminator don't count
+  const garbage = Uint8Array.from({length: 16}, () => 0xFF);
+  obj.write(kUserOffset, fsuipc.Type.ByteArray, garbage.length, garbage);
+  await obj.flush();
+  result = await obj.write(kUserOffset, fsuipc.Type.String, 16, 'hello',
+                           {verify: true});
+  assert.strictEqual(result.value, 'hello');
+  assert.strictEqual(result.mismatch, false);
+
+  // About a thousand writes with their read-backs fill more than one request,
+  // and each read-back still follows its own write
+  const writes = [];
+  for (let i = 0; i < 1000; i++) {
+    writes.push(obj.writeNow(kUserOffset, fsuipc.Type.UInt32, i,
+                             {verify: true}));
+  }
+
+  const results = await Promise.all(writes);
+  results.forEach((result, i) => {
+    assert.strictEqual(result.value, i);
+    assert.strictEqual(result.mismatch, false);
+  });
+
+  console.log('verified writes read back their values');
+}
+
+run(test, obj);
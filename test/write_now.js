@@ -0,0 +1,18 @@
+const fsuipc = require('..');
+
+const obj = new fsuipc.FSUIPC();
+
+obj.open()
+    .then((obj) => {
+      return obj.writeNow(0x0BC8, fsuipc.Type.UInt32, 32767);
+    })
+    .then((result) => {
+      console.log(`Write acknowledged after ${result.latency} ms`);
+
+      return obj.close();
+    })
+    .catch((err) => {
+      console.error(err);
+
+      return obj.close();
+    });